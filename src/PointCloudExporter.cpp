@@ -0,0 +1,363 @@
+#include "PointCloudExporter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <vector>
+
+#include <pcl/io/lzf.h>
+
+// All binary formats are little endian, as is the host
+
+typedef pcl::PointCloud<pcl::PointXYZRGB> Cloud;
+
+// Points per chunk between writes and progress updates
+static const size_t chunkSize = 1 << 16;
+
+// Width of point counts patched into text headers
+static const int countDigits = 10;
+
+// Outcome of the format writers. Only the progress callback cancels.
+enum Status {
+  statusOK,
+  statusCancelled,
+  statusWriteError,
+  statusCompressionError
+};
+
+static inline bool isValid(const pcl::PointXYZRGB &p) {
+  return std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z);
+}
+
+// Calls emit(point, buffer) for each valid point and writes the buffer to file
+// after each chunk
+template <typename Emit>
+static Status writePoints(const Cloud &cloud, std::ofstream &file,
+                          size_t bytesPerPoint,
+                          const PointCloudExporter::ProgressCallback &progress,
+                          Emit emit) {
+  std::vector<char> buffer;
+  buffer.reserve(chunkSize * bytesPerPoint);
+
+  size_t n = cloud.points.size();
+  for (size_t begin = 0; begin < n; begin += chunkSize) {
+    size_t end = std::min(begin + chunkSize, n);
+
+    buffer.clear();
+    for (size_t i = begin; i < end; i++) {
+      const pcl::PointXYZRGB &p = cloud.points[i];
+      if (isValid(p)) emit(p, buffer);
+    }
+
+    file.write(buffer.data(), buffer.size());
+    if (!file) return statusWriteError;
+
+    if (progress && !progress((float)end / n)) return statusCancelled;
+  }
+
+  return statusOK;
+}
+
+template <typename T>
+static inline void append(std::vector<char> &buffer, const T &value) {
+  const char *bytes = (const char *)&value;
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+// Overwrites the zero padded count placeholder at offset
+static void patchCount(std::ofstream &file, std::streamoff offset,
+                       size_t count) {
+  char digits[countDigits + 1];
+  std::snprintf(digits, sizeof(digits), "%0*u", countDigits,
+                (unsigned int)count);
+  file.seekp(offset);
+  file.write(digits, countDigits);
+}
+
+static std::string countPlaceholder() { return std::string(countDigits, '0'); }
+
+static Status writePLY(const Cloud &cloud, std::ofstream &file,
+                       const PointCloudExporter::ProgressCallback &progress) {
+  std::string header =
+      "ply\n"
+      "format binary_little_endian 1.0\n"
+      "comment SLStudio\n"
+      "element vertex " +
+      countPlaceholder() +
+      "\n"
+      "property float x\n"
+      "property float y\n"
+      "property float z\n"
+      "property uchar red\n"
+      "property uchar green\n"
+      "property uchar blue\n"
+      "end_header\n";
+  std::streamoff countOffset = header.find("element vertex ") + 15;
+  file.write(header.data(), header.size());
+
+  size_t count = 0;
+  Status status = writePoints(
+      cloud, file, 15, progress,
+      [&](const pcl::PointXYZRGB &p, std::vector<char> &b) {
+        append(b, p.x);
+        append(b, p.y);
+        append(b, p.z);
+        append(b, p.r);
+        append(b, p.g);
+        append(b, p.b);
+        count++;
+      });
+  if (status != statusOK) return status;
+
+  patchCount(file, countOffset, count);
+  return file ? statusOK : statusWriteError;
+}
+
+static std::string pcdHeader(const std::string &width,
+                             const std::string &points,
+                             const std::string &data) {
+  return "# .PCD v0.7 - Point Cloud Data file format\n"
+         "VERSION 0.7\n"
+         "FIELDS x y z rgb\n"
+         "SIZE 4 4 4 4\n"
+         "TYPE F F F F\n"
+         "COUNT 1 1 1 1\n"
+         "WIDTH " +
+         width +
+         "\n"
+         "HEIGHT 1\n"
+         "VIEWPOINT 0 0 0 1 0 0 0\n"
+         "POINTS " +
+         points + "\nDATA " + data + "\n";
+}
+
+static Status writePCD(const Cloud &cloud, std::ofstream &file,
+                       const PointCloudExporter::ProgressCallback &progress) {
+  std::string header =
+      pcdHeader(countPlaceholder(), countPlaceholder(), "binary");
+  std::streamoff widthOffset = header.find("WIDTH ") + 6;
+  std::streamoff pointsOffset = header.find("POINTS ") + 7;
+  file.write(header.data(), header.size());
+
+  size_t count = 0;
+  Status status = writePoints(
+      cloud, file, 16, progress,
+      [&](const pcl::PointXYZRGB &p, std::vector<char> &b) {
+        append(b, p.x);
+        append(b, p.y);
+        append(b, p.z);
+        append(b, p.rgb);
+        count++;
+      });
+  if (status != statusOK) return status;
+
+  patchCount(file, widthOffset, count);
+  patchCount(file, pointsOffset, count);
+  return file ? statusOK : statusWriteError;
+}
+
+static Status writePCDCompressed(
+    const Cloud &cloud, std::ofstream &file,
+    const PointCloudExporter::ProgressCallback &progress) {
+  // binary_compressed stores each field contiguously
+  std::vector<float> fields[4];
+  size_t n = cloud.points.size();
+  for (int f = 0; f < 4; f++) fields[f].reserve(n);
+
+  for (size_t begin = 0; begin < n; begin += chunkSize) {
+    size_t end = std::min(begin + chunkSize, n);
+    for (size_t i = begin; i < end; i++) {
+      const pcl::PointXYZRGB &p = cloud.points[i];
+      if (!isValid(p)) continue;
+      fields[0].push_back(p.x);
+      fields[1].push_back(p.y);
+      fields[2].push_back(p.z);
+      fields[3].push_back(p.rgb);
+    }
+    // Compression takes about as long as compaction
+    if (progress && !progress(0.5f * end / n)) return statusCancelled;
+  }
+
+  size_t count = fields[0].size();
+  std::vector<char> data;
+  data.reserve(4 * count * sizeof(float));
+  for (int f = 0; f < 4; f++)
+    data.insert(data.end(), (const char *)fields[f].data(),
+                (const char *)(fields[f].data() + count));
+
+  // Same output bound as pcl::PCDWriter
+  std::vector<char> compressed((size_t)(data.size() * 1.5) + 8);
+  unsigned int compressedSize = 0;
+  if (!data.empty()) {
+    compressedSize = pcl::lzfCompress(data.data(), data.size(),
+                                      compressed.data(), compressed.size());
+    if (compressedSize == 0) return statusCompressionError;
+  }
+  unsigned int uncompressedSize = data.size();
+
+  char countString[32];
+  std::snprintf(countString, sizeof(countString), "%u", (unsigned int)count);
+  std::string header = pcdHeader(countString, countString, "binary_compressed");
+  file.write(header.data(), header.size());
+  file.write((const char *)&compressedSize, sizeof(compressedSize));
+  file.write((const char *)&uncompressedSize, sizeof(uncompressedSize));
+  file.write(compressed.data(), compressedSize);
+
+  if (progress) progress(1.0f);
+  return file ? statusOK : statusWriteError;
+}
+
+// LAS 1.2 public header block
+static const int lasHeaderSize = 227;
+static const int lasRecordLength = 26;
+// Coordinates are stored in meters with micrometer resolution
+static const double lasScale = 1e-6;
+static const double lasUnitsPerMeter = 1000.0;
+
+template <typename T>
+static inline void put(char *buffer, int offset, const T &value) {
+  std::memcpy(buffer + offset, &value, sizeof(T));
+}
+
+static Status writeLAS(const Cloud &cloud, std::ofstream &file,
+                       const PointCloudExporter::ProgressCallback &progress) {
+  char header[lasHeaderSize];
+  std::memset(header, 0, sizeof(header));
+  std::memcpy(header, "LASF", 4);
+  header[24] = 1;  // version 1.2
+  header[25] = 2;
+  std::strncpy(header + 26, "SLStudio", 32);
+  std::strncpy(header + 58, "SLStudio", 32);
+  std::time_t now = std::time(NULL);
+  std::tm *date = std::localtime(&now);
+  put<unsigned short>(header, 90, date->tm_yday + 1);
+  put<unsigned short>(header, 92, date->tm_year + 1900);
+  put<unsigned short>(header, 94, lasHeaderSize);
+  put<unsigned int>(header, 96, lasHeaderSize);  // offset to point data
+  header[104] = 2;                               // point data format
+  put<unsigned short>(header, 105, lasRecordLength);
+  put<double>(header, 131, lasScale);
+  put<double>(header, 139, lasScale);
+  put<double>(header, 147, lasScale);
+  file.write(header, sizeof(header));
+
+  size_t count = 0;
+  double minimum[3] = {INFINITY, INFINITY, INFINITY};
+  double maximum[3] = {-INFINITY, -INFINITY, -INFINITY};
+
+  Status status = writePoints(
+      cloud, file, lasRecordLength, progress,
+      [&](const pcl::PointXYZRGB &p, std::vector<char> &b) {
+        const float xyz[3] = {p.x, p.y, p.z};
+        for (int k = 0; k < 3; k++) {
+          double meters = xyz[k] / lasUnitsPerMeter;
+          minimum[k] = std::min(minimum[k], meters);
+          maximum[k] = std::max(maximum[k], meters);
+          append(b, (int)std::floor(meters / lasScale + 0.5));
+        }
+        append(b, (unsigned short)0);  // intensity
+        append(b, (unsigned char)0x09);  // return 1 of 1
+        append(b, (unsigned char)0);     // classification
+        append(b, (char)0);              // scan angle rank
+        append(b, (unsigned char)0);     // user data
+        append(b, (unsigned short)0);    // point source
+        append(b, (unsigned short)(p.r * 257));
+        append(b, (unsigned short)(p.g * 257));
+        append(b, (unsigned short)(p.b * 257));
+        count++;
+      });
+  if (status != statusOK) return status;
+
+  if (count == 0) {
+    std::fill(minimum, minimum + 3, 0.0);
+    std::fill(maximum, maximum + 3, 0.0);
+  }
+
+  put<unsigned int>(header, 107, count);
+  put<unsigned int>(header, 111, count);  // points with return number 1
+  for (int k = 0; k < 3; k++) {
+    put<double>(header, 179 + 16 * k, maximum[k]);
+    put<double>(header, 187 + 16 * k, minimum[k]);
+  }
+  file.seekp(0);
+  file.write(header, sizeof(header));
+
+  return file ? statusOK : statusWriteError;
+}
+
+static Status writeTXT(const Cloud &cloud, std::ofstream &file,
+                       const PointCloudExporter::ProgressCallback &progress) {
+  return writePoints(
+      cloud, file, 48, progress,
+      [](const pcl::PointXYZRGB &p, std::vector<char> &b) {
+        char line[64];
+        int length = std::snprintf(line, sizeof(line), "%g %g %g\r\n", p.x,
+                                   p.y, p.z);
+        b.insert(b.end(), line, line + length);
+      });
+}
+
+bool PointCloudExporter::formatFromSuffix(const std::string &suffix,
+                                          Format &format) {
+  if (suffix == "ply")
+    format = FormatPLY;
+  else if (suffix == "pcd")
+    format = FormatPCD;
+  else if (suffix == "las")
+    format = FormatLAS;
+  else if (suffix == "txt")
+    format = FormatTXT;
+  else
+    return false;
+  return true;
+}
+
+bool PointCloudExporter::write(const Cloud &cloud, const std::string &fileName,
+                               Format format, ProgressCallback progress,
+                               std::string *error) {
+  std::ofstream file(fileName.c_str(), std::ios::binary);
+  if (!file.is_open()) {
+    if (error) *error = "could not open " + fileName;
+    return false;
+  }
+
+  Status status = statusWriteError;
+  switch (format) {
+    case FormatPLY:
+      status = writePLY(cloud, file, progress);
+      break;
+    case FormatPCD:
+      status = writePCD(cloud, file, progress);
+      break;
+    case FormatPCDCompressed:
+      status = writePCDCompressed(cloud, file, progress);
+      break;
+    case FormatLAS:
+      status = writeLAS(cloud, file, progress);
+      break;
+    case FormatTXT:
+      status = writeTXT(cloud, file, progress);
+      break;
+  }
+
+  file.close();
+  if (status == statusOK && !file) status = statusWriteError;
+
+  if (status != statusOK) {
+    if (error) {
+      if (status == statusCancelled)
+        *error = "cancelled";
+      else if (status == statusCompressionError)
+        *error = "could not compress " + fileName;
+      else
+        *error = "could not write " + fileName;
+    }
+    std::remove(fileName.c_str());
+    return false;
+  }
+
+  return true;
+}
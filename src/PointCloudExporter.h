@@ -0,0 +1,37 @@
+#ifndef POINTCLOUDEXPORTER_H
+#define POINTCLOUDEXPORTER_H
+
+#include <functional>
+#include <string>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+// Fast point cloud file writers. Organized clouds are streamed in chunks of
+// rows, dropping invalid (NaN) points in the same pass. Point counts are patched
+// into the headers once all points are written.
+class PointCloudExporter {
+ public:
+  enum Format {
+    FormatPLY,            // binary little endian PLY with rgb
+    FormatPCD,            // binary PCD
+    FormatPCDCompressed,  // binary_compressed (LZF) PCD
+    FormatLAS,            // LAS 1.2, point format 2 (with rgb)
+    FormatTXT             // ASCII x y z per line
+  };
+
+  // Called with the fraction of points processed. Returning false cancels.
+  typedef std::function<bool(float)> ProgressCallback;
+
+  // Format from a file suffix (ply, pcd, las, txt), false if unknown
+  static bool formatFromSuffix(const std::string &suffix, Format &format);
+
+  // Returns false and sets error on failure or cancellation. Partially
+  // written files are removed.
+  static bool write(const pcl::PointCloud<pcl::PointXYZRGB> &cloud,
+                    const std::string &fileName, Format format,
+                    ProgressCallback progress = ProgressCallback(),
+                    std::string *error = NULL);
+};
+
+#endif
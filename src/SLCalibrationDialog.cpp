@@ -13,12 +13,16 @@
 #include "ProjectorOpenGL.h"
 #include "SLProjectorVirtual.h"
 
+#include "CalibrationBundle.h"
 #include "CalibratorLocHom.h"
 #include "CalibratorRBF.h"
 
 #include <unordered_set>
 #include "cvtools.h"
 
+// Time [ms] to wait for the projector to execute a queued flip
+static const unsigned int frameCompleteTimeout = 1000;
+
 SLCalibrationDialog::SLCalibrationDialog(SLStudio *parent)
     : QDialog(parent),
       ui(new Ui::SLCalibrationDialog),
@@ -106,6 +110,8 @@ SLCalibrationDialog::SLCalibrationDialog(SLStudio *parent)
   calibrator = new CalibratorLocHom(screenCols, screenRows);
   // calibrator = new CalibratorRBF(screenCols, screenRows);
 
+  // Sequence results arrive from background threads (queued connection)
+  qRegisterMetaType<cv::Mat>("cv::Mat");
   connect(calibrator, SIGNAL(newSequenceResult(cv::Mat, unsigned int, bool)),
           this, SLOT(onNewSequenceResult(cv::Mat, uint, bool)));
 
@@ -144,8 +150,7 @@ void SLCalibrationDialog::timerEvent(QTimerEvent *event) {
   QApplication::processEvents();
   CameraFrame frame = camera->getFrame();
 
-  cv::Mat frameCV(frame.height, frame.width, CV_8U, frame.memory);
-  frameCV = frameCV.clone();
+  cv::Mat frameCV = cameraFrameToMat(frame);
   //    cv::resize(frameCV, frameCV, cv::Size(0, 0), 0.5, 0,5);
 
   ui->videoWidget->showFrameCV(frameCV);
@@ -183,6 +188,11 @@ void SLCalibrationDialog::on_snapButton_clicked() {
   for (unsigned int i = 0; i < calibrator->getNPatterns(); i++) {
     // Project pattern
     projector->displayPattern(i);
+    // The flip is only queued, wait until it is executed
+    if (!projector->waitFrameComplete(projector->getFrameId(),
+                                      frameCompleteTimeout))
+      std::cerr << "SLCalibrationDialog: projector frame not complete!"
+                << std::endl;
     QTest::qSleep(delay);
 
     // Effectuate sleep (necessary with some camera implementations)
@@ -190,6 +200,8 @@ void SLCalibrationDialog::on_snapButton_clicked() {
 
     // Aquire frame
     CameraFrame frame = camera->getFrame();
+    // Sequences are kept for the whole session, so copy out of the driver's
+    // frame pool
     cv::Mat frameCV(frame.height, frame.width, CV_8U, frame.memory);
     frameCV = frameCV.clone();
     //        cv::resize(frameCV, frameCV, cv::Size(0, 0), 0.5, 0,5);
@@ -211,6 +223,11 @@ void SLCalibrationDialog::on_snapButton_clicked() {
                  Qt::ItemIsUserCheckable);  // set checkable flag
   item->setCheckState(Qt::Checked);         // AND initialize check state
 
+  // Start decoding and corner extraction on a background thread
+  cv::Size patternSize(ui->checkerColsBox->value(),
+                       ui->checkerRowsBox->value());
+  calibrator->addFrameSequenceIncremental(frameSeq, patternSize);
+
   //    // Allow calibration if enough frame pairs
   //    if(ui->listWidget->count() >= 3)
   ui->calibrateButton->setEnabled(true);
@@ -218,19 +235,6 @@ void SLCalibrationDialog::on_snapButton_clicked() {
   // Display white
   projector->displayWhite();
 
-  /**
-  #if 1
-    // Write frame seq to disk
-    for (unsigned int i = 0; i < frameSeq.size(); i++) {
-      // QString filename =
-      //    QString("calib_frameSeq__%1.bmp").arg(i, 2, 10, QChar('0'));
-      std::string filename = "calib_frame_seq_" + std::to_string(i) + "_" +
-                             std::to_string(m_counter) + ".bmp";
-      cv::imwrite(filename, frameSeq[i]);
-    }
-  #endif
-  **/
-
   // Restart live view
   liveViewTimer = startTimer(timerInterval);
 
@@ -268,34 +272,16 @@ void SLCalibrationDialog::
   reviewMode = true;
   ui->snapButton->setText("Live View");
 
-  calibrator->reset();
-
   // Note which frame sequences are used
   activeFrameSeqs.clear();
 
   for (int i = 0; i < ui->listWidget->count(); i++) {
-    if (ui->listWidget->item(i)->checkState() == Qt::Checked) {
-      vector<cv::Mat> frameSeq(
-          frameSeqs[i].begin(),
-          frameSeqs[i].begin() + calibrator->getNPatterns());
-      calibrator->addFrameSequence(frameSeq);
+    if (ui->listWidget->item(i)->checkState() == Qt::Checked)
       activeFrameSeqs.push_back(i);
-
-#if 1
-      // Write frame seq to disk
-      for (unsigned int j = 0; j < frameSeq.size(); j++) {
-        // QString filename =
-        //    QString("calib_frameSeq__%1.bmp").arg(i, 2, 10, QChar('0'));
-        std::string filename = "calib_frame_seq_" + std::to_string(j) + "_" +
-                               std::to_string(i) + ".bmp";
-        cv::imwrite(filename, frameSeq[j]);
-      }
-#endif
-    }
   }
 
-  // Perform calibration
-  calib = calibrator->calibrate();
+  // Perform calibration on the views extracted while snapping
+  calib = calibrator->calibrate(activeFrameSeqs);
 
   // Re-enable interface elements
   ui->calibrateButton->setEnabled(true);
@@ -328,13 +314,17 @@ void SLCalibrationDialog::on_saveButton_clicked() {
                                   .toStdString();
 
   calib.save("calibration.xml");
+
+  // Running workers switch to the new calibration with their next frame
+  CalibrationBundle::publish(CalibrationBundle::load("calibration.xml"));
+
   this->close();
 }
 
 void SLCalibrationDialog::onNewSequenceResult(cv::Mat img, unsigned int idx,
                                               bool success) {
-  // Skip non-active frame sequences
-  int idxListView = activeFrameSeqs[idx];
+  // Views are processed incrementally in the order they were snapped
+  int idxListView = idx;
 
   // Append calibration result to frame sequence
   unsigned int N = calibrator->getNPatterns();
@@ -346,9 +336,11 @@ void SLCalibrationDialog::onNewSequenceResult(cv::Mat img, unsigned int idx,
   if (!success)  // uncheck
     ui->listWidget->item(idxListView)->setCheckState(Qt::Unchecked);
 
-  // Highlight
-  ui->listWidget->setCurrentRow(idxListView);
-  ui->listWidget->setFocus();
+  // Highlight (only in review mode, live view keeps running otherwise)
+  if (reviewMode) {
+    ui->listWidget->setCurrentRow(idxListView);
+    ui->listWidget->setFocus();
+  }
 
   QApplication::processEvents();
 }
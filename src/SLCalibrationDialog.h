@@ -13,6 +13,7 @@
 #include <QModelIndex>
 
 #include "Calibrator.h"
+#include "CalibratorLocHom.h"
 #include "Camera.h"
 #include "Projector.h"
 #include "SLStudio.h"
@@ -44,7 +45,7 @@ class SLCalibrationDialog : public QDialog {
   Ui::SLCalibrationDialog *ui;
   Camera *camera;
   Projector *projector;
-  Calibrator *calibrator;
+  CalibratorLocHom *calibrator;
   Calibrator *recalibrator;
   CalibrationData calib;
   int liveViewTimer;
@@ -13,6 +13,7 @@
 #include "CodecPhaseShift2p1.h"
 #include "CodecFastRatio.h"
 #include "CodecGrayCode.h"
+#include "PatternCache.h"
 
 std::vector<CameraInfo> SLCameraVirtual::getCameraList(){
 
@@ -36,29 +37,59 @@ SLCameraVirtual::SLCameraVirtual(unsigned int, CameraTriggerMode triggerMode): C
         std::cerr << "SLCameraVirtual: invalid coding direction " << std::endl;
 
     QString patternMode = settings.value("pattern/mode", "CodecPhaseShift3").toString();
-    if(patternMode == "CodecPhaseShift3")
-        encoder = new EncoderPhaseShift3(frameWidth, frameHeight, dir);
-    else if(patternMode == "CodecPhaseShift4")
-        encoder = new EncoderPhaseShift4(frameWidth, frameHeight, dir);
-    else if(patternMode == "CodecPhaseShift2x3")
-        encoder = new EncoderPhaseShift2x3(frameWidth, frameHeight, dir);
-    else if(patternMode == "CodecPhaseShift3Unwrap")
-        encoder = new EncoderPhaseShift3Unwrap(frameWidth, frameHeight, dir);
-    else if(patternMode == "CodecPhaseShiftNStep")
-        encoder = new EncoderPhaseShiftNStep(frameWidth, frameHeight, dir);
-    else if(patternMode == "CodecPhaseShift3FastWrap")
-        encoder = new EncoderPhaseShift3FastWrap(frameWidth, frameHeight, dir);
-    else if(patternMode == "CodecPhaseShift2p1")
-        encoder = new EncoderPhaseShift2p1(frameWidth, frameHeight, dir);
-    else if(patternMode == "CodecFastRatio")
-        encoder = new EncoderFastRatio(frameWidth, frameHeight, dir);
-    else if(patternMode == "CodecGrayCode")
-        encoder = new EncoderGrayCode(frameWidth, frameHeight, dir);
-    else
-        std::cerr << "SLScanWorker: invalid pattern mode " << patternMode.toStdString() << std::endl;
-
-
-    currentBuffer.create(frameHeight, frameWidth, CV_8U);
+
+    // Patterns are only regenerated if not cached. Single channel frames, keyed apart from projector patterns.
+    PatternCache::Key cacheKey;
+    cacheKey.codec = patternMode.toStdString() + "_virtualcamera";
+    cacheKey.screenCols = frameWidth;
+    cacheKey.screenRows = frameHeight;
+    cacheKey.dir = dir;
+
+    patterns = PatternCache::shared().get(cacheKey, [&](){
+        Encoder *encoder = NULL;
+        if(patternMode == "CodecPhaseShift3")
+            encoder = new EncoderPhaseShift3(frameWidth, frameHeight, dir);
+        else if(patternMode == "CodecPhaseShift4")
+            encoder = new EncoderPhaseShift4(frameWidth, frameHeight, dir);
+        else if(patternMode == "CodecPhaseShift2x3")
+            encoder = new EncoderPhaseShift2x3(frameWidth, frameHeight, dir);
+        else if(patternMode == "CodecPhaseShift3Unwrap")
+            encoder = new EncoderPhaseShift3Unwrap(frameWidth, frameHeight, dir);
+        else if(patternMode == "CodecPhaseShiftNStep")
+            encoder = new EncoderPhaseShiftNStep(frameWidth, frameHeight, dir);
+        else if(patternMode == "CodecPhaseShift3FastWrap")
+            encoder = new EncoderPhaseShift3FastWrap(frameWidth, frameHeight, dir);
+        else if(patternMode == "CodecPhaseShift2p1")
+            encoder = new EncoderPhaseShift2p1(frameWidth, frameHeight, dir);
+        else if(patternMode == "CodecFastRatio")
+            encoder = new EncoderFastRatio(frameWidth, frameHeight, dir);
+        else if(patternMode == "CodecGrayCode")
+            encoder = new EncoderGrayCode(frameWidth, frameHeight, dir);
+        else
+            std::cerr << "SLScanWorker: invalid pattern mode " << patternMode.toStdString() << std::endl;
+
+        std::vector<cv::Mat> ret;
+        if(!encoder)
+            return ret;
+
+        for(unsigned int i=0; i<encoder->getNPatterns(); i++){
+            cv::Mat patternCV = encoder->getEncodingPattern(i);
+
+            // pick out first channel
+            cv::Mat patternCVChannels[3];
+            cv::split(patternCV, patternCVChannels);
+            patternCV = patternCVChannels[0];
+
+            // general repmat
+            cv::Mat frameCV;
+            frameCV = cv::repeat(patternCV, (frameHeight+patternCV.rows-1)/patternCV.rows, (frameWidth+patternCV.cols-1)/patternCV.cols);
+            frameCV = frameCV(cv::Range(0, frameHeight), cv::Range(0, frameWidth));
+            ret.push_back(frameCV.clone());
+        }
+
+        delete encoder;
+        return ret;
+    });
 
     std::cout << "SLCameraVirtual: Virtual Camera Started" << std::endl;
 }
@@ -89,37 +120,33 @@ void SLCameraVirtual::stopCapture(){
 
 CameraFrame SLCameraVirtual::getFrame(){
 
-    unsigned int depth = counter % encoder->getNPatterns();
-    cv::Mat patternCV = encoder->getEncodingPattern(depth);
-
-    // pick out first channel
-    cv::Mat patternCVChannels[3];
-    cv::split(patternCV, patternCVChannels);
-    patternCV = patternCVChannels[0];
+    CameraFrame frame;
+    if(patterns.empty())
+        return frame;
 
-    // general repmat
-    cv::Mat frameCV;
-    frameCV = cv::repeat(patternCV, (frameHeight+patternCV.rows-1)/patternCV.rows, (frameWidth+patternCV.cols-1)/patternCV.cols);
-    frameCV = frameCV(cv::Range(0, frameHeight), cv::Range(0, frameWidth));
-    frameCV = frameCV.clone();
+    unsigned int depth = counter % patterns.size();
 
     // add noise
-    frameCV.convertTo(frameCV, CV_32F);
+    cv::Mat frameCV;
+    patterns[depth].convertTo(frameCV, CV_32F);
     cv::Mat noise(frameCV.size(), frameCV.type());
     cv::randn(noise, 0, 3);
     frameCV += noise;
-    frameCV.convertTo(currentBuffer, CV_8U);
+
+    // render into pooled buffer, which stays valid while referenced
+    cv::Mat buffer = framePool.acquire(frameHeight, frameWidth, CV_8U);
+    frameCV.convertTo(buffer, CV_8U);
     counter++;
 
  //cv::imwrite("frameCV.png", frameCV);
 
     // return as CameraFrame struct
-    CameraFrame frame;
-    frame.height = currentBuffer.rows;
-    frame.width = currentBuffer.cols;
-    frame.memory = currentBuffer.data;
+    frame.height = buffer.rows;
+    frame.width = buffer.cols;
+    frame.memory = buffer.data;
     frame.timeStamp = counter;
-    frame.sizeBytes = currentBuffer.rows*currentBuffer.cols;
+    frame.sizeBytes = buffer.rows*buffer.cols;
+    frame.buffer = buffer;
 
     return frame;
 }
@@ -140,7 +167,6 @@ size_t SLCameraVirtual::getFrameHeight(){
 
 
 SLCameraVirtual::~SLCameraVirtual(){
-    delete encoder;
 }
 
 
@@ -9,6 +9,7 @@
 #define SLCAMERAVIRTUAL_H
 
 #include "Camera.h"
+#include "CameraFramePool.h"
 #include "Codec.h"
 
 // Virtual Camera Implementation
@@ -29,9 +30,10 @@ class SLCameraVirtual : public Camera {
         ~SLCameraVirtual();
     private:
         unsigned int frameWidth, frameHeight;
-        Encoder *encoder;
+        // Single channel patterns in frame resolution
+        std::vector<cv::Mat> patterns;
         unsigned long counter;
-        cv::Mat currentBuffer;
+        CameraFramePool framePool;
 };
 
 #endif
@@ -14,8 +14,6 @@
 #include "CodecPhaseShiftModulated.h"
 #include "CodecPhaseShiftNStep.h"
 
-#include "CalibrationData.h"
-
 #include <QCoreApplication>
 #include <QSettings>
 
@@ -24,6 +22,11 @@
 #include "cvtools.h"
 
 void SLDecoderWorker::setup() {
+  // The decoder is set up with the calibration of the first frame sequence
+  time.start();
+}
+
+void SLDecoderWorker::setupDecoder(const CalibrationData &calib) {
   // Initialize decoder
   QSettings settings("SLStudio");
 
@@ -34,9 +37,6 @@ void SLDecoderWorker::setup() {
   bool diamondPattern =
       settings.value("projector/diamondPattern", false).toBool();
 
-  CalibrationData calib;
-  calib.load("calibration.xml");
-
   if (diamondPattern) {
     screenCols = 2 * calib.screenResX;
     screenRows = calib.screenResY;
@@ -45,6 +45,9 @@ void SLDecoderWorker::setup() {
     screenRows = calib.screenResY;
   }
 
+  delete decoder;
+  decoder = NULL;
+
   QString patternMode =
       settings.value("pattern/mode", "CodecPhaseShift3").toString();
   if (patternMode == "CodecPhaseShift3")
@@ -76,11 +79,10 @@ void SLDecoderWorker::setup() {
   else
     std::cerr << "SLDecoderWorker: invalid pattern mode "
               << patternMode.toStdString() << std::endl;
-
-  time.start();
 }
 
-void SLDecoderWorker::decodeSequence(std::vector<cv::Mat> frameSeq) {
+void SLDecoderWorker::decodeSequence(std::vector<cv::Mat> frameSeq,
+                                     CalibrationBundle::ConstPtr frameBundle) {
   // Recursively call self until latest event is hit
   busy = true;
   QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
@@ -93,8 +95,21 @@ void SLDecoderWorker::decodeSequence(std::vector<cv::Mat> frameSeq) {
 
   time.restart();
 
-  for (unsigned int i = 0; i < frameSeq.size(); i++)
-    decoder->setFrame(i, frameSeq[i]);
+  // The screen resolution is that of the calibration the patterns were
+  // generated with
+  if (frameBundle != bundle) {
+    bundle = frameBundle;
+    setupDecoder(bundle->getCalibration());
+  }
+  if (!decoder) return;
+
+  for (unsigned int i = 0; i < frameSeq.size(); i++) {
+    // Decoders without 16 bit support get frames scaled to 8 bit
+    cv::Mat frame = frameSeq[i];
+    if (frame.depth() == CV_16U && !decoder->supportsFrameDepth(CV_16U))
+      frame.convertTo(frame, CV_8U, 1.0 / 257.0);
+    decoder->setFrame(i, frame);
+  }
 
   // Decode frame sequence
   cv::Mat mask(frameSeq[0].size(), cv::DataType<bool>::type);
@@ -109,7 +124,7 @@ void SLDecoderWorker::decodeSequence(std::vector<cv::Mat> frameSeq) {
   decoder->decodeFrames(up, vp, mask, shading);
 
   // Emit result
-  emit newUpVp(up, vp, mask, shading);
+  emit newUpVp(up, vp, mask, shading, bundle);
 
   if (!up.empty()) {
     cv::Mat upMasked;
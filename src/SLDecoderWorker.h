@@ -11,26 +11,30 @@
 #include <QObject>
 #include <QTime>
 
+#include "CalibrationBundle.h"
 #include "Codec.h"
 
 class SLDecoderWorker : public QObject {
     Q_OBJECT
 
     public:
-        SLDecoderWorker(): screenCols(0), screenRows(0){}
+        SLDecoderWorker(): decoder(NULL), screenCols(0), screenRows(0){}
         ~SLDecoderWorker();
     public slots:
         void setup();
-        void decodeSequence(std::vector<cv::Mat> frameSeq);
+        void decodeSequence(std::vector<cv::Mat> frameSeq, CalibrationBundle::ConstPtr frameBundle);
     signals:
         void imshow(const char* windowName, cv::Mat mat, unsigned int x, unsigned int y);
         void showShading(cv::Mat mat);
         void showDecoderUp(cv::Mat mat);
         void showDecoderVp(cv::Mat mat);
-        void newUpVp(cv::Mat up, cv::Mat vp, cv::Mat mask, cv::Mat shading);
+        void newUpVp(cv::Mat up, cv::Mat vp, cv::Mat mask, cv::Mat shading, CalibrationBundle::ConstPtr bundle);
         void error(QString err);
         //void finished();
     private:
+        void setupDecoder(const CalibrationData &calibration);
+        // Calibration of the current decoder
+        CalibrationBundle::ConstPtr bundle;
         Decoder *decoder;
         unsigned int screenCols, screenRows;
         QTime time;
@@ -0,0 +1,77 @@
+#include "SLExportWorker.h"
+
+#include <QFileInfo>
+#include <QSettings>
+
+#include <pcl/conversions.h>
+#include <pcl/io/png_io.h>
+#include <pcl/io/vtk_io.h>
+
+#include "DepthImagePCL.h"
+#include "PointCloudExporter.h"
+
+void SLExportWorker::queueExport(DepthImageConstPtr depthImage,
+                                 QString fileName) {
+  cancelled = false;
+  QMetaObject::invokeMethod(this, "exportDepthImage", Qt::QueuedConnection,
+                            Q_ARG(DepthImageConstPtr, depthImage),
+                            Q_ARG(QString, fileName));
+}
+
+void SLExportWorker::exportDepthImage(DepthImageConstPtr depthImage,
+                                      QString fileName) {
+  lastPercent = -1;
+
+  PointCloudConstPtr pointCloud =
+      depthImageToPointCloud<pcl::PointXYZRGB>(*depthImage);
+
+  std::string path = fileName.toLocal8Bit().constData();
+  std::string type = QFileInfo(fileName).suffix().toLower().toStdString();
+
+  // Formats without a fast writer go through PCL, without progress
+  if (type == "vtk") {
+    pcl::PCLPointCloud2 pointCloud2;
+    pcl::toPCLPointCloud2(*pointCloud, pointCloud2);
+    if (pcl::io::saveVTKFile(path, pointCloud2) != 0)
+      emit finished("Could not write " + fileName);
+    else
+      emit finished(QString());
+    return;
+  } else if (type == "png") {
+    pcl::io::savePNGFile(path, *pointCloud, "rgb");
+    emit finished(QString());
+    return;
+  }
+
+  PointCloudExporter::Format format;
+  if (!PointCloudExporter::formatFromSuffix(type, format)) {
+    emit finished("Unknown point cloud format " + QString::fromStdString(type));
+    return;
+  }
+
+  QSettings settings("SLStudio");
+  if (format == PointCloudExporter::FormatPCD &&
+      settings.value("pointCloud/compressPCD", false).toBool())
+    format = PointCloudExporter::FormatPCDCompressed;
+
+  std::string error;
+  bool success = PointCloudExporter::write(
+      *pointCloud, path, format,
+      [this](float fraction) { return reportProgress(fraction); }, &error);
+
+  // Cancelled exports are removed silently
+  if (success || cancelled)
+    emit finished(QString());
+  else
+    emit finished(QString::fromStdString(error));
+}
+
+bool SLExportWorker::reportProgress(float fraction) {
+  // Only emit on changes to limit queued signals
+  int percent = (int)(100.0f * fraction);
+  if (percent != lastPercent) {
+    lastPercent = percent;
+    emit progress(percent);
+  }
+  return !cancelled;
+}
@@ -0,0 +1,42 @@
+/*
+ *
+ SLStudio - Platform for Real-Time  Structured Light
+ (c) 2013 -- 2014 Jakob Wilm, DTU, Kgs.Lyngby, Denmark
+ *
+*/
+
+#ifndef SLEXPORTWORKER_H
+#define SLEXPORTWORKER_H
+
+#include <QObject>
+#include <QString>
+
+#include <atomic>
+
+#include "SLPointCloudWidget.h"
+
+// Writes point clouds to disk on its own thread, such that saving large
+// clouds does not block the UI
+class SLExportWorker : public QObject {
+    Q_OBJECT
+
+    public:
+        SLExportWorker() : cancelled(false), lastPercent(-1){}
+        // Thread safe, runs exportDepthImage() on the worker thread. A cancel
+        // requested after this call applies to the queued export.
+        void queueExport(DepthImageConstPtr depthImage, QString fileName);
+    public slots:
+        void exportDepthImage(DepthImageConstPtr depthImage, QString fileName);
+        // Thread safe, may be called directly from the UI thread
+        void cancel(){cancelled = true;}
+    signals:
+        void progress(int percent);
+        // Empty error on success or cancellation
+        void finished(QString error);
+    private:
+        bool reportProgress(float fraction);
+        std::atomic<bool> cancelled;
+        int lastPercent;
+};
+
+#endif
@@ -1,17 +1,22 @@
 #include "SLPointCloudWidget.h"
 
 #include <opencv2/core/eigen.hpp>
-#include "calibrator/CalibrationData.h"
+#include "CalibrationBundle.h"
+#include "SLExportWorker.h"
 
 #include <vtkPNGWriter.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
 #include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+#include <vtkRendererCollection.h>
+#include <vtkUnsignedCharArray.h>
 #include <vtkWindowToImageFilter.h>
 
 #include <pcl/common/io.h>
 #include <pcl/geometry/quad_mesh.h>
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
-#include <pcl/visualization/point_cloud_color_handlers.h>
 
 #include <pcl/conversions.h>
 #include <pcl/filters/crop_box.h>
@@ -24,13 +29,25 @@
 #include <pcl/io/vtk_io.h>
 #include <vtkPolyDataWriter.h>
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 
 #include <QFileDialog>
+#include <QGuiApplication>
 #include <QKeyEvent>
+#include <QMessageBox>
+#include <QProgressDialog>
+#include <QScreen>
+#include <QSettings>
+#include <QThread>
+#include <QTimerEvent>
 
 SLPointCloudWidget::SLPointCloudWidget(QWidget* parent)
-    : QVTKWidget(parent), surfaceReconstruction(false) {
+    : QVTKWidget(parent),
+      depthImagePending(false),
+      colorByDepth(false),
+      surfaceReconstruction(false) {
   visualizer = new pcl::visualization::PCLVisualizer("PCLVisualizer", false);
   this->SetRenderWindow(visualizer->getRenderWindow());
 
@@ -48,22 +65,64 @@ SLPointCloudWidget::SLPointCloudWidget(QWidget* parent)
   visualizer->addCoordinateSystem(50, "camera", 0);
   visualizer->setCameraPosition(0, 0, -50, 0, 0, 0, 0, -1, 0);
   visualizer->setCameraClipDistances(0.001, 10000000);
-  // Initialize point cloud color handler
-  colorHandler = new pcl::visualization::PointCloudColorHandlerRGBField<
-      pcl::PointXYZRGB>();
 
-  // Initialize surface reconstruction objection
-  reconstructor = new pcl::OrganizedFastMesh<pcl::PointXYZRGB>;
+  // Point cloud display geometry. VTK keeps the vertex buffers of the mapper
+  // and re-uploads the point and color arrays when they are modified.
+  displayPolyData = vtkSmartPointer<vtkPolyData>::New();
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  points->SetDataTypeToFloat();
+  displayPolyData->SetPoints(points);
+  vtkSmartPointer<vtkUnsignedCharArray> colors =
+      vtkSmartPointer<vtkUnsignedCharArray>::New();
+  colors->SetNumberOfComponents(3);
+  colors->SetName("rgb");
+  displayPolyData->GetPointData()->SetScalars(colors);
+  displayPolyData->SetVerts(vtkSmartPointer<vtkCellArray>::New());
+  displayPolyData->SetPolys(vtkSmartPointer<vtkCellArray>::New());
+  displayVertexIds = vtkSmartPointer<vtkIdTypeArray>::New();
+  displayTriangleIds = vtkSmartPointer<vtkIdTypeArray>::New();
+
+  displayMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+  displayMapper->SetInputData(displayPolyData);
+  displayMapper->SetScalarModeToUsePointData();
+  displayMapper->ScalarVisibilityOn();
+
+  displayActor = vtkSmartPointer<vtkActor>::New();
+  displayActor->SetMapper(displayMapper);
+  visualizer->getRendererCollection()->GetFirstRenderer()->AddActor(
+      displayActor);
+
+  QSettings settings("SLStudio");
+  displayStep = settings.value("pointCloud/displayStep", 0).toUInt();
+  maxDisplayPoints =
+      settings.value("pointCloud/maxDisplayPoints", 300000).toUInt();
+  mesher.setMaxDepthJump(
+      settings.value("pointCloud/meshMaxDepthJump", 0.02).toFloat());
+
+  // Clouds are drawn at the display refresh rate, independent of the rate at
+  // which they arrive
+  double refreshRate = 60.0;
+  if (QGuiApplication::primaryScreen())
+    refreshRate = QGuiApplication::primaryScreen()->refreshRate();
+  if (refreshRate <= 0.0) refreshRate = 60.0;
+  displayTimer = startTimer(std::max(1, (int)(1000.0 / refreshRate)),
+                            Qt::PreciseTimer);
+
+  exportProgress = NULL;
+  exportWorker = new SLExportWorker;
+  exportThread = new QThread(this);
+  exportThread->setObjectName("exportThread");
+  exportWorker->moveToThread(exportThread);
+  connect(exportThread, SIGNAL(finished()), exportWorker, SLOT(deleteLater()));
+  connect(exportWorker, SIGNAL(finished(QString)), this,
+          SLOT(exportFinished(QString)));
+  exportThread->start(QThread::LowPriority);
 
-  // reconstructor->setTriangulationType(pcl::OrganizedFastMesh<pcl::PointXYZRGB>::TRIANGLE_ADAPTIVE_CUT);
-  // reconstructor->setMaxEdgeLength(3.0);
-  // reconstructor->setTrianglePixelSize(2);
   time.start();
 }
 
 void SLPointCloudWidget::updateCalibration() {
-  CalibrationData calibration;
-  calibration.load("calibration.xml");
+  CalibrationData calibration = CalibrationBundle::current()->getCalibration();
 
   visualizer->removeCoordinateSystem("camera", 0);
   visualizer->removeCoordinateSystem("projector", 0);
@@ -87,97 +146,177 @@ void SLPointCloudWidget::keyPressEvent(QKeyEvent* event) {
   switch (event->key()) {
     case '1':
       surfaceReconstruction = false;
-      visualizer->removePolygonMesh("meshPCL");
-      colorHandler = new pcl::visualization::PointCloudColorHandlerRGBField<
-          pcl::PointXYZRGB>();
+      colorByDepth = false;
       break;
     case '2':
       surfaceReconstruction = false;
-      visualizer->removePolygonMesh("meshPCL");
-      colorHandler = new pcl::visualization::PointCloudColorHandlerGenericField<
-          pcl::PointXYZRGB>("z");
+      colorByDepth = true;
       break;
     case '3':
       surfaceReconstruction = true;
-      visualizer->removePointCloud("pointCloudPCL");
       break;
   }
 
-  updatePointCloud(pointCloudPCL);
+  updateDepthImage(depthImage);
 
   if (!(('0' <= event->key()) & (event->key() <= '9')))
     QVTKWidget::keyPressEvent(event);
 }
 
-void SLPointCloudWidget::updatePointCloud(PointCloudConstPtr _pointCloudPCL) {
-  if (!_pointCloudPCL || _pointCloudPCL->points.empty()) return;
+void SLPointCloudWidget::updateDepthImage(DepthImageConstPtr _depthImage) {
+  if (!_depthImage || _depthImage->z.empty()) return;
 
-  //    time.restart();
+  // Depth images arriving before the next draw replace each other, such that
+  // the triangulator is never held up by rendering
+  depthImage = _depthImage;
+  depthImagePending = true;
+}
 
-  pointCloudPCL = _pointCloudPCL;
-
-  // Uncomment this if you are not applying any filter
-  auto filtered_pc_ptr = pointCloudPCL;
-
-  /**
-  // We leave only points within the SL sensor's FoV
-  float minX = -500.0f;
-  float maxX = 500.0f;
-  float minZ = 0.0f;
-  float maxZ = 1000.0f;
-  float minY = -500.0f;
-  float maxY = 500.0f;
-
-  pcl::PointCloud<pcl::PointXYZRGB>::Ptr filtered_pc_ptr(
-      new pcl::PointCloud<pcl::PointXYZRGB>());
-  pcl::CropBox<pcl::PointXYZRGB> boxFilter;
-  boxFilter.setMin(Eigen::Vector4f(minX, minY, minZ, 1.0));
-  boxFilter.setMax(Eigen::Vector4f(maxX, maxY, maxZ, 1.0));
-  boxFilter.setInputCloud(pointCloudPCL);
-  boxFilter.filter(*filtered_pc_ptr);
-
-  // Statistical Outlier Removal to further remove outlier points
-  pcl::StatisticalOutlierRemoval<pcl::PointXYZRGB> sor;
-  sor.setInputCloud(filtered_pc_ptr);
-  sor.setMeanK(50);
-  sor.setStddevMulThresh(1.0);
-  sor.filter(*filtered_pc_ptr);
-
-  pointCloudPCL = filtered_pc_ptr;
-  **/
-
-  if (surfaceReconstruction) {
-    reconstructor->setInputCloud(filtered_pc_ptr);
-    std::vector<pcl::Vertices> polygons;
-    reconstructor->reconstruct(polygons);
-    if (!visualizer->updatePolygonMesh<pcl::PointXYZRGB>(filtered_pc_ptr,
-                                                         polygons, "meshPCL")) {
-      visualizer->addPolygonMesh<pcl::PointXYZRGB>(filtered_pc_ptr, polygons,
-                                                   "meshPCL");
-    }
-  } else {
-    // Note: using the color handler makes a copy of the rgb fields
-    colorHandler->setInputCloud(filtered_pc_ptr);
-    if (!visualizer->updatePointCloud(filtered_pc_ptr, *colorHandler,
-                                      "pointCloudPCL")) {
-      visualizer->addPointCloud(filtered_pc_ptr, *colorHandler,
-                                "pointCloudPCL");
-      // visualizer->setPointCloudRenderingProperties(pcl::visualization::PCL_VISUALIZER_POINT_SIZE,
-      // 1.0, "pointCloudPCL");
-    }
+void SLPointCloudWidget::timerEvent(QTimerEvent* event) {
+  if (event->timerId() != displayTimer) {
+    QVTKWidget::timerEvent(event);
+    return;
   }
 
+  if (!depthImagePending) return;
+  depthImagePending = false;
+
+  drawPointCloud();
+}
+
+void SLPointCloudWidget::drawPointCloud() {
+  //    time.restart();
+
+  drawDecimated(*depthImage);
+
   this->update();
   emit newPointCloudDisplayed();
 
   //    std::cout << "PCL Widget: " << time.restart() << "ms" << std::endl;
 }
 
+void SLPointCloudWidget::drawDecimated(const DepthImage& image) {
+  unsigned int width = image.cols();
+  unsigned int height = image.rows();
+
+  // Every step-th point in both directions
+  unsigned int step = std::max(displayStep, 1u);
+  if (displayStep == 0) {
+    while (((width + step - 1) / step) * ((height + step - 1) / step) >
+           maxDisplayPoints)
+      step++;
+  }
+
+  unsigned int gridCols = (width + step - 1) / step;
+  unsigned int gridRows = (height + step - 1) / step;
+  unsigned int maxPoints = gridCols * gridRows;
+
+  // The mesh needs the full grid, such that invalid points are kept
+  bool mesh = surfaceReconstruction;
+  if (mesh) meshDepth.resize(maxPoints);
+
+  vtkPoints* points = displayPolyData->GetPoints();
+  vtkUnsignedCharArray* colors = vtkUnsignedCharArray::SafeDownCast(
+      displayPolyData->GetPointData()->GetScalars());
+
+  // Shrinking keeps the allocation, such that buffers are reused
+  points->SetNumberOfPoints(maxPoints);
+  colors->SetNumberOfTuples(maxPoints);
+  float* xyz = static_cast<float*>(points->GetData()->GetVoidPointer(0));
+  unsigned char* rgb = colors->GetPointer(0);
+
+  // Without mesh, valid points are compacted to the front
+  unsigned int n = 0;
+  float zMin = INFINITY, zMax = -INFINITY;
+  for (unsigned int r = 0; r < height; r += step) {
+    const float* zRow = image.z.ptr<float>(r);
+    const unsigned char* shading = image.shading.ptr<unsigned char>(r);
+    const cv::Vec2f* ray = image.rays.ptr<cv::Vec2f>(r);
+    for (unsigned int c = 0; c < width; c += step) {
+      float z = zRow[c];
+      if (mesh) {
+        meshDepth[n] = z;
+        if (!std::isfinite(z)) {
+          // Not referenced by any triangle, but part of the bounds
+          xyz[3 * n + 0] = xyz[3 * n + 1] = xyz[3 * n + 2] = 0.0f;
+          rgb[3 * n + 0] = rgb[3 * n + 1] = rgb[3 * n + 2] = 0;
+          n++;
+          continue;
+        }
+      } else if (!std::isfinite(z)) {
+        continue;
+      }
+      xyz[3 * n + 0] = z * ray[c][0];
+      xyz[3 * n + 1] = z * ray[c][1];
+      xyz[3 * n + 2] = z;
+      rgb[3 * n + 0] = rgb[3 * n + 1] = rgb[3 * n + 2] = shading[c];
+      zMin = std::min(zMin, z);
+      zMax = std::max(zMax, z);
+      n++;
+    }
+  }
+
+  // Jet color map over the displayed depth range
+  if (colorByDepth && n > 0) {
+    float scale = (zMax > zMin) ? 1.0f / (zMax - zMin) : 0.0f;
+    for (unsigned int i = 0; i < n; i++) {
+      if (mesh && !std::isfinite(meshDepth[i])) continue;
+      float t = (xyz[3 * i + 2] - zMin) * scale;
+      rgb[3 * i + 0] = 255.0f * std::min(
+          1.0f, std::max(0.0f, 1.5f - std::abs(4.0f * t - 3.0f)));
+      rgb[3 * i + 1] = 255.0f * std::min(
+          1.0f, std::max(0.0f, 1.5f - std::abs(4.0f * t - 2.0f)));
+      rgb[3 * i + 2] = 255.0f * std::min(
+          1.0f, std::max(0.0f, 1.5f - std::abs(4.0f * t - 1.0f)));
+    }
+  }
+
+  points->SetNumberOfPoints(n);
+  colors->SetNumberOfTuples(n);
+
+  if (mesh) {
+    size_t nTriangles;
+    const unsigned int* triangles =
+        mesher.mesh(&meshDepth[0], gridCols, gridRows, nTriangles);
+
+    // Legacy cell layout (3, a, b, c)
+    displayTriangleIds->SetNumberOfValues(4 * nTriangles);
+    vtkIdType* ids = displayTriangleIds->GetPointer(0);
+    for (size_t i = 0; i < nTriangles; i++) {
+      ids[4 * i + 0] = 3;
+      ids[4 * i + 1] = triangles[3 * i + 0];
+      ids[4 * i + 2] = triangles[3 * i + 1];
+      ids[4 * i + 3] = triangles[3 * i + 2];
+    }
+    displayPolyData->GetPolys()->SetCells(nTriangles, displayTriangleIds);
+    displayPolyData->GetVerts()->Reset();
+  } else {
+    // Single poly vertex cell. Ids are only written when the count grows.
+    vtkIdType nIds = displayVertexIds->GetNumberOfTuples();
+    if (nIds < (vtkIdType)n + 1) {
+      displayVertexIds->SetNumberOfValues(n + 1);
+      for (vtkIdType i = std::max((vtkIdType)1, nIds); i <= (vtkIdType)n; i++)
+        displayVertexIds->SetValue(i, i - 1);
+    }
+    displayVertexIds->SetNumberOfValues(n + 1);
+    displayVertexIds->SetValue(0, n);
+    displayPolyData->GetVerts()->SetCells(1, displayVertexIds);
+    displayPolyData->GetPolys()->Reset();
+  }
+
+  points->Modified();
+  colors->Modified();
+  displayPolyData->Modified();
+}
+
 void SLPointCloudWidget::savePointCloud() {
+  // One export at a time
+  if (exportProgress) return;
+
   QString selectedFilter;
   QString fileName = QFileDialog::getSaveFileName(
-      this, "Save Point Cloud", QString(), "*.pcd;;*.ply;;*.vtk;;*.png;;*.txt",
-      &selectedFilter);
+      this, "Save Point Cloud", QString(),
+      "*.pcd;;*.ply;;*.las;;*.vtk;;*.png;;*.txt", &selectedFilter);
   QFileInfo info(fileName);
   QString type = info.suffix();
   if (type == "") {
@@ -185,38 +324,31 @@ void SLPointCloudWidget::savePointCloud() {
     type = selectedFilter.remove(0, 1);
   }
 
-  if (type == "pcd") {
-    pcl::io::savePCDFileASCII(fileName.toStdString(), *pointCloudPCL);
-  } else if (type == "ply") {
-    // pcl::io::savePLYFileBinary( fileName.toStdString(), *pointCloudPCL);
-    pcl::PLYWriter w;
-    // Write to ply in binary without camera
-    w.write<pcl::PointXYZRGB>(fileName.toStdString(), *pointCloudPCL, true,
-                              false);
-  } else if (type == "vtk") {
-    pcl::PCLPointCloud2 pointCloud2;
-    pcl::toPCLPointCloud2(*pointCloudPCL, pointCloud2);
-    pcl::io::saveVTKFile(fileName.toStdString(), pointCloud2);
-
-    //        vtkPolyData polyData;
-    //        pcl::io::pointCloudTovtkPolyData(*pointCloudPCL, polyData);
-    //        vtkPolyDataWriter::Pointer writer = vtkPolyDataWriter::New();
-    //        writer->SetInput(polyData);
-    //        writer->SetFileName(fileName.toStdString());
-    //        writer->Update();
-  } else if (type == "png") {
-    pcl::io::savePNGFile(fileName.toStdString(), *pointCloudPCL, "rgb");
-  } else if (type == "txt") {
-    std::ofstream s(fileName.toLocal8Bit());
-    for (unsigned int r = 0; r < pointCloudPCL->height; r++) {
-      for (unsigned int c = 0; c < pointCloudPCL->width; c++) {
-        pcl::PointXYZRGB p = pointCloudPCL->at(c, r);
-        if (p.x == p.x) s << p.x << " " << p.y << " " << p.z << "\r\n";
-      }
-    }
-    std::flush(s);
-    s.close();
+  if (fileName.isEmpty() || !depthImage) return;
+
+  exportProgress = new QProgressDialog("Saving point cloud...", "Cancel", 0,
+                                       100, this);
+  exportProgress->setWindowModality(Qt::WindowModal);
+  exportProgress->setMinimumDuration(500);
+  connect(exportWorker, SIGNAL(progress(int)), exportProgress,
+          SLOT(setValue(int)));
+  // Direct connection, as the worker thread is busy writing
+  connect(exportProgress, SIGNAL(canceled()), exportWorker, SLOT(cancel()),
+          Qt::DirectConnection);
+
+  // Depth images are immutable once published, so the worker may read it
+  // concurrently
+  exportWorker->queueExport(depthImage, fileName);
+}
+
+void SLPointCloudWidget::exportFinished(QString error) {
+  if (exportProgress) {
+    exportProgress->deleteLater();
+    exportProgress = NULL;
   }
+
+  if (!error.isEmpty())
+    QMessageBox::warning(this, "Save Point Cloud", error);
 }
 
 void SLPointCloudWidget::saveScreenShot() {
@@ -238,5 +370,8 @@ void SLPointCloudWidget::saveScreenShot() {
 }
 
 SLPointCloudWidget::~SLPointCloudWidget() {
+  exportWorker->cancel();
+  exportThread->quit();
+  exportThread->wait();
   // delete visualizer;
 }
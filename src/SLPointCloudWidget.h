@@ -13,12 +13,24 @@
 #ifndef Q_MOC_RUN
     #include <QVTKWidget.h>
     #include <pcl/visualization/pcl_visualizer.h>
-    #include <pcl/surface/organized_fast_mesh.h>
     #include <Eigen/Eigen>
+    #include <vtkActor.h>
+    #include <vtkCellArray.h>
+    #include <vtkIdTypeArray.h>
+    #include <vtkPolyData.h>
+    #include <vtkPolyDataMapper.h>
+    #include <vtkSmartPointer.h>
 #endif
 
 #include <opencv2/opencv.hpp>
 
+#include "DepthImage.h"
+#include "OrganizedMesher.h"
+
+class QProgressDialog;
+class QThread;
+class SLExportWorker;
+
 typedef pcl::PointCloud<pcl::PointXYZRGB>::Ptr PointCloudPtr;
 typedef pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr PointCloudConstPtr;
 
@@ -29,20 +41,43 @@ class SLPointCloudWidget : public QVTKWidget {
         ~SLPointCloudWidget();
     protected:
         void keyPressEvent(QKeyEvent *event);
+        void timerEvent(QTimerEvent *event);
     public slots:
-        void updatePointCloud(PointCloudConstPtr _pointCloudPCL);
+        // Only the newest depth image is drawn at the next display refresh
+        void updateDepthImage(DepthImageConstPtr _depthImage);
         void savePointCloud();
         void saveScreenShot();
         void updateCalibration();
+    private slots:
+        void exportFinished(QString error);
     signals:
         void newPointCloudDisplayed();
     private:
+        void drawPointCloud();
+        void drawDecimated(const DepthImage &image);
         pcl::visualization::PCLVisualizer *visualizer;
-        PointCloudConstPtr pointCloudPCL;
-        pcl::visualization::PointCloudColorHandler<pcl::PointXYZRGB>* colorHandler;
+        DepthImageConstPtr depthImage;
+        // Newest depth image not yet drawn
+        bool depthImagePending;
+        int displayTimer;
+        // Display every displayStep-th organized point, 0 for maxDisplayPoints
+        unsigned int displayStep;
+        unsigned int maxDisplayPoints;
+        bool colorByDepth;
+        // Persistent display geometry, whose buffers are updated in place
+        vtkSmartPointer<vtkPolyData> displayPolyData;
+        vtkSmartPointer<vtkIdTypeArray> displayVertexIds;
+        vtkSmartPointer<vtkIdTypeArray> displayTriangleIds;
+        vtkSmartPointer<vtkPolyDataMapper> displayMapper;
+        vtkSmartPointer<vtkActor> displayActor;
         bool surfaceReconstruction;
-        pcl::OrganizedFastMesh<pcl::PointXYZRGB> *reconstructor;
+        OrganizedMesher mesher;
+        std::vector<float> meshDepth;
         QTime time;
+        // Clouds are saved on a separate thread
+        QThread *exportThread;
+        SLExportWorker *exportWorker;
+        QProgressDialog *exportProgress;
 };
 
 #endif // SLPOINTCLOUDWIDGET_H
@@ -1,6 +1,7 @@
 #include "SLScanWorker.h"
 
 #include <QCoreApplication>
+#include <QDir>
 #include <QSettings>
 #include <QTest>
 #include <QTime>
@@ -23,6 +24,8 @@
 #include "CodecPhaseShiftMicro.h"
 #include "CodecPhaseShiftModulated.h"
 #include "CodecPhaseShiftNStep.h"
+#include "CalibrationBundle.h"
+#include "PatternCache.h"
 
 #include "ProjectorLC3000.h"
 #include "ProjectorLC4500.h"
@@ -30,13 +33,18 @@
 #include "ProjectorOpenGL.h"
 
 #include "CameraSpinnaker.h"
+#include "SequenceAligner.h"
 #include "SLCameraVirtual.h"
 #include "SLPointCloudWidget.h"
 #include "SLProjectorVirtual.h"
 
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
+// Time [ms] to wait for the projector to execute a queued flip
+static const unsigned int frameCompleteTimeout = 1000;
+
 void SLScanWorker::setup() {
   QSettings settings("SLStudio");
 
@@ -67,6 +75,21 @@ void SLScanWorker::setup() {
   camSettings.gain = 0.0;
   camera->setCameraSettings(camSettings);
 
+  // 16 bit frames give the decoders more bit depth for dark, shiny surfaces.
+  // The packed formats need less bandwidth than Mono16.
+  QString pixelFormat = settings.value("camera/pixelFormat", "Mono8").toString();
+  CameraPixelFormat cameraPixelFormat = pixelFormatMono8;
+  if (pixelFormat == "Mono16")
+    cameraPixelFormat = pixelFormatMono16;
+  else if (pixelFormat == "Mono10p")
+    cameraPixelFormat = pixelFormatMono10p;
+  else if (pixelFormat == "Mono12p")
+    cameraPixelFormat = pixelFormatMono12p;
+  if (cameraPixelFormat != pixelFormatMono8 &&
+      !camera->setPixelFormat(cameraPixelFormat))
+    std::cerr << "SLScanWorker: camera does not support "
+              << pixelFormat.toStdString() << ", using Mono8" << std::endl;
+
   // Initialize projector
   int screenNum = settings.value("projector/screenNumber", -1).toInt();
   if (screenNum >= 0)
@@ -175,38 +198,32 @@ void SLScanWorker::setup() {
   projector->loadParam("display_horizontal_pattern",
                        void_display_horizontal_pattern);
 
-  projector->init();
-
-  // Lens correction and upload patterns to projector/GPU
-  CalibrationData calibration;
-  calibration.load("calibration.xml");
-
-  cv::Mat map1, map2;
-  cv::Size mapSize = cv::Size(screenCols, screenRows);
-  cvtools::initDistortMap(calibration.Kp, calibration.kp, mapSize, map1, map2);
-
-  std::cout << calibration.Kp << std::endl;
-
-  std::cout << calibration.kp << std::endl;
+  projector->loadParam("diamond_pattern",
+                       std::make_shared<bool>(diamondPattern));
 
-  // Upload patterns to projector/GPU in full projector resolution
-  for (unsigned int i = 0; i < encoder->getNPatterns(); i++) {
-    cv::Mat pattern = encoder->getEncodingPattern(i);
+  projector->init();
 
-    // general repmat
-    pattern = cv::repeat(pattern, screenRows / pattern.rows + 1,
-                         screenCols / pattern.cols + 1);
-    pattern = pattern(cv::Range(0, screenRows), cv::Range(0, screenCols));
+  // Patterns the projector can render itself need no precomputation
+  proceduralPatterns =
+      settings.value("projector/proceduralPatterns", true).toBool();
 
-    // correct for lens distortion
-    cv::remap(pattern, pattern, map1, map2, CV_INTER_CUBIC);
+  // Full resolution, lens corrected patterns, generated only on a cache miss
+  cacheKey = PatternCache::Key();
+  cacheKey.codec = patternMode.toStdString();
+  cacheKey.screenCols = screenCols;
+  cacheKey.screenRows = screenRows;
+  cacheKey.dir = dir;
+  cacheKey.diamond = diamondPattern;
 
-    if (diamondPattern) pattern = cvtools::diamondDownsample(pattern);
+  QString cacheDir = settings.value("pattern/cacheDir", "").toString();
+  if (!cacheDir.isEmpty()) QDir().mkpath(cacheDir);
+  PatternCache::shared().setDiskCacheDir(cacheDir.toStdString());
 
-    projector->setPattern(i, pattern.ptr(), pattern.cols, pattern.rows);
+  writePatterns = settings.value("writeToDisk/patterns", false).toBool();
 
-    cv::imwrite(cv::format("scan_pat_%d.bmp", i), pattern);
-  }
+  // Lens correction parameters. A calibration published later is swapped in
+  // by doWork() between sequences.
+  applyCalibration(CalibrationBundle::current());
 
   //    // Upload patterns to projector/GPU in compact resolution (texture)
   //    for(unsigned int i=0; i<encoder->getNPatterns(); i++){
@@ -234,6 +251,70 @@ void SLScanWorker::setup() {
   writeToDisk = settings.value("writeToDisk/frames", false).toBool();
 }
 
+void SLScanWorker::applyCalibration(CalibrationBundle::ConstPtr newBundle) {
+  bundle = newBundle;
+  CalibrationData calibration = bundle->getCalibration();
+
+  // Procedural patterns are corrected by the projector when drawn
+  projector->loadParam("projector_Kp",
+                       std::make_shared<cv::Matx33f>(calibration.Kp));
+  projector->loadParam("projector_kp",
+                       std::make_shared<cv::Vec<float, 5> >(calibration.kp));
+
+  cacheKey.calibrationHash =
+      PatternCache::hashCalibration(calibration.Kp, calibration.kp);
+
+  unsigned int screenCols = cacheKey.screenCols;
+  unsigned int screenRows = cacheKey.screenRows;
+  bool diamondPattern = cacheKey.diamond;
+
+  auto generatePatterns = [&]() {
+    std::vector<cv::Mat> patterns(encoder->getNPatterns());
+
+    cv::Mat map1, map2;
+    cv::Size mapSize = cv::Size(screenCols, screenRows);
+    cvtools::cachedDistortMap(calibration.Kp, calibration.kp, mapSize, map1,
+                              map2);
+
+    for (unsigned int i = 0; i < patterns.size(); i++) {
+      cv::Mat pattern = encoder->getEncodingPattern(i);
+
+      // general repmat
+      pattern = cv::repeat(pattern, screenRows / pattern.rows + 1,
+                           screenCols / pattern.cols + 1);
+      pattern = pattern(cv::Range(0, screenRows), cv::Range(0, screenCols));
+
+      // correct for lens distortion
+      cv::remap(pattern, pattern, map1, map2, CV_INTER_CUBIC);
+
+      if (diamondPattern) pattern = cvtools::diamondDownsample(pattern);
+
+      if (writePatterns)
+        cv::imwrite(cv::format("scan_pat_%d.bmp", i), pattern);
+
+      patterns[i] = pattern;
+    }
+
+    return patterns;
+  };
+
+  std::vector<cv::Mat> patterns;
+
+  // Upload patterns to projector/GPU in full projector resolution
+  for (unsigned int i = 0; i < encoder->getNPatterns(); i++) {
+    PatternDescriptor descriptor;
+    if (proceduralPatterns && encoder->getPatternDescriptor(i, descriptor) &&
+        projector->setPatternProcedural(i, descriptor))
+      continue;
+
+    if (patterns.empty())
+      patterns = PatternCache::shared().get(cacheKey, generatePatterns);
+
+    const cv::Mat &pattern = patterns[i];
+    projector->setPattern(i, pattern.ptr(), pattern.cols, pattern.rows);
+  }
+}
+
 void SLScanWorker::doWork() {
   // State variable
   isWorking = true;
@@ -249,71 +330,176 @@ void SLScanWorker::doWork() {
   unsigned int shift = settings.value("trigger/shift", "0").toInt();
   unsigned int delay = settings.value("trigger/delay", "100").toInt();
 
+  // Timeout for one complete sequence
+  std::chrono::milliseconds sequenceTimeout(
+      settings.value("trigger/sequenceTimeout", 1000).toInt());
+
+  // Projectors running the sequence by themselves let the camera collect all
+  // frames in one call
+  bool batchAcquisition =
+      (triggerMode == triggerModeHardware) && projector->isSequencing();
+
+  // If the projector reports its trigger times in the camera's clock, frames
+  // are assigned to patterns by timestamp instead of by arrival order and
+  // trigger/shift
+  bool timestampAlignment = batchAcquisition &&
+                            camera->isFrameTimeRosTime() &&
+                            projector->hasOutput("image_period") &&
+                            projector->hasOutput("sequence_start_times");
+  double imagePeriod = 0.0;
+  if (timestampAlignment)
+    imagePeriod = std::static_pointer_cast<ros::Duration>(
+                      projector->getOutput("image_period"))
+                      ->toSec();
+
+  // Tolerance of a quarter frame period, trigger/offset is the nominal camera
+  // latency [ms]
+  SequenceAligner aligner(
+      N, 0.25 * imagePeriod,
+      1e-3 * settings.value("trigger/offset", 0.0).toDouble());
+
+  unsigned long alignedBatches = 0;
+
   QTime time;
   time.start();
 
+  // Reused across sequences
+  CameraFrameSequence cameraSeq;
+
   // Processing loop
   do {
     std::vector<cv::Mat> frameSeq(N);
     bool success = true;
 
+    // Swap in a newly published calibration without restarting the pipeline,
+    // the decoder and triangulator follow the bundle stamped on the sequence
+    CalibrationBundle::ConstPtr currentBundle = CalibrationBundle::current();
+    bool calibrationChanged = (currentBundle != bundle);
+    if (calibrationChanged) {
+      std::cout << "SLScanWorker: applying new calibration" << std::endl;
+      applyCalibration(currentBundle);
+    }
+
     time.restart();
 
     projector->displayPattern(0);
 
-    // Acquire patterns
-    for (unsigned int i = 0; i < N; i++) {
-      // Project coded pattern
-      projector->displayPattern(i);
-
-      if (triggerMode == triggerModeSoftware) {
-        // Wait one frame period to rotate projector frame buffer
-        QTest::qSleep(delay);
-      } else {
-        // Wait a few milliseconds to allow camera to get ready
-        // QTest::qSleep(1);
+    if (timestampAlignment) {
+      // Camera delivers frames in arrival order, the aligner assigns them to
+      // the projector's triggers
+      auto deadline = std::chrono::steady_clock::now() + sequenceTimeout;
+      camera->getFrameSequence(N, deadline, cameraSeq);
+      for (unsigned int i = 0; i < cameraSeq.frames.size(); i++) {
+        const CameraFrame& frame = cameraSeq.frames[i];
+        if (frame.memory) aligner.addFrame(frame.time, cameraFrameToMat(frame));
       }
-
-      if (i == 0 && triggerMode == triggerModeHardware) {
-        // First pattern we delay entire camera by 1ms behind pattern changes
-        // std::this_thread::sleep_for(std::chrono::milliseconds(1)); // For
-        // blackfly
-
-        // std::this_thread::sleep_for(std::chrono::milliseconds(15)); //
-        // Grasshopper overlapping trigger
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(0));
+      cameraSeq.frames.clear();
+
+      std::shared_ptr<std::vector<double> > sequenceStartTimes =
+          std::static_pointer_cast<std::vector<double> >(
+              projector->getOutput("sequence_start_times"));
+      for (double startTime : *sequenceStartTimes)
+        for (unsigned int i = 0; i < N; i++)
+          aligner.addTrigger(startTime + i * imagePeriod, i);
+
+      // Only the newest complete sequence is decoded
+      success = false;
+      while (aligner.popSequence(frameSeq)) success = true;
+
+      if (++alignedBatches % 100 == 0) {
+        SequenceAligner::Statistics stats = aligner.getStatistics();
+        std::cout << "SLScanWorker: alignment offset " << 1e3 * stats.meanOffset
+                  << " +- " << 1e3 * stats.stdOffset << " ms, drift "
+                  << 1e6 * stats.drift << " ppm, " << stats.nSequences
+                  << " sequences, " << stats.nDroppedSequences
+                  << " dropped, " << stats.nUnmatchedFrames
+                  << " unmatched frames, " << stats.nMissedTriggers
+                  << " missed triggers" << std::endl;
       }
-
-      if (triggerMode == triggerModeHardware) {
-        camera->get_input("expected_image_time",
-                          projector->getOutput("expected_image_time"));
+    } else if (batchAcquisition) {
+      // Tell the camera when the sequence's images are expected
+      std::shared_ptr<void> expectedImageTime =
+          projector->getOutput("expected_image_time");
+      if (expectedImageTime)
+        camera->get_input("expected_image_time", expectedImageTime);
+      std::shared_ptr<void> imagePeriod = projector->getOutput("image_period");
+      if (imagePeriod) camera->get_input("image_period", imagePeriod);
+
+      auto deadline = std::chrono::steady_clock::now() + sequenceTimeout;
+      camera->getFrameSequence(N, deadline, cameraSeq);
+
+      // The sequence started in the middle of the batch, collect the
+      // remaining frames such that each pattern is covered once
+      unsigned int start = std::max(cameraSeq.startIndex, 0);
+      if (start > 0) {
+        CameraFrameSequence tailSeq;
+        camera->getFrameSequence(start, deadline, tailSeq);
+        cameraSeq.frames.insert(cameraSeq.frames.end(), tailSeq.frames.begin(),
+                                tailSeq.frames.end());
+        cameraSeq.nMissing += tailSeq.nMissing;
       }
 
-      CameraFrame frame;
-      frame = camera->getFrame();
-
-      if (!frame.memory) {
-        std::cerr << "SLScanWorker: missed frame!" << std::endl;
+      if (cameraSeq.nMissing > 0) {
+        std::cerr << "SLScanWorker: missed " << cameraSeq.nMissing
+                  << " frames!" << std::endl;
         success = false;
       }
 
-      std::cout << frame.flags << std::endl;
-
-      // If the camera provides a sequence start flag
-      if (frame.flags != 0) {
-        std::cout << "reset" << std::endl;
-        i = 0;
+      // Create OpenCV matrices (sharing the driver's frame buffers if
+      // provided)
+      for (unsigned int i = 0; i < N && success; i++)
+        frameSeq[(i + N - shift) % N] =
+            cameraFrameToMat(cameraSeq.frames[start + i]);
+
+      // Release driver buffers not handed on to the decoder
+      cameraSeq.frames.resize(N);
+    } else {
+      // Acquire patterns
+      for (unsigned int i = 0; i < N; i++) {
+        // Project coded pattern
+        projector->displayPattern(i);
+
+        if (triggerMode == triggerModeSoftware) {
+          // Display calls return once the flip is queued, wait until it is
+          // executed and then one frame period to rotate projector frame
+          // buffer
+          if (!projector->waitFrameComplete(projector->getFrameId(),
+                                            frameCompleteTimeout))
+            std::cerr << "SLScanWorker: projector frame not complete!"
+                      << std::endl;
+          QTest::qSleep(delay);
+        }
+
+        if (triggerMode == triggerModeHardware) {
+          std::shared_ptr<void> expectedImageTime =
+              projector->getOutput("expected_image_time");
+          if (expectedImageTime)
+            camera->get_input("expected_image_time", expectedImageTime);
+        }
+
+        CameraFrame frame;
+        frame = camera->getFrame();
+
+        if (!frame.memory) {
+          std::cerr << "SLScanWorker: missed frame!" << std::endl;
+          success = false;
+          continue;
+        }
+
+        // If the camera provides a sequence start flag
+        if (frame.flags != 0) {
+          std::cout << "reset" << std::endl;
+          i = 0;
+        }
+
+        // Create OpenCV matrix (shares the driver's frame buffer if provided)
+        cv::Mat frameCV = cameraFrameToMat(frame);
+
+        if (triggerMode == triggerModeHardware)
+          frameSeq[(i + N - shift) % N] = frameCV;
+        else
+          frameSeq[i] = frameCV;
       }
-
-      // Create 8 bit OpenCV matrix
-      cv::Mat frameCV(frame.height, frame.width, CV_8U, frame.memory);
-      frameCV = frameCV.clone();
-
-      if (triggerMode == triggerModeHardware)
-        frameSeq[(i + N - shift) % N] = frameCV;
-      else
-        frameSeq[i] = frameCV;
     }
 
     float sequenceTime = time.restart();
@@ -328,18 +514,25 @@ void SLScanWorker::doWork() {
       continue;
     }
 
+    // A self-sequencing projector may have exposed part of this sequence with
+    // the previous patterns
+    if (calibrationChanged && batchAcquisition) continue;
+
     // Write frames to disk if desired
     if (writeToDisk) {
       for (unsigned int i = 0; i < frameSeq.size(); i++) {
-        QString filename = QString("frameSeq_%2_%1.bmp")
+        // BMP has no 16 bit grayscale
+        QString filename = QString("frameSeq_%2_%1.%3")
                                .arg(i, 2, 10, QChar('0'))
-                               .arg(k, 2, 10, QChar('0'));
+                               .arg(k, 2, 10, QChar('0'))
+                               .arg(frameSeq[i].depth() == CV_16U ? "png"
+                                                                  : "bmp");
         filename = cv::imwrite(filename.toStdString(), frameSeq[i]);
       }
     }
 
     // Pass frame sequence to decoder
-    emit newFrameSeq(frameSeq);
+    emit newFrameSeq(frameSeq, bundle);
 
     // Calculate and show histogram of sumimage
     /**
@@ -12,9 +12,11 @@
 #include <QThread>
 #include <QMainWindow>
 
+#include "CalibrationBundle.h"
 #include "Camera.h"
 #include "Projector.h"
 #include "Codec.h"
+#include "PatternCache.h"
 
 #include "SLDecoderWorker.h"
 #include "SLTriangulatorWorker.h"
@@ -36,15 +38,22 @@ class SLScanWorker : public QObject {
         //void hist(const char* windowName, cv::Mat mat, unsigned int x, unsigned int y);
         void showHistogram(cv::Mat im);
         void newFrame(cv::Mat frame);
-        void newFrameSeq(std::vector<cv::Mat> frameSeq);
+        void newFrameSeq(std::vector<cv::Mat> frameSeq, CalibrationBundle::ConstPtr bundle);
         void error(QString err);
         void finished();
     private:
+        // Loads the lens correction into the projector and uploads the patterns
+        void applyCalibration(CalibrationBundle::ConstPtr newBundle);
 
         bool isWorking;
         Camera *camera;
         Projector *projector;
         Encoder *encoder;
+        // Calibration the patterns were generated with
+        CalibrationBundle::ConstPtr bundle;
+        PatternCache::Key cacheKey;
+        bool proceduralPatterns;
+        bool writePatterns;
 
         CameraTriggerMode triggerMode;
         ScanAquisitionMode aquisition;
@@ -0,0 +1,126 @@
+#include "SLStreamWorker.h"
+
+#include <QCoreApplication>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSettings>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+static uint64_t timestampNow() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+void SLStreamWorker::setup() {
+  QSettings settings("SLStudio");
+  encoder.setDepthResolution(
+      settings.value("stream/depthResolution", 0.05).toFloat());
+  maxQueuedFrames =
+      std::max(1u, settings.value("stream/maxQueuedFrames", 2).toUInt());
+
+  // Clients connecting before the first depth image get the current
+  // calibration
+  updateCalibration(CalibrationBundle::current());
+
+  // A Unix domain socket if named, TCP on the loopback interface otherwise
+  QString socketName = settings.value("stream/socketName", "").toString();
+  if (!socketName.isEmpty()) {
+    localServer = new QLocalServer(this);
+    QLocalServer::removeServer(socketName);
+    if (!localServer->listen(socketName))
+      std::cerr << "SLStreamWorker: could not listen on "
+                << socketName.toStdString() << ": "
+                << localServer->errorString().toStdString() << std::endl;
+    connect(localServer, SIGNAL(newConnection()), this,
+            SLOT(onNewConnection()));
+  } else {
+    tcpServer = new QTcpServer(this);
+    quint16 port = settings.value("stream/port", 5678).toUInt();
+    if (!tcpServer->listen(QHostAddress::LocalHost, port))
+      std::cerr << "SLStreamWorker: could not listen on port " << port << ": "
+                << tcpServer->errorString().toStdString() << std::endl;
+    connect(tcpServer, SIGNAL(newConnection()), this,
+            SLOT(onNewConnection()));
+  }
+}
+
+void SLStreamWorker::updateCalibration(CalibrationBundle::ConstPtr _bundle) {
+  if (_bundle == bundle) return;
+  bundle = _bundle;
+
+  const CalibrationData &calibration = bundle->getCalibration();
+  encoder.encodeCalibration(calibration.Kc, calibration.frameWidth,
+                            calibration.frameHeight, timestampNow(),
+                            calibrationFrame);
+
+  // Connected clients get the new calibration ahead of the next depth frame
+  send(calibrationFrame, false);
+}
+
+void SLStreamWorker::onNewConnection() {
+  while (tcpServer && tcpServer->hasPendingConnections()) {
+    QTcpSocket *socket = tcpServer->nextPendingConnection();
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    addClient(socket);
+  }
+  while (localServer && localServer->hasPendingConnections())
+    addClient(localServer->nextPendingConnection());
+}
+
+void SLStreamWorker::addClient(QIODevice *client) {
+  connect(client, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+  client->write(calibrationFrame.data(), calibrationFrame.size());
+  clients.append(client);
+}
+
+void SLStreamWorker::onDisconnected() {
+  QIODevice *client = qobject_cast<QIODevice *>(sender());
+  clients.removeAll(client);
+  if (client) client->deleteLater();
+}
+
+void SLStreamWorker::send(const std::vector<char> &frame, bool droppable) {
+  for (QIODevice *client : clients) {
+    // Sockets buffer writes without blocking. Drop frames for clients that
+    // do not keep up, instead of buffering without bound.
+    if (droppable &&
+        client->bytesToWrite() > (qint64)(maxQueuedFrames - 1) * frame.size()) {
+      if (++nDropped % 100 == 1)
+        std::cerr << "SLStreamWorker: dropped " << nDropped
+                  << " frames for slow clients" << std::endl;
+      continue;
+    }
+    client->write(frame.data(), frame.size());
+  }
+}
+
+void SLStreamWorker::streamDepthImage(DepthImageConstPtr depthImage) {
+  // Recursively call self until latest event is hit
+  busy = true;
+  QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+  bool result = busy;
+  busy = false;
+  if (!result) return;
+
+  // Keep the calibration frame in line with the depth images, also for clients
+  // connecting later
+  updateCalibration(depthImage->bundle);
+  if (clients.isEmpty()) return;
+
+  encoder.encodeDepth(*depthImage, timestampNow(), frame);
+  send(frame, true);
+}
+
+void SLStreamWorker::streamPose(Eigen::Affine3f T) {
+  if (clients.isEmpty()) return;
+
+  // Poses are small and never dropped
+  encoder.encodePose(T, timestampNow(), frame);
+  send(frame, false);
+}
@@ -0,0 +1,61 @@
+/*
+ *
+ SLStudio - Platform for Real-Time  Structured Light
+ (c) 2013 -- 2014 Jakob Wilm, DTU, Kgs.Lyngby, Denmark
+ *
+*/
+
+#ifndef SLSTREAMWORKER_H
+#define SLSTREAMWORKER_H
+
+#include <QList>
+#include <QObject>
+
+#include <vector>
+
+#include "CalibrationBundle.h"
+#include "DepthImage.h"
+#include "StreamFrameEncoder.h"
+
+#ifndef Q_MOC_RUN
+    #include <Eigen/Eigen>
+#endif
+
+class QIODevice;
+class QLocalServer;
+class QTcpServer;
+
+// Publishes depth images (compressed depth and shading) and pose estimates
+// to local clients over TCP or a Unix domain socket. See StreamFrameEncoder.h
+// for the frame format.
+class SLStreamWorker : public QObject {
+    Q_OBJECT
+
+    public:
+        SLStreamWorker() : busy(false), tcpServer(NULL), localServer(NULL), maxQueuedFrames(2), nDropped(0){}
+    public slots:
+        void setup();
+        void streamDepthImage(DepthImageConstPtr depthImage);
+        void streamPose(Eigen::Affine3f T);
+    private slots:
+        void onNewConnection();
+        void onDisconnected();
+    private:
+        void updateCalibration(CalibrationBundle::ConstPtr _bundle);
+        void addClient(QIODevice *client);
+        void send(const std::vector<char> &frame, bool droppable);
+        bool busy;
+        QTcpServer *tcpServer;
+        QLocalServer *localServer;
+        QList<QIODevice*> clients;
+        CalibrationBundle::ConstPtr bundle;
+        StreamFrameEncoder encoder;
+        std::vector<char> frame, calibrationFrame;
+        // Frames buffered per client before dropping
+        unsigned int maxQueuedFrames;
+        unsigned int nDropped;
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+#endif
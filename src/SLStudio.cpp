@@ -17,6 +17,7 @@
 
 #include "cvtools.h"
 
+#include "CalibrationBundle.h"
 #include "CameraROS.h"
 #include "CameraSpinnaker.h"
 #include "Codec.h"
@@ -45,7 +46,9 @@ SLStudio::SLStudio(QWidget *parent)
       shadingDialog(NULL),
       decoderUpDialog(NULL),
       decoderVpDialog(NULL),
-      trackerDialog(NULL) {
+      trackerDialog(NULL),
+      streamWorker(NULL),
+      streamThread(NULL) {
   ui->setupUi(this);
 
   time = new QTime;
@@ -102,6 +105,23 @@ SLStudio::SLStudio(QWidget *parent)
   ui->menuView->addAction(trackerDialog->toggleViewAction());
   trackerDialog->setVisible(
       settings->value("visible/trackerDialog", false).toBool());
+
+  // Stream worker on separate thread, running across scans such that clients
+  // stay connected
+  if (settings->value("stream/enabled", false).toBool()) {
+    qRegisterMetaType<DepthImageConstPtr>("DepthImageConstPtr");
+    qRegisterMetaType<Eigen::Affine3f>("Eigen::Affine3f");
+    streamWorker = new SLStreamWorker();
+    streamThread = new QThread(this);
+    streamThread->setObjectName("streamThread");
+    streamWorker->moveToThread(streamThread);
+    connect(streamThread, SIGNAL(started()), streamWorker, SLOT(setup()));
+    connect(streamThread, SIGNAL(finished()), streamWorker,
+            SLOT(deleteLater()));
+    connect(trackerDialog, SIGNAL(newPoseEstimate(Eigen::Affine3f)),
+            streamWorker, SLOT(streamPose(Eigen::Affine3f)));
+    streamThread->start(QThread::LowPriority);
+  }
 }
 
 void SLStudio::onShowHistogram(cv::Mat im) {
@@ -163,27 +183,41 @@ void SLStudio::onActionStart() {
   qRegisterMetaType<cv::Mat>("cv::Mat");
   qRegisterMetaType<std::vector<cv::Mat> >("std::vector<cv::Mat>");
   qRegisterMetaType<PointCloudConstPtr>("PointCloudConstPtr");
+  qRegisterMetaType<DepthImageConstPtr>("DepthImageConstPtr");
+  qRegisterMetaType<CalibrationBundle::ConstPtr>("CalibrationBundle::ConstPtr");
 
   // Inter thread connections
   connect(scanWorker, SIGNAL(showHistogram(cv::Mat)), this,
           SLOT(onShowHistogram(cv::Mat)));
-  connect(scanWorker, SIGNAL(newFrameSeq(std::vector<cv::Mat>)), decoderWorker,
-          SLOT(decodeSequence(std::vector<cv::Mat>)));
-  connect(scanWorker, SIGNAL(newFrameSeq(std::vector<cv::Mat>)), this,
-          SLOT(onShowCameraFrames(std::vector<cv::Mat>)));
+  connect(scanWorker,
+          SIGNAL(newFrameSeq(std::vector<cv::Mat>,
+                             CalibrationBundle::ConstPtr)),
+          decoderWorker,
+          SLOT(decodeSequence(std::vector<cv::Mat>,
+                              CalibrationBundle::ConstPtr)));
+  connect(scanWorker,
+          SIGNAL(newFrameSeq(std::vector<cv::Mat>,
+                             CalibrationBundle::ConstPtr)),
+          this, SLOT(onShowCameraFrames(std::vector<cv::Mat>)));
   connect(decoderWorker, SIGNAL(showShading(cv::Mat)), this,
           SLOT(onShowShading(cv::Mat)));
   connect(decoderWorker, SIGNAL(showDecoderUp(cv::Mat)), this,
           SLOT(onShowDecoderUp(cv::Mat)));
   connect(decoderWorker, SIGNAL(showDecoderVp(cv::Mat)), this,
           SLOT(onShowDecoderVp(cv::Mat)));
-  connect(decoderWorker, SIGNAL(newUpVp(cv::Mat, cv::Mat, cv::Mat, cv::Mat)),
+  connect(decoderWorker,
+          SIGNAL(newUpVp(cv::Mat, cv::Mat, cv::Mat, cv::Mat,
+                         CalibrationBundle::ConstPtr)),
           triangulatorWorker,
-          SLOT(triangulatePointCloud(cv::Mat, cv::Mat, cv::Mat, cv::Mat)));
-  connect(triangulatorWorker, SIGNAL(newPointCloud(PointCloudConstPtr)), this,
-          SLOT(receiveNewPointCloud(PointCloudConstPtr)));
+          SLOT(triangulatePointCloud(cv::Mat, cv::Mat, cv::Mat, cv::Mat,
+                                     CalibrationBundle::ConstPtr)));
+  connect(triangulatorWorker, SIGNAL(newDepthImage(DepthImageConstPtr)), this,
+          SLOT(receiveNewDepthImage(DepthImageConstPtr)));
   connect(triangulatorWorker, SIGNAL(imshow(const char *, cv::Mat, uint, uint)),
           this, SLOT(imshow(const char *, cv::Mat, uint, uint)));
+  if (streamWorker)
+    connect(triangulatorWorker, SIGNAL(newDepthImage(DepthImageConstPtr)),
+            streamWorker, SLOT(streamDepthImage(DepthImageConstPtr)));
 
   // Start threads
   decoderThread->start(QThread::LowPriority);
@@ -242,6 +276,8 @@ void SLStudio::onScanWorkerFinished() {
 void SLStudio::onActionCalibration() {
   SLCalibrationDialog *calibrationDialog = new SLCalibrationDialog(this);
   calibrationDialog->exec();
+
+  ui->pointCloudWidget->updateCalibration();
 }
 
 void SLStudio::onActionPreferences() {
@@ -268,13 +304,13 @@ void SLStudio::updateDisplayRate() {
   ui->statusBar->showMessage(fpsString);
 }
 
-void SLStudio::receiveNewPointCloud(PointCloudConstPtr pointCloud) {
+void SLStudio::receiveNewDepthImage(DepthImageConstPtr depthImage) {
   // Display point cloud in widget
   if (ui->actionUpdatePointClouds->isChecked())
-    ui->pointCloudWidget->updatePointCloud(pointCloud);
+    ui->pointCloudWidget->updateDepthImage(depthImage);
 
   if (trackerDialog->isVisible())
-    trackerDialog->receiveNewPointCloud(pointCloud);
+    trackerDialog->receiveNewDepthImage(depthImage);
 }
 
 void SLStudio::closeEvent(QCloseEvent *event) {
@@ -302,6 +338,10 @@ void SLStudio::closeEvent(QCloseEvent *event) {
 }
 
 SLStudio::~SLStudio() {
+  if (streamThread) {
+    streamThread->quit();
+    streamThread->wait();
+  }
   delete ui;
   delete settings;
 }
@@ -313,6 +353,10 @@ void SLStudio::onActionLoadCalibration() {
     CalibrationData calibration;
     calibration.load(fileName);
     calibration.save("calibration.xml");
+
+    // Running workers switch to the new calibration with their next frame
+    CalibrationBundle::publish(CalibrationBundle::load("calibration.xml"));
+    ui->pointCloudWidget->updateCalibration();
   }
 }
 
@@ -493,7 +537,8 @@ void SLStudio::on_generatePatterns_clicked() {
   calibration.load("calibration.xml");
   cv::Mat map1, map2;
   cv::Size mapSize = cv::Size(screenCols, screenRows);
-  cvtools::initDistortMap(calibration.Kp, calibration.kp, mapSize, map1, map2);
+  cvtools::cachedDistortMap(calibration.Kp, calibration.kp, mapSize, map1,
+                            map2);
 
   // Create encoders
   auto encoder_2p1_horz_ptr = std::make_shared<EncoderPhaseShift2p1Tpu>(
@@ -15,6 +15,7 @@
 
 #include "SLPointCloudWidget.h"
 #include "SLScanWorker.h"
+#include "SLStreamWorker.h"
 #include "SLTrackerDialog.h"
 #include "SLTrackerWorker.h"
 #include "SLVideoDialog.h"
@@ -49,7 +50,7 @@ class SLStudio : public QMainWindow {
   void onActionExportCalibration();
 
   void updateDisplayRate();
-  void receiveNewPointCloud(PointCloudConstPtr pointCloud);
+  void receiveNewDepthImage(DepthImageConstPtr depthImage);
 
   void imshow(const char *windowName, cv::Mat im, unsigned int x,
               unsigned int y);
@@ -83,6 +84,10 @@ class SLStudio : public QMainWindow {
   SLTriangulatorWorker *triangulatorWorker;
   QThread *triangulatorThread;
 
+  // Streams results to other processes, if enabled
+  SLStreamWorker *streamWorker;
+  QThread *streamThread;
+
   QTime *time;
   QSettings *settings;
 
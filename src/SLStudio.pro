@@ -6,7 +6,7 @@
 #
 #-----------------------------------------------------
 
-QT       += core gui opengl testlib
+QT       += core gui opengl testlib network
 CONFIG   += qt thread sse2
 TARGET = SLStudio
 TEMPLATE = app
@@ -33,8 +33,15 @@ HEADERS  += SLStudio.h \
         SLPointCloudWidget.h \
         SLTrackerDialog.h \
         SLTriangulatorWorker.h \
+        SLExportWorker.h \
+        SLStreamWorker.h \
+        StreamFrameEncoder.h \
+        PointCloudExporter.h \
         SLTraceWidget.h \
         camera/Camera.h \
+        camera/CameraFramePool.h \
+        camera/PixelUnpack.h \
+        camera/SequenceAligner.h \
         projector/Projector.h \
         projector/ProjectorOpenGL.h \
         projector/OpenGLContext.h \
@@ -57,7 +64,12 @@ HEADERS  += SLStudio.h \
         codec/CodecPhaseShiftModulated.h \
         codec/CodecPhaseShiftMicro.h \
         codec/CodecPhaseShiftNStep.h \
+        codec/PatternCache.h \
         triangulator/Triangulator.h \
+        triangulator/OrganizedMesher.h \
+        triangulator/DepthImage.h \
+        triangulator/DepthImagePCL.h \
+        triangulator/CalibrationBundle.h \
         calibrator/CalibrationData.h \
         calibrator/Calibrator.h \
         calibrator/CalibratorLocHom.h \
@@ -72,6 +84,7 @@ HEADERS  += SLStudio.h \
         tracker/CorrEstKdTreeFast.h \
         tracker/TrackerPCL.h \
         tracker/PoseFilter.h \
+        tracker/PoseFilterEKF.h \
         cvtools.h \
         projector/ProjectorLC4500Versavis.h \
     codec/CodecPhaseShift2p1Tpu.h
@@ -92,8 +105,15 @@ SOURCES += main.cpp \
         SLPointCloudWidget.cpp \
         SLTrackerDialog.cpp \
         SLTriangulatorWorker.cpp \
+        SLExportWorker.cpp \
+        SLStreamWorker.cpp \
+        StreamFrameEncoder.cpp \
+        PointCloudExporter.cpp \
         SLTraceWidget.cpp \
         camera/Camera.cpp \
+        camera/CameraFramePool.cpp \
+        camera/PixelUnpack.cpp \
+        camera/SequenceAligner.cpp \
         projector/ProjectorOpenGL.cpp \
         codec/phaseunwrap.cpp \
         codec/phasecorr.cpp \
@@ -111,7 +131,11 @@ SOURCES += main.cpp \
         codec/CodecGrayCode.cpp \
         codec/pstools.cpp \
         codec/CodecPhaseShiftNStep.cpp \
+        codec/PatternCache.cpp \
         triangulator/Triangulator.cpp \
+        triangulator/OrganizedMesher.cpp \
+        triangulator/DepthImage.cpp \
+        triangulator/CalibrationBundle.cpp \
         calibrator/CalibrationData.cpp \
         calibrator/CalibratorLocHom.cpp \
         calibrator/CalibratorRBF.cpp \
@@ -372,7 +396,8 @@ unix:!macx:exists(/usr/include/spinnaker/Spinnaker.h){
 unix:!macx
 {
     DEFINES += WITH_CAMERAROS
-    HEADERS += camera/CameraROS.h
+    HEADERS += camera/CameraROS.h \
+               camera/SPSCRing.h
     SOURCES += camera/CameraROS.cpp
 }
 
@@ -393,7 +418,9 @@ SOURCES += projector/ProjectorLC3000.cpp \
 ## LC4500 Api
 DEFINES += WITH_LC4500API
 INCLUDEPATH += projector/LC4500API/
+HEADERS += projector/LC4500PatternImages.h
 SOURCES += projector/ProjectorLC4500.cpp \
+        projector/LC4500PatternImages.cpp \
         projector/LC4500API/dlpc350_api.cpp \
         projector/LC4500API/dlpc350_usb.cpp \
         projector/LC4500API/dlpc350_common.cpp \
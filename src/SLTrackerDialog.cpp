@@ -27,8 +27,8 @@ QAction* SLTrackerDialog::toggleViewAction(){
     return action;
 }
 
-void SLTrackerDialog::receiveNewPointCloud(PointCloudConstPtr pointCloud){
-    emit newPointCloud(pointCloud);
+void SLTrackerDialog::receiveNewDepthImage(DepthImageConstPtr depthImage){
+    emit newDepthImage(depthImage);
 }
 
 SLTrackerDialog::~SLTrackerDialog(){
@@ -51,7 +51,7 @@ void SLTrackerDialog::on_startStopPushButton_clicked(){
         QMetaObject::invokeMethod(trackerWorker, "setup");
 
         qRegisterMetaType< Eigen::Affine3f >("Eigen::Affine3f");
-        connect(this, SIGNAL(newPointCloud(PointCloudConstPtr)), trackerWorker, SLOT(trackPointCloud(PointCloudConstPtr)));
+        connect(this, SIGNAL(newDepthImage(DepthImageConstPtr)), trackerWorker, SLOT(trackDepthImage(DepthImageConstPtr)));
 //        connect(trackerWorker, SIGNAL(newPoseEstimate(Eigen::Affine3f)), ui->poseWidget, SLOT(showPoseEstimate(Eigen::Affine3f)));
         connect(trackerWorker, SIGNAL(newPoseEstimate(Eigen::Affine3f)), this, SLOT(showPoseEstimate(Eigen::Affine3f)));
         connect(trackerWorkerThread, SIGNAL(finished()), trackerWorker, SLOT(deleteLater()));
@@ -83,6 +83,8 @@ void SLTrackerDialog::closeEvent(QCloseEvent *){
 
 void SLTrackerDialog::showPoseEstimate(Eigen::Affine3f T){
 
+    emit newPoseEstimate(T);
+
     if(ui->poseTab->isVisible()){
         ui->poseWidget->showPoseEstimate(T);
     } else if(ui->traceTab->isVisible()){
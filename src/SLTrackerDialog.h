@@ -27,12 +27,13 @@ class SLTrackerDialog : public QDialog {
         void closeEvent(QCloseEvent *);
         ~SLTrackerDialog();
     public slots:
-        void receiveNewPointCloud(PointCloudConstPtr pointCloud);
+        void receiveNewDepthImage(DepthImageConstPtr depthImage);
         void showPoseEstimate(Eigen::Affine3f T);
     private slots:
         void on_startStopPushButton_clicked();
     signals:
-        void newPointCloud(PointCloudConstPtr pointCloud);
+        void newDepthImage(DepthImageConstPtr depthImage);
+        void newPoseEstimate(Eigen::Affine3f T);
     private:
         Ui::SLTrackerDialog *ui;
         QThread *trackerWorkerThread;
@@ -1,5 +1,4 @@
 #include "SLTrackerWorker.h"
-#include "CalibrationData.h"
 
 #include <QSettings>
 #include <QEvent>
@@ -8,19 +7,13 @@
 #include "TrackerICP.h"
 #include "TrackerNDT.h"
 #include "TrackerPCL.h"
+#include "DepthImagePCL.h"
 #include <Eigen/Eigen>
 
 void SLTrackerWorker::setup(){
 
     // Initialize the tracker object
     tracker = new TrackerICP();
-    CalibrationData calibration = CalibrationData();
-    calibration.load("calibration.xml");
-    Eigen::Matrix3f Kc;
-    Kc << calibration.Kc(0,0), calibration.Kc(0,1), calibration.Kc(0,2),
-          calibration.Kc(1,0), calibration.Kc(1,1), calibration.Kc(1,2),
-          calibration.Kc(2,0), calibration.Kc(2,1), calibration.Kc(2,2);
-    tracker->setCameraMatrix(Kc);
 
     QSettings settings("SLStudio");
     writeToDisk = settings.value("writeToDisk/tracking",false).toBool();
@@ -37,13 +30,24 @@ void SLTrackerWorker::setup(){
     }
 }
 
+void SLTrackerWorker::setCalibration(CalibrationBundle::ConstPtr _bundle){
+
+    bundle = _bundle;
+    const CalibrationData &calibration = bundle->getCalibration();
+    Eigen::Matrix3f Kc;
+    Kc << calibration.Kc(0,0), calibration.Kc(0,1), calibration.Kc(0,2),
+          calibration.Kc(1,0), calibration.Kc(1,1), calibration.Kc(1,2),
+          calibration.Kc(2,0), calibration.Kc(2,1), calibration.Kc(2,2);
+    tracker->setCameraMatrix(Kc);
+}
+
 void SLTrackerWorker::setReference(PointCloudConstPtr referencePointCloud){
     tracker->setReference(referencePointCloud);
     referenceSet = true;
     return;
 }
 
-void SLTrackerWorker::trackPointCloud(PointCloudConstPtr pointCloud){
+void SLTrackerWorker::trackDepthImage(DepthImageConstPtr depthImage){
 
     // Recursively call self until latest event is hit
     busy = true;
@@ -55,6 +59,13 @@ void SLTrackerWorker::trackPointCloud(PointCloudConstPtr pointCloud){
         return;
     }
 
+    // Track with the calibration the depth image was triangulated with
+    if(depthImage->bundle != bundle)
+        setCalibration(depthImage->bundle);
+
+    // The PCL trackers need an organized point cloud
+    PointCloudConstPtr pointCloud = depthImageToPointCloud<pcl::PointXYZRGB>(*depthImage);
+
     if(!referenceSet){
         tracker->setReference(pointCloud);
         referenceSet = true;
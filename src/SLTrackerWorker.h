@@ -13,6 +13,8 @@
 
 #include <fstream>
 
+#include "CalibrationBundle.h"
+#include "DepthImage.h"
 #include "Tracker.h"
 
 #ifndef Q_MOC_RUN
@@ -28,13 +30,15 @@ class SLTrackerWorker : public QObject {
         ~SLTrackerWorker();
     public slots:
         void setup();
-        void trackPointCloud(PointCloudConstPtr pointCloud);
+        void trackDepthImage(DepthImageConstPtr depthImage);
         void setReference(PointCloudConstPtr referencePointCloud);
     signals:
         void newPoseEstimate(Eigen::Affine3f T);
         void error(QString err);
     private:
+        void setCalibration(CalibrationBundle::ConstPtr _bundle);
         bool busy;
+        CalibrationBundle::ConstPtr bundle;
         Tracker *tracker;
         QTime performanceTime;
         QTime trackingTime;
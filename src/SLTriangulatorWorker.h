@@ -11,7 +11,6 @@
 #include <QObject>
 #include <QTime>
 
-#include "CalibrationData.h"
 #include "Triangulator.h"
 
 #include <pcl/point_cloud.h>
@@ -23,20 +22,19 @@ class SLTriangulatorWorker : public QObject {
     Q_OBJECT
 
     public:
-        SLTriangulatorWorker() : frameWidth(0), frameHeight(0), writeToDisk(false){}
+        SLTriangulatorWorker() : frameWidth(0), frameHeight(0), writeToDisk(false), triangulator(NULL){}
         ~SLTriangulatorWorker();
     public slots:
         void setup();
-        void triangulatePointCloud(cv::Mat up, cv::Mat vp, cv::Mat mask, cv::Mat shading);
+        void triangulatePointCloud(cv::Mat up, cv::Mat vp, cv::Mat mask, cv::Mat shading, CalibrationBundle::ConstPtr bundle);
     signals:
         void imshow(const char* windowName, cv::Mat mat, unsigned int x, unsigned int y);
-        void newPointCloud(PointCloudConstPtr pointCloud);
+        void newDepthImage(DepthImageConstPtr depthImage);
         void error(QString err);
         //void finished();
     private:
         unsigned int frameWidth, frameHeight;
         bool writeToDisk;
-        CalibrationData *calibration;
         Triangulator *triangulator;
         QTime time;
         bool busy;
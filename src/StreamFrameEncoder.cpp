@@ -0,0 +1,110 @@
+#include "StreamFrameEncoder.h"
+
+#include <cmath>
+#include <cstring>
+
+#include <pcl/io/lzf.h>
+
+static const int headerSize = 24;
+
+template <typename T>
+static inline void append(std::vector<char> &frame, const T &value) {
+  const char *bytes = (const char *)&value;
+  frame.insert(frame.end(), bytes, bytes + sizeof(T));
+}
+
+static void beginFrame(std::vector<char> &frame, StreamFrameType type,
+                       uint32_t sequence, uint64_t timestamp) {
+  frame.clear();
+  frame.insert(frame.end(), {'S', 'L', 'S', 'F'});
+  append(frame, (uint8_t)type);
+  append(frame, (uint8_t)1);
+  append(frame, (uint16_t)0);
+  append(frame, sequence);
+  append(frame, (uint32_t)0);  // payload size, set in endFrame
+  append(frame, timestamp);
+}
+
+static void endFrame(std::vector<char> &frame) {
+  uint32_t payloadSize = frame.size() - headerSize;
+  std::memcpy(&frame[12], &payloadSize, sizeof(payloadSize));
+}
+
+// Appends the uint32 compressed size and the LZF compressed data
+static void appendCompressed(std::vector<char> &frame,
+                             const unsigned char *data, size_t size,
+                             std::vector<char> &buffer) {
+  // Incompressible data may grow slightly, as with pcl::PCDWriter
+  buffer.resize(size + size / 2 + 8);
+  uint32_t compressedSize = 0;
+  if (size > 0)
+    compressedSize =
+        pcl::lzfCompress(data, size, buffer.data(), buffer.size());
+  append(frame, compressedSize);
+  frame.insert(frame.end(), buffer.data(), buffer.data() + compressedSize);
+}
+
+void StreamFrameEncoder::encodeCalibration(const cv::Matx33f &Kc,
+                                           unsigned int width,
+                                           unsigned int height,
+                                           uint64_t timestamp,
+                                           std::vector<char> &frame) {
+  beginFrame(frame, StreamFrameCalibration, 0, timestamp);
+  append(frame, (uint32_t)width);
+  append(frame, (uint32_t)height);
+  for (int i = 0; i < 9; i++) append(frame, Kc.val[i]);
+  endFrame(frame);
+}
+
+void StreamFrameEncoder::encodeDepth(const DepthImage &depthImage,
+                                     uint64_t timestamp,
+                                     std::vector<char> &frame) {
+  unsigned int width = depthImage.cols(), height = depthImage.rows();
+  size_t n = (size_t)width * height;
+
+  depthPlanes.resize(2 * n);
+  shadingDeltas.resize(n);
+  unsigned char *low = depthPlanes.data();
+  unsigned char *high = low + n;
+
+  // Quantize, delta code and split into byte planes in one pass
+  const float scale = 1.0f / depthResolution;
+  for (unsigned int r = 0; r < height; r++) {
+    const float *z = depthImage.z.ptr<float>(r);
+    const unsigned char *shadingRow = depthImage.shading.ptr<unsigned char>(r);
+    size_t offset = (size_t)r * width;
+    uint16_t previousDepth = 0;
+    uint8_t previousShading = 0;
+    for (unsigned int c = 0; c < width; c++) {
+      float q = z[c] * scale + 0.5f;
+      // Comparison is false for NaN
+      uint16_t depth = (q >= 1.0f && q < 65536.0f) ? (uint16_t)q : 0;
+      uint16_t delta = depth - previousDepth;
+      previousDepth = depth;
+      low[offset + c] = delta & 0xFF;
+      high[offset + c] = delta >> 8;
+
+      uint8_t shading = shadingRow[c];
+      shadingDeltas[offset + c] = shading - previousShading;
+      previousShading = shading;
+    }
+  }
+
+  beginFrame(frame, StreamFrameDepth, depthSequence++, timestamp);
+  append(frame, (uint32_t)width);
+  append(frame, (uint32_t)height);
+  append(frame, depthResolution);
+  appendCompressed(frame, depthPlanes.data(), depthPlanes.size(), compressed);
+  appendCompressed(frame, shadingDeltas.data(), shadingDeltas.size(),
+                   compressed);
+  endFrame(frame);
+}
+
+void StreamFrameEncoder::encodePose(const Eigen::Affine3f &T,
+                                    uint64_t timestamp,
+                                    std::vector<char> &frame) {
+  beginFrame(frame, StreamFramePose, poseSequence++, timestamp);
+  const float *matrix = T.matrix().data();
+  for (int i = 0; i < 16; i++) append(frame, matrix[i]);
+  endFrame(frame);
+}
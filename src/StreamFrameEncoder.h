@@ -0,0 +1,73 @@
+#ifndef STREAMFRAMEENCODER_H
+#define STREAMFRAMEENCODER_H
+
+#include <cstdint>
+#include <vector>
+
+#ifndef Q_MOC_RUN
+#include <Eigen/Eigen>
+#endif
+
+#include <opencv2/opencv.hpp>
+
+#include "DepthImage.h"
+
+// Compact frames for streaming scan results to other processes. All values
+// are little endian. Every frame starts with a 24 byte header:
+//
+//   char     magic[4]     "SLSF"
+//   uint8    type         StreamFrameType
+//   uint8    version      1
+//   uint16   reserved
+//   uint32   sequence     per frame type
+//   uint32   payloadSize  bytes following the header
+//   uint64   timestamp    microseconds since epoch
+//
+// Calibration payload, sent once per connection:
+//   uint32 width, height; float Kc[9] (row-major)
+//   Points are in the undistorted camera frame, such that pixel (c, r) with
+//   depth z is at z * Kc^-1 * (c, r, 1), as in DepthImage.
+//
+// Depth payload:
+//   uint32 width, height; float depthResolution (mm per unit)
+//   uint32 depthSize; uint8 depth[depthSize]
+//   uint32 shadingSize; uint8 shading[shadingSize]
+//   depth is z / depthResolution as uint16, 0 for invalid or out of range
+//   points. Each row is delta coded from left to right (modulo 2^16), split
+//   into a plane of low bytes followed by a plane of high bytes and LZF
+//   compressed. shading (uint8) is delta coded and compressed the same way.
+//
+// Pose payload:
+//   float T[16], the column-major homogeneous transformation
+enum StreamFrameType {
+  StreamFrameCalibration = 1,
+  StreamFrameDepth = 2,
+  StreamFramePose = 3
+};
+
+class StreamFrameEncoder {
+ public:
+  StreamFrameEncoder(float depthResolution = 0.05f)
+      : depthResolution(depthResolution),
+        depthSequence(0),
+        poseSequence(0) {}
+  void setDepthResolution(float _depthResolution) {
+    depthResolution = _depthResolution;
+  }
+  void encodeCalibration(const cv::Matx33f &Kc, unsigned int width,
+                         unsigned int height, uint64_t timestamp,
+                         std::vector<char> &frame);
+  void encodeDepth(const DepthImage &depthImage, uint64_t timestamp,
+                   std::vector<char> &frame);
+  void encodePose(const Eigen::Affine3f &T, uint64_t timestamp,
+                  std::vector<char> &frame);
+
+ private:
+  float depthResolution;
+  uint32_t depthSequence, poseSequence;
+  // Reused between frames
+  std::vector<unsigned char> depthPlanes, shadingDeltas;
+  std::vector<char> compressed;
+};
+
+#endif
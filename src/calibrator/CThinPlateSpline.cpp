@@ -6,6 +6,13 @@
 */
 
 #include <vector>
+#include <fstream>
+#include <iostream>
+#include <cfloat>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "CThinPlateSpline.h"
 
@@ -311,21 +318,62 @@ void CThinPlateSpline::getMaps(Mat& mx, Mat& my)
 	my = mapy;
 }
 
+void CThinPlateSpline::setMapCacheDirectory(const std::string& directory)
+{
+	mapCacheDirectory = directory;
+}
+
+// Parallel loop body evaluating a range of map rows
+class CThinPlateSplineMapBody : public cv::ParallelLoopBody
+{
+public:
+	CThinPlateSplineMapBody(CThinPlateSpline* _tps, Mat_<float>& _mx, Mat_<float>& _my, const TPS_INTERPOLATION _tpsInter)
+		: tps(_tps), mx(_mx), my(_my), tpsInter(_tpsInter) {}
+
+	void operator()(const cv::Range& range) const
+	{
+		tps->computeMapRows(range.start, range.end, mx, my, tpsInter);
+	}
+
+private:
+	CThinPlateSpline* tps;
+	Mat_<float>& mx;
+	Mat_<float>& my;
+	TPS_INTERPOLATION tpsInter;
+};
+
 void CThinPlateSpline::computeMaps(const Size& dstSize, Mat_<float>& mx, Mat_<float>& my,const TPS_INTERPOLATION tpsInter)
 {
-	mx = Mat_<float>(dstSize);
-	my = Mat_<float>(dstSize);
+	// only compute the coefficients new if they weren't already computed
+	// or there had been changes to the points (same lambda as interpolate())
+	if(tpsInter == BACK_WARP && !FLAG_COEFFS_BACK_WARP_SET)
+	{
+		computeSplineCoeffs(pSrc,pDst,1000,tpsInter);
+	}
+	else if(tpsInter == FORWARD_WARP && !FLAG_COEFFS_FORWARD_WARP_SET)
+	{
+		computeSplineCoeffs(pSrc,pDst,1000,tpsInter);
+	}
 
-    Point2f p(0, 0);
-    Point_<float> intP(0, 0);
-	
-	for (int row = 0; row < dstSize.height; row++) {
-		for (int col = 0; col < dstSize.width; col++) {
-            p = Point2f(col, row);
-			intP = interpolate(p,tpsInter);
-			mx(row, col) = intP.x;
-			my(row, col) = intP.y;
-		}
+	bool cached = false;
+	std::string cacheFileName;
+	unsigned long long key = 0;
+	if(!mapCacheDirectory.empty())
+	{
+		key = mapCacheKey(dstSize, tpsInter);
+		cacheFileName = cv::format("%s/tps_%016llx.bin", mapCacheDirectory.c_str(), key);
+		cached = loadCachedMaps(cacheFileName, key, dstSize, mx, my);
+	}
+
+	if(!cached)
+	{
+		mx = Mat_<float>(dstSize);
+		my = Mat_<float>(dstSize);
+
+		cv::parallel_for_(cv::Range(0, dstSize.height), CThinPlateSplineMapBody(this, mx, my, tpsInter));
+
+		if(!mapCacheDirectory.empty())
+			saveCachedMaps(cacheFileName, key, mx, my);
 	}
 
 	if(tpsInter == BACK_WARP)
@@ -340,3 +388,204 @@ void CThinPlateSpline::computeMaps(const Size& dstSize, Mat_<float>& mx, Mat_<fl
 	}
 }
 
+#ifdef __SSE2__
+// Natural logarithm of four floats (Cephes logf polynomial, ~1 ulp for normal inputs)
+static inline __m128 log_ps(__m128 x)
+{
+	const __m128i mantMask = _mm_set1_epi32(0x807fffff);
+	const __m128i half = _mm_set1_epi32(0x3f000000);
+
+	__m128i xi = _mm_castps_si128(x);
+	__m128i emm0 = _mm_sub_epi32(_mm_srli_epi32(xi, 23), _mm_set1_epi32(126));
+	__m128 e = _mm_cvtepi32_ps(emm0);
+
+	// mantissa in [0.5, 1)
+	x = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(xi, mantMask), half));
+
+	// if x < sqrt(0.5): e -= 1, x = 2x - 1, else x = x - 1
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128 mask = _mm_cmplt_ps(x, _mm_set1_ps(0.707106781186547524f));
+	__m128 tmp = _mm_and_ps(x, mask);
+	x = _mm_sub_ps(x, one);
+	e = _mm_sub_ps(e, _mm_and_ps(one, mask));
+	x = _mm_add_ps(x, tmp);
+
+	__m128 z = _mm_mul_ps(x, x);
+
+	__m128 y = _mm_set1_ps(7.0376836292E-2f);
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.1514610310E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.1676998740E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.2420140846E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.4249322787E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.6668057665E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(2.0000714765E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-2.4999993993E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(3.3333331174E-1f));
+	y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+
+	y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(-2.12194440e-4f)));
+	y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+	x = _mm_add_ps(x, y);
+	x = _mm_add_ps(x, _mm_mul_ps(e, _mm_set1_ps(0.693359375f)));
+
+	return x;
+}
+
+// Adds the four float lanes of v to the accumulators (lo: lanes 0,1; hi: lanes 2,3)
+static inline void accumulate_pd(__m128 v, __m128d& lo, __m128d& hi)
+{
+	lo = _mm_add_pd(lo, _mm_cvtps_pd(v));
+	hi = _mm_add_pd(hi, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+}
+#endif
+
+void CThinPlateSpline::computeMapRows(int rowBegin, int rowEnd, Mat_<float>& mx, Mat_<float>& my, const TPS_INTERPOLATION tpsInter)
+{
+	const std::vector<Point2f>& pList = (tpsInter == FORWARD_WARP) ? pSrc : pDst;
+	const int n = (int)pSrc.size();
+	const int cols = mx.cols;
+
+	// structure of arrays for the control points and their weights
+	std::vector<float> cx(n), cy(n), w0(n), w1(n);
+	for(int j = 0; j < n; j++)
+	{
+		cx[j] = pList[j].x;
+		cy[j] = pList[j].y;
+		w0[j] = cMatrix(j,0);
+		w1[j] = cMatrix(j,1);
+	}
+
+	const int k1 = cMatrix.rows - 3;
+	const int kx = cMatrix.rows - 2;
+	const int ky = cMatrix.rows - 1;
+
+	for (int row = rowBegin; row < rowEnd; row++) {
+
+		float* mxRow = mx[row];
+		float* myRow = my[row];
+		int col = 0;
+
+#ifdef __SSE2__
+		const __m128 py = _mm_set1_ps((float)row);
+		const __m128 minR2 = _mm_set1_ps(FLT_MIN);
+
+		for (; col + 4 <= cols; col += 4) {
+			const __m128 px = _mm_setr_ps((float)col, (float)(col+1), (float)(col+2), (float)(col+3));
+
+			__m128d sum0Lo = _mm_setzero_pd(), sum0Hi = _mm_setzero_pd();
+			__m128d sum1Lo = _mm_setzero_pd(), sum1Hi = _mm_setzero_pd();
+
+			for (int j = 0; j < n; j++) {
+				__m128 dx = _mm_sub_ps(_mm_set1_ps(cx[j]), px);
+				__m128 dy = _mm_sub_ps(_mm_set1_ps(cy[j]), py);
+				__m128 r2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+
+				// U(r) = r^2 log r^2 (vanishes at r = 0)
+				r2 = _mm_max_ps(r2, minR2);
+				__m128 u = _mm_mul_ps(r2, log_ps(r2));
+
+				accumulate_pd(_mm_mul_ps(_mm_set1_ps(w0[j]), u), sum0Lo, sum0Hi);
+				accumulate_pd(_mm_mul_ps(_mm_set1_ps(w1[j]), u), sum1Lo, sum1Hi);
+			}
+
+			double sum0[4], sum1[4];
+			_mm_storeu_pd(sum0, sum0Lo);
+			_mm_storeu_pd(sum0+2, sum0Hi);
+			_mm_storeu_pd(sum1, sum1Lo);
+			_mm_storeu_pd(sum1+2, sum1Hi);
+
+			for (int l = 0; l < 4; l++) {
+				double x = col + l;
+				myRow[col+l] = (float)(cMatrix(k1,0) + cMatrix(kx,0)*row + cMatrix(ky,0)*x + sum0[l]);
+				mxRow[col+l] = (float)(cMatrix(k1,1) + cMatrix(kx,1)*row + cMatrix(ky,1)*x + sum1[l]);
+			}
+		}
+#endif
+		// remaining pixels
+		for (; col < cols; col++) {
+			Point2f intP = (tpsInter == FORWARD_WARP) ? interpolate_forward_(Point2f(col, row)) : interpolate_back_(Point2f(col, row));
+			mxRow[col] = intP.x;
+			myRow[col] = intP.y;
+		}
+	}
+}
+
+// FNV-1a hash over a block of memory
+static inline unsigned long long fnv1a(const void* data, size_t size, unsigned long long h)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for(size_t i = 0; i < size; i++)
+	{
+		h ^= bytes[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+unsigned long long CThinPlateSpline::mapCacheKey(const Size& dstSize, const TPS_INTERPOLATION tpsInter)
+{
+	unsigned long long h = 14695981039346656037ULL;
+
+	int header[3] = {dstSize.width, dstSize.height, (int)tpsInter};
+	h = fnv1a(header, sizeof(header), h);
+
+	if(!pSrc.empty())
+	{
+		h = fnv1a(&pSrc[0], pSrc.size()*sizeof(Point2f), h);
+		h = fnv1a(&pDst[0], pDst.size()*sizeof(Point2f), h);
+	}
+
+	Mat_<float> c = cMatrix.isContinuous() ? cMatrix : cMatrix.clone();
+	h = fnv1a(c.ptr(), c.total()*c.elemSize(), h);
+
+	return h;
+}
+
+static const unsigned int TPS_CACHE_MAGIC = 0x53505431; // "TPS1"
+
+bool CThinPlateSpline::loadCachedMaps(const std::string& fileName, unsigned long long key, const Size& dstSize, Mat_<float>& mx, Mat_<float>& my)
+{
+	std::ifstream file(fileName.c_str(), std::ios::in | std::ios::binary);
+	if(!file.is_open())
+		return false;
+
+	unsigned int magic = 0;
+	unsigned long long fileKey = 0;
+	int width = 0, height = 0;
+	file.read((char*)&magic, sizeof(magic));
+	file.read((char*)&fileKey, sizeof(fileKey));
+	file.read((char*)&width, sizeof(width));
+	file.read((char*)&height, sizeof(height));
+
+	if(!file || magic != TPS_CACHE_MAGIC || fileKey != key || width != dstSize.width || height != dstSize.height)
+		return false;
+
+	Mat_<float> x(dstSize), y(dstSize);
+	file.read((char*)x.ptr(), x.total()*sizeof(float));
+	file.read((char*)y.ptr(), y.total()*sizeof(float));
+	if(!file)
+		return false;
+
+	mx = x;
+	my = y;
+	return true;
+}
+
+void CThinPlateSpline::saveCachedMaps(const std::string& fileName, unsigned long long key, const Mat_<float>& mx, const Mat_<float>& my)
+{
+	std::ofstream file(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!file.is_open())
+	{
+		std::cerr << "CThinPlateSpline: could not write map cache " << fileName << std::endl;
+		return;
+	}
+
+	file.write((const char*)&TPS_CACHE_MAGIC, sizeof(TPS_CACHE_MAGIC));
+	file.write((const char*)&key, sizeof(key));
+	file.write((const char*)&mx.cols, sizeof(mx.cols));
+	file.write((const char*)&mx.rows, sizeof(mx.rows));
+	for(int row = 0; row < mx.rows; row++)
+		file.write((const char*)mx[row], mx.cols*sizeof(float));
+	for(int row = 0; row < my.rows; row++)
+		file.write((const char*)my[row], my.cols*sizeof(float));
+}
@@ -25,6 +25,8 @@ points given by the user.
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <string>
+
 #ifndef CTHINPLATESPLINE_H_
 #define CTHINPLATESPLINE_H_
 using namespace cv;
@@ -239,8 +241,40 @@ public:
 		Mat_<float>& mapy,
 		const TPS_INTERPOLATION tpsInter = BACK_WARP);
 
+	/**
+	**************************************************************************
+	Sets a directory in which computed maps are cached. The cache entries are
+	keyed by a hash of the control points, the spline coefficients, the 
+	destination size and the warp direction, so that computeMaps() can load
+	the maps from disk if the same correspondences are used again. An empty
+	string (default) disables the cache.
+
+	@param directory                directory for the cache files (must exist)
+
+	@return                                 void
+	***************************************************************************/
+	void setMapCacheDirectory(const std::string& directory);
+
 private:
 
+	/**
+	****************************************************************************
+	\brief Evaluates the spline for a block of destination rows.
+
+	Pixels are processed in groups of four (SSE2) against all control points,
+	using a polynomial approximation of the logarithm. Sums are accumulated in
+	double precision. Used by computeMaps() through cv::parallel_for_.
+	****************************************************************************/
+	void computeMapRows(int rowBegin, int rowEnd,
+		Mat_<float>& mx,
+		Mat_<float>& my,
+		const TPS_INTERPOLATION tpsInter);
+	friend class CThinPlateSplineMapBody;
+
+	unsigned long long mapCacheKey(const Size& dstSize, const TPS_INTERPOLATION tpsInter);
+	bool loadCachedMaps(const std::string& fileName, unsigned long long key, const Size& dstSize, Mat_<float>& mx, Mat_<float>& my);
+	void saveCachedMaps(const std::string& fileName, unsigned long long key, const Mat_<float>& mx, const Mat_<float>& my);
+
 	/**
 	****************************************************************************
 	\brief This is the main function of the thin plate spline algorithm.
@@ -273,6 +307,7 @@ private:
 	Mat_<float> mapy;
     std::vector<Point2f> pSrc;
     std::vector<Point2f> pDst;
+	std::string mapCacheDirectory;
 
 	// FLAGS
 	bool FLAG_COEFFS_BACK_WARP_SET;
@@ -102,6 +102,10 @@ bool CalibrationData::loadXML(const QString& filename) {
   fs["screenResX"] >> screenResX;
   fs["screenResY"] >> screenResY;
 
+  // Missing in files of older versions
+  if (!fs["calibrationDateTime"].empty())
+    fs["calibrationDateTime"] >> calibrationDateTime;
+
   fs.release();
 
   return true;
@@ -140,7 +144,8 @@ bool CalibrationData::saveXML(const QString& filename) {
      << "kp" << cv::Mat(kp) << "Rp" << cv::Mat(Rp) << "Tp" << cv::Mat(Tp)
      << "cam_error" << cam_error << "proj_error" << proj_error << "stereo_error"
      << stereo_error << "frameWidth" << frameWidth << "frameHeight"
-     << frameHeight << "screenResX" << screenResX << "screenResY" << screenResY;
+     << frameHeight << "screenResX" << screenResX << "screenResY" << screenResY
+     << "calibrationDateTime" << calibrationDateTime;
   fs.release();
 
   return true;
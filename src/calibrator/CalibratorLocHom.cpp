@@ -4,15 +4,15 @@
 #include "cvtools.h"
 
 #include <algorithm>
+#include <future>
 
 #include <QSettings>
 
 CalibratorLocHom::CalibratorLocHom(unsigned int _screenCols,
                                    unsigned int _screenRows)
     : Calibrator(_screenCols, _screenRows) {
-  // Create encoder/decoder
+  // Create encoder
   encoder = new EncoderCalibration(screenCols, screenRows, CodecDirBoth);
-  decoder = new DecoderCalibration(screenCols, screenRows, CodecDirBoth);
 
   this->N = encoder->getNPatterns();
 
@@ -22,6 +22,228 @@ CalibratorLocHom::CalibratorLocHom(unsigned int _screenCols,
     patterns.push_back(encoder->getEncodingPattern(i));
 }
 
+namespace {
+
+// Fits a local homography around each checker corner
+class LocalHomographyBody : public cv::ParallelLoopBody {
+ public:
+  LocalHomographyBody(const vector<cv::Point2f> &_qc, const cv::Mat &_up,
+                      const cv::Mat &_vp, const cv::Mat &_mask,
+                      vector<cv::Point2f> &_qp, vector<char> &_valid)
+      : qc(_qc), up(_up), vp(_vp), mask(_mask), qp(_qp), valid(_valid) {}
+
+  void operator()(const cv::Range &range) const {
+    const unsigned int frameWidth = up.cols;
+    const unsigned int frameHeight = up.rows;
+
+    for (int j = range.start; j < range.end; j++) {
+      const cv::Point2f &qcij = qc[j];
+      valid[j] = false;
+
+      // Collect neighbor points
+      const unsigned int WINDOW_SIZE = 10;
+      std::vector<cv::Point2f> N_qcij, N_qpij;
+
+      // avoid going out of bounds
+      unsigned int starth = max(int(qcij.y + 0.5) - (int)WINDOW_SIZE, 0);
+      unsigned int stoph =
+          min(int(qcij.y + 0.5) + WINDOW_SIZE, frameHeight - 1);
+      unsigned int startw = max(int(qcij.x + 0.5) - (int)WINDOW_SIZE, 0);
+      unsigned int stopw =
+          min(int(qcij.x + 0.5) + WINDOW_SIZE, frameWidth - 1);
+
+      for (unsigned int h = starth; h <= stoph; h++) {
+        const uchar *maskRow = mask.ptr<uchar>(h);
+        const float *upRow = up.ptr<float>(h);
+        const float *vpRow = vp.ptr<float>(h);
+        for (unsigned int w = startw; w <= stopw; w++) {
+          // stay within mask
+          if (maskRow[w]) {
+            N_qcij.push_back(cv::Point2f(w, h));
+            N_qpij.push_back(cv::Point2f(upRow[w], vpRow[w]));
+          }
+        }
+      }
+
+      // if enough valid points to build homography
+      if (N_qpij.size() >= 50) {
+        // translate qcij into qpij using local homography
+        cv::Mat H = cv::findHomography(N_qcij, N_qpij, cv::LMEDS);
+        if (!H.empty()) {
+          cv::Point3d Q = cv::Point3d(
+              cv::Mat(H * cv::Mat(cv::Point3d(qcij.x, qcij.y, 1.0))));
+          qp[j] = cv::Point2f(Q.x / Q.z, Q.y / Q.z);
+          valid[j] = true;
+        }
+      }
+    }
+  }
+
+ private:
+  const vector<cv::Point2f> &qc;
+  const cv::Mat &up, &vp, &mask;
+  vector<cv::Point2f> &qp;
+  vector<char> &valid;
+};
+
+// Processes a range of calibration views
+class ViewBody : public cv::ParallelLoopBody {
+ public:
+  ViewBody(const CalibratorLocHom *_calibrator,
+           const vector<vector<cv::Mat> > &_frameSeqs, cv::Size _patternSize,
+           vector<CalibratorLocHomView> &_views)
+      : calibrator(_calibrator),
+        frameSeqs(_frameSeqs),
+        patternSize(_patternSize),
+        views(_views) {}
+
+  void operator()(const cv::Range &range) const {
+    for (int i = range.start; i < range.end; i++)
+      views[i] = calibrator->processFrameSequence(frameSeqs[i], patternSize);
+  }
+
+ private:
+  const CalibratorLocHom *calibrator;
+  const vector<vector<cv::Mat> > &frameSeqs;
+  cv::Size patternSize;
+  vector<CalibratorLocHomView> &views;
+};
+
+}  // namespace
+
+CalibratorLocHomView CalibratorLocHom::processFrameSequence(
+    const vector<cv::Mat> &frameSeq, cv::Size patternSize) const {
+  CalibratorLocHomView view;
+
+  // Decode frame sequence (decoders keep frame state, one per call)
+  DecoderCalibration decoder(screenCols, screenRows, CodecDirBoth);
+  for (unsigned int f = 0; f < frameSeq.size(); f++)
+    decoder.setFrame(f, frameSeq[f]);
+
+  cv::Mat up, vp, shading, mask;
+  decoder.decodeFrames(up, vp, mask, shading);
+#if 0
+  cvtools::writeMat(shading, "shading.mat");
+  cvtools::writeMat(up, "up.mat");
+  cvtools::writeMat(vp, "vp.mat");
+#endif
+
+  // Extract checker corners
+  vector<cv::Point2f> qci;
+  view.success = cv::findChessboardCorners(shading, patternSize, qci,
+                                           cv::CALIB_CB_ADAPTIVE_THRESH);
+  if (view.success) {
+    // Refine corner locations
+    cv::cornerSubPix(
+        shading, qci, cv::Size(5, 5), cv::Size(1, 1),
+        cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::MAX_ITER,
+                         20, 0.01));
+  }
+
+  // Draw colored chessboard
+  cv::cvtColor(shading, view.shadingColor, cv::COLOR_GRAY2RGB);
+  cv::drawChessboardCorners(view.shadingColor, patternSize, qci,
+                            view.success);
+
+  if (!view.success) return view;
+
+  // Translate corners into projector coordinates by local homographies
+  vector<cv::Point2f> qpi(qci.size());
+  vector<char> valid(qci.size(), false);
+  cv::parallel_for_(cv::Range(0, qci.size()),
+                    LocalHomographyBody(qci, up, vp, mask, qpi, valid));
+
+  // Keep accepted points in corner order
+  for (unsigned int j = 0; j < qci.size(); j++) {
+    if (!valid[j]) continue;
+    view.qp.push_back(qpi[j]);
+    view.qc.push_back(qci[j]);
+    view.Q.push_back(
+        cv::Point3f(j % patternSize.width, j / patternSize.width, 0.0));
+  }
+
+  return view;
+}
+
+void CalibratorLocHom::addFrameSequenceIncremental(vector<cv::Mat> frameSeq,
+                                                   cv::Size patternSize) {
+  unsigned int idx = incrementalFrameSeqs.size();
+  incrementalFrameSeqs.push_back(frameSeq);
+
+  CachedView cached;
+  cached.patternSize = patternSize;
+  cached.view = std::async(std::launch::async, [this, frameSeq, patternSize,
+                                                idx]() {
+                  CalibratorLocHomView view =
+                      processFrameSequence(frameSeq, patternSize);
+                  std::cout << idx << " Seq Chessboard Extraction Results: "
+                            << (view.success ? "Passed" : "Failed")
+                            << std::endl;
+                  // Queued to the receiver's thread
+                  emit newSequenceResult(view.shadingColor, idx, view.success);
+                  return view;
+                }).share();
+  cachedViews.push_back(cached);
+}
+
+void CalibratorLocHom::reset() {
+  Calibrator::reset();
+
+  // Wait for pending views before dropping them
+  for (unsigned int i = 0; i < cachedViews.size(); i++)
+    cachedViews[i].view.wait();
+  cachedViews.clear();
+  incrementalFrameSeqs.clear();
+}
+
+CalibrationData CalibratorLocHom::calibrate(
+    const vector<unsigned int> &activeSeqs) {
+  QSettings settings("SLStudio");
+
+  // Checkerboard parameters
+  unsigned int checkerSize = settings.value("calibration/checkerSize").toInt();
+  unsigned int checkerRows = settings.value("calibration/checkerRows").toInt();
+  unsigned int checkerCols = settings.value("calibration/checkerCols").toInt();
+
+  std::cout << "Checker grid size [mm]: " << checkerSize << std::endl;
+
+  cv::Size patternSize(checkerCols, checkerRows);
+
+  vector<CalibratorLocHomView> views;
+  vector<unsigned int> seqs;
+  for (unsigned int a = 0; a < activeSeqs.size(); a++) {
+    unsigned int i = activeSeqs[a];
+    if (i >= cachedViews.size()) continue;
+
+    // Reprocess views extracted with a different checker configuration
+    if (cachedViews[i].patternSize != patternSize) {
+      cachedViews[i].view.wait();
+      cachedViews[i].patternSize = patternSize;
+      CalibratorLocHomView view =
+          processFrameSequence(incrementalFrameSeqs[i], patternSize);
+      // Update the list's markers and previews, as for newly added views
+      emit newSequenceResult(view.shadingColor, i, view.success);
+      std::promise<CalibratorLocHomView> promise;
+      promise.set_value(view);
+      cachedViews[i].view = promise.get_future().share();
+    }
+
+    views.push_back(cachedViews[i].view.get());
+    seqs.push_back(i);
+  }
+
+  if (views.empty()) {
+    std::cerr << "Error: not enough calibration sequences!" << std::endl;
+    CalibrationData nanData;
+    return nanData;
+  }
+
+  cv::Size frameSize(incrementalFrameSeqs[seqs[0]][0].cols,
+                     incrementalFrameSeqs[seqs[0]][0].rows);
+
+  return calibrateViews(views, seqs, checkerSize, frameSize);
+}
+
 CalibrationData CalibratorLocHom::calibrate() {
   QSettings settings("SLStudio");
 
@@ -38,141 +260,67 @@ CalibrationData CalibratorLocHom::calibrate() {
   // Number of calibration sequences
   unsigned nFrameSeq = frameSeqs.size();
 
-  vector<cv::Mat> up(nFrameSeq), vp(nFrameSeq), shading(nFrameSeq),
-      mask(nFrameSeq);
+  if (nFrameSeq < 1 || frameSeqs[0].empty()) {
+    std::cerr << "Error: not enough calibration sequences!" << std::endl;
+    CalibrationData nanData;
+    return nanData;
+  }
 
-  // Decode frame sequences
-  for (unsigned int i = 0; i < nFrameSeq; i++) {
-    vector<cv::Mat> frames = frameSeqs[i];
-    for (unsigned int f = 0; f < frames.size(); f++) {
-      decoder->setFrame(f, frames[f]);
-#if 0
-                cv::imwrite(QString("frames[%1].png").arg(f).toStdString(), frames[f]);
-#endif
+  cv::Size frameSize(frameSeqs[0][0].cols, frameSeqs[0][0].rows);
+
+  // Decode and extract views in parallel. Batches of views are processed
+  // concurrently, results are reported from this thread after each batch.
+  vector<CalibratorLocHomView> views(nFrameSeq);
+  vector<unsigned int> seqs(nFrameSeq);
+  unsigned int batchSize = max(cv::getNumThreads(), 1);
+  for (unsigned int b = 0; b < nFrameSeq; b += batchSize) {
+    unsigned int e = min(b + batchSize, nFrameSeq);
+    cv::parallel_for_(cv::Range(b, e),
+                      ViewBody(this, frameSeqs, patternSize, views));
+
+    for (unsigned int i = b; i < e; i++) {
+      seqs[i] = i;
+      if (!views[i].success)
+        std::cout
+            << "Calibrator: could not extract chess board corners on frame "
+               "seqence "
+            << i << std::endl
+            << std::flush;
+      // Emit chessboard results
+      std::cout << i << " Seq Chessboard Extraction Results: "
+                << (views[i].success ? "Passed" : "Failed") << std::endl;
+      emit newSequenceResult(views[i].shadingColor, i, views[i].success);
     }
-    decoder->decodeFrames(up[i], vp[i], mask[i], shading[i]);
-#if 0
-            cvtools::writeMat(shading[i], QString("shading[%1].mat").arg(i).toLocal8Bit());
-            cvtools::writeMat(up[i], QString("up[%1].mat").arg(i).toLocal8Bit());
-            cvtools::writeMat(vp[i], QString("vp[%1].mat").arg(i).toLocal8Bit());
-#endif
   }
 
-  unsigned int frameWidth = frameSeqs[0][0].cols;
-  unsigned int frameHeight = frameSeqs[0][0].rows;
-
-  // Generate local calibration object coordinates [mm]
-  vector<cv::Point3f> Qi;
-  for (int h = 0; h < patternSize.height; h++)
-    for (int w = 0; w < patternSize.width; w++)
-      Qi.push_back(cv::Point3f(checkerSize * w, checkerSize * h, 0.0));
+  return calibrateViews(views, seqs, checkerSize, frameSize);
+}
 
-  // Find calibration point coordinates for camera and projector
+CalibrationData CalibratorLocHom::calibrateViews(
+    const vector<CalibratorLocHomView> &views, const vector<unsigned int> &seqs,
+    float checkerSize, cv::Size frameSize) {
+  // Collect calibration point coordinates for camera and projector
   std::vector<int> sequence_mapping =
       {};  // Record down how Q indices map to Frame number in scroll table
   vector<vector<cv::Point2f> > qc, qp;
   vector<vector<cv::Point3f> > Q;
-  for (unsigned int i = 0; i < nFrameSeq; i++) {
-    // std::cout << i << " 1" << std::endl;
-    vector<cv::Point2f> qci;
-    // Aid checkerboard extraction by slight blur
-    // cv::GaussianBlur(shading[i], shading[i], cv::Size(5,5), 2, 2);
-    // Extract checker corners
-    // std::cout << i << " findChessboardCorners" << std::endl;
-    bool success = cv::findChessboardCorners(shading[i], patternSize, qci,
-                                             cv::CALIB_CB_ADAPTIVE_THRESH);
-    if (!success)
-      std::cout << "Calibrator: could not extract chess board corners on frame "
-                   "seqence "
-                << i << std::endl
-                << std::flush;
-    else {
-      // Refine corner locations
-      cv::cornerSubPix(
-          shading[i], qci, cv::Size(5, 5), cv::Size(1, 1),
-          cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::MAX_ITER,
-                           20, 0.01));
-    }
-    // Draw colored chessboard
-    cv::Mat shadingColor;
-    cv::cvtColor(shading[i], shadingColor, cv::COLOR_GRAY2RGB);
-    cv::drawChessboardCorners(shadingColor, patternSize, qci, success);
-#if 0
-    cv::imwrite("shadingColor.png", shadingColor);
-#endif
-    // Emit chessboard results
-    std::cout << i << " Seq Chessboard Extraction Results: "
-              << (success ? "Passed" : "Failed") << std::endl;
-    emit newSequenceResult(shadingColor, i, success);
-
-    if (success) {
-      // Vectors of accepted points for current view
-      vector<cv::Point2f> qpi_a;
-      vector<cv::Point2f> qci_a;
-      vector<cv::Point3f> Qi_a;
-
-      // Loop through checkerboard corners
-      for (unsigned int j = 0; j < qci.size(); j++) {
-        const cv::Point2f &qcij = qci[j];
-
-        // Collect neighbor points
-        const unsigned int WINDOW_SIZE = 10;
-        std::vector<cv::Point2f> N_qcij, N_qpij;
-
-        // avoid going out of bounds
-        unsigned int starth = max(int(qcij.y + 0.5) - WINDOW_SIZE, 0u);
-        unsigned int stoph =
-            min(int(qcij.y + 0.5) + WINDOW_SIZE, frameHeight - 1);
-        unsigned int startw = max(int(qcij.x + 0.5) - WINDOW_SIZE, 0u);
-        unsigned int stopw =
-            min(int(qcij.x + 0.5) + WINDOW_SIZE, frameWidth - 1);
-
-        for (unsigned int h = starth; h <= stoph; h++) {
-          for (unsigned int w = startw; w <= stopw; w++) {
-            // stay within mask
-            if (mask[i].at<bool>(h, w)) {
-              N_qcij.push_back(cv::Point2f(w, h));
-
-              float upijwh = up[i].at<float>(h, w);
-              float vpijwh = vp[i].at<float>(h, w);
-              N_qpij.push_back(cv::Point2f(upijwh, vpijwh));
-            }
-          }
-        }
-        // std::cout << i << " findHomography " << N_qcij.size() << " " <<
-        // N_qpij.size() << std::endl;
-        // if enough valid points to build homography
-        if (N_qpij.size() >= 50) {
-          //                    std::cout << i << " findHomography" <<
-          //                    std::endl;
-          // translate qcij into qpij using local homography
-          cv::Mat H = cv::findHomography(N_qcij, N_qpij, cv::LMEDS);
-          if (!H.empty()) {
-            cv::Point3d Q = cv::Point3d(
-                cv::Mat(H * cv::Mat(cv::Point3d(qcij.x, qcij.y, 1.0))));
-            cv::Point2f qpij = cv::Point2f(Q.x / Q.z, Q.y / Q.z);
-
-            qpi_a.push_back(qpij);
-            qci_a.push_back(qci[j]);
-            Qi_a.push_back(Qi[j]);
-          }
-        }
-      }
+  for (unsigned int i = 0; i < views.size(); i++) {
+    if (views[i].Q.empty()) continue;
 
-      if (!Qi_a.empty()) {
-        // Store projector corner coordinates
-        qp.push_back(qpi_a);
+    // Store projector corner coordinates
+    qp.push_back(views[i].qp);
 
-        // Store camera corner coordinates
-        qc.push_back(qci_a);
+    // Store camera corner coordinates
+    qc.push_back(views[i].qc);
 
-        // Store world corner coordinates
-        Q.push_back(Qi_a);
+    // Store world corner coordinates [mm]
+    vector<cv::Point3f> Qi(views[i].Q.size());
+    for (unsigned int j = 0; j < Qi.size(); j++)
+      Qi[j] = views[i].Q[j] * checkerSize;
+    Q.push_back(Qi);
 
-        // Store frame number for this image
-        sequence_mapping.push_back(i);
-      }
-    }
+    // Store frame number for this image
+    sequence_mapping.push_back(seqs[i]);
   }
 
   if (Q.size() < 1) {
@@ -184,7 +332,6 @@ CalibrationData CalibratorLocHom::calibrate() {
   // calibrate the camera
   cv::Mat Kc, kc;
   std::vector<cv::Mat> cam_rvecs, cam_tvecs;
-  cv::Size frameSize(frameWidth, frameHeight);
 
   double cam_error = cv::calibrateCamera(
       Q, qc, frameSize, Kc, kc, cam_rvecs, cam_tvecs,
@@ -9,17 +9,44 @@
 
 #include "Codec.h"
 
+#include <future>
+
 using namespace std;
 
+// Correspondences extracted from a single calibration view
+struct CalibratorLocHomView {
+    bool success;
+    cv::Mat shadingColor;
+    vector<cv::Point2f> qc, qp;
+    vector<cv::Point3f> Q;
+    CalibratorLocHomView() : success(false){}
+};
+
 class CalibratorLocHom : public Calibrator {
     Q_OBJECT
     public:
         CalibratorLocHom(unsigned int _screenCols, unsigned int _screenRows);
         CalibrationData calibrate();
-        ~CalibratorLocHom(){delete encoder; delete decoder;}
+        // Decode a frame sequence, extract checker corners and translate them into projector coordinates
+        // Object coordinates are in units of checker squares. Thread safe (uses its own decoder instance)
+        CalibratorLocHomView processFrameSequence(const vector<cv::Mat> &frameSeq, cv::Size patternSize) const;
+        // Incremental calibration: the view is processed on a background thread right away
+        // and newSequenceResult is emitted from that thread when done
+        void addFrameSequenceIncremental(vector<cv::Mat> frameSeq, cv::Size patternSize);
+        // Calibrate from the cached views of the given incremental sequences
+        CalibrationData calibrate(const vector<unsigned int> &activeSeqs);
+        void reset();
+        ~CalibratorLocHom(){reset(); delete encoder;}
     private:
+        CalibrationData calibrateViews(const vector<CalibratorLocHomView> &views, const vector<unsigned int> &seqs,
+                                       float checkerSize, cv::Size frameSize);
         Encoder *encoder;
-        Decoder *decoder;
+        struct CachedView {
+            cv::Size patternSize;
+            std::shared_future<CalibratorLocHomView> view;
+        };
+        vector<CachedView> cachedViews;
+        vector< vector<cv::Mat> > incrementalFrameSeqs;
 };
 
 #endif // CALIBRATORLOCHOM_H
@@ -131,11 +131,11 @@ CalibrationData CalibratorRBF::calibrate() {
 
         // if enough valid points to build interpolator
         if (N_qpij.size() >= 50) {
-          RBFInterpolator *rbf = new RBFInterpolator(RBF_GAUSSIAN, 100.0);
+          RBFInterpolator rbf(RBF_GAUSSIAN, 100.0);
 
           // translate qcij into qpij using interpolator
-          rbf->setDataPoints(N_qcij, N_qpij);
-          cv::Point2f qpij = rbf->interpolate(N_qcij, qcij);
+          rbf.setDataPoints(N_qcij, N_qpij);
+          cv::Point2f qpij = rbf.interpolate(qcij);
 
           qpi_a.push_back(qpij);
           qci_a.push_back(qci[j]);
@@ -2,13 +2,23 @@
 
 #include "cvtools.h"
 
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Gaussian shape parameter
+static const float RBF_GAUSSIAN_EPS = 0.2f;
+
 inline float psiGaussian(const cv::Point2f p1, const cv::Point2f p2){
     float rSqr = (p1.x-p2.x)*(p1.x-p2.x) + (p1.y-p2.y)*(p1.y-p2.y);
 
     if (rSqr == 0.0)
         return 1.0;
     else
-        return std::exp(-0.2*rSqr);
+        return std::exp(-RBF_GAUSSIAN_EPS*rSqr);
 }
 
 inline float psiThinPlateSpline(const cv::Point2f p1, const cv::Point2f p2){
@@ -20,7 +30,7 @@ inline float psiThinPlateSpline(const cv::Point2f p1, const cv::Point2f p2){
         return (rSqr * std::log(sqrt(rSqr)));
 }
 
-void RBFInterpolator::setDataPoints(const std::vector<cv::Point2f> x, const std::vector<cv::Point2f> f){
+void RBFInterpolator::setDataPoints(const std::vector<cv::Point2f> &x, const std::vector<cv::Point2f> &f){
 
     unsigned int dim = 2;
     unsigned int N = x.size();
@@ -59,22 +69,235 @@ void RBFInterpolator::setDataPoints(const std::vector<cv::Point2f> x, const std:
 
     cv::solve(A, b, lambda, cv::DECOMP_LU);
 //cvtools::writeMat(lambda, "lambda.mat");
-}
 
-cv::Point2f RBFInterpolator::interpolate(const std::vector<cv::Point2f> x, const cv::Point2f xStar){
+    for(unsigned int d=0; d<3; d++){
+        affineX[d] = lambda(N+d,0);
+        affineY[d] = lambda(N+d,1);
+    }
 
-    unsigned int N = x.size();
-    cv::Point2f fTilde(0.0, 0.0);
+    // Order of knots in the contiguous arrays
+    std::vector<int> order(N);
+    for(unsigned int i=0; i<N; i++)
+        order[i] = i;
+
+    cellStart.clear();
+    gridCols = gridRows = 0;
+    gridOriginX = gridOriginY = 0.0;
 
+    if(truncationRadius > 0.0 && N > 0){
+        // Bin knots into cells of size truncationRadius
+        float maxX = x[0].x, maxY = x[0].y;
+        gridOriginX = x[0].x;
+        gridOriginY = x[0].y;
+        for(unsigned int i=1; i<N; i++){
+            gridOriginX = std::min(gridOriginX, x[i].x);
+            gridOriginY = std::min(gridOriginY, x[i].y);
+            maxX = std::max(maxX, x[i].x);
+            maxY = std::max(maxY, x[i].y);
+        }
+        gridCols = (int)((maxX - gridOriginX)/truncationRadius) + 1;
+        gridRows = (int)((maxY - gridOriginY)/truncationRadius) + 1;
+
+        std::vector<int> cellOf(N);
+        cellStart.assign(gridCols*gridRows + 1, 0);
+        for(unsigned int i=0; i<N; i++){
+            int cx = (int)((x[i].x - gridOriginX)/truncationRadius);
+            int cy = (int)((x[i].y - gridOriginY)/truncationRadius);
+            cellOf[i] = cy*gridCols + cx;
+            cellStart[cellOf[i]+1]++;
+        }
+        for(int c=0; c<gridCols*gridRows; c++)
+            cellStart[c+1] += cellStart[c];
+
+        std::vector<int> fill(cellStart.begin(), cellStart.end()-1);
+        for(unsigned int i=0; i<N; i++)
+            order[fill[cellOf[i]]++] = i;
+    }
+
+    knotX.resize(N);
+    knotY.resize(N);
+    lambdaX.resize(N);
+    lambdaY.resize(N);
     for(unsigned int i=0; i<N; i++){
-        float psi = psiGaussian(x[i], xStar);
+        knotX[i] = x[order[i]].x;
+        knotY[i] = x[order[i]].y;
+        lambdaX[i] = lambda(order[i],0);
+        lambdaY[i] = lambda(order[i],1);
+    }
+}
+
+#ifdef __SSE2__
+// Exponential of four floats (Cephes expf polynomial)
+static inline __m128 exp_ps(__m128 x){
+
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    x = _mm_min_ps(x, _mm_set1_ps(88.3762626647949f));
+    x = _mm_max_ps(x, _mm_set1_ps(-88.3762626647949f));
+
+    // express exp(x) as exp(g + n*log(2))
+    __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+
+    // floor
+    __m128 tmp = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+    __m128 mask = _mm_and_ps(_mm_cmpgt_ps(tmp, fx), one);
+    fx = _mm_sub_ps(tmp, mask);
+
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(0.693359375f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(-2.12194440e-4f)));
 
-        fTilde.x += lambda(i,0)*psi;
-        fTilde.y += lambda(i,1)*psi;
+    __m128 z = _mm_mul_ps(x, x);
+
+    __m128 y = _mm_set1_ps(1.9875691500E-4f);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507E-3f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073E-3f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894E-2f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459E-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201E-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, z), x);
+    y = _mm_add_ps(y, one);
+
+    // build 2^n
+    __m128i emm0 = _mm_cvttps_epi32(fx);
+    emm0 = _mm_add_epi32(emm0, _mm_set1_epi32(0x7f));
+    emm0 = _mm_slli_epi32(emm0, 23);
+
+    return _mm_mul_ps(y, _mm_castsi128_ps(emm0));
+}
+
+static inline float hsum_ps(__m128 v){
+    __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    sums = _mm_add_ss(sums, shuf);
+    return _mm_cvtss_f32(sums);
+}
+#endif
+
+// Weighted sum of Gaussian kernels of knots [begin, end) at (qx, qy), skipping knots
+// farther than sqrt(rSqrMax)
+static inline void sumKernels(const float *kx, const float *ky, const float *lx, const float *ly,
+                              int begin, int end, float qx, float qy, float rSqrMax,
+                              float &sumX, float &sumY){
+    int i = begin;
+#ifdef __SSE2__
+    const __m128 qxv = _mm_set1_ps(qx);
+    const __m128 qyv = _mm_set1_ps(qy);
+    const __m128 negEps = _mm_set1_ps(-RBF_GAUSSIAN_EPS);
+    const __m128 rSqrMaxv = _mm_set1_ps(rSqrMax);
+    __m128 accX = _mm_setzero_ps();
+    __m128 accY = _mm_setzero_ps();
+    for(; i+4 <= end; i+=4){
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(kx+i), qxv);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(ky+i), qyv);
+        __m128 rSqr = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        __m128 psi = exp_ps(_mm_mul_ps(negEps, rSqr));
+        psi = _mm_and_ps(psi, _mm_cmple_ps(rSqr, rSqrMaxv));
+        accX = _mm_add_ps(accX, _mm_mul_ps(_mm_loadu_ps(lx+i), psi));
+        accY = _mm_add_ps(accY, _mm_mul_ps(_mm_loadu_ps(ly+i), psi));
+    }
+    sumX += hsum_ps(accX);
+    sumY += hsum_ps(accY);
+#endif
+    for(; i<end; i++){
+        float rSqr = (kx[i]-qx)*(kx[i]-qx) + (ky[i]-qy)*(ky[i]-qy);
+        if(rSqr > rSqrMax)
+            continue;
+        float psi = psiGaussian(cv::Point2f(kx[i], ky[i]), cv::Point2f(qx, qy));
+        sumX += lx[i]*psi;
+        sumY += ly[i]*psi;
+    }
+}
+
+void RBFInterpolator::interpolateRange(const cv::Point2f *queries, cv::Point2f *results, int n) const{
+
+    const int N = knotX.size();
+    const float *kx = knotX.empty() ? NULL : &knotX[0];
+    const float *ky = knotY.empty() ? NULL : &knotY[0];
+    const float *lx = lambdaX.empty() ? NULL : &lambdaX[0];
+    const float *ly = lambdaY.empty() ? NULL : &lambdaY[0];
+
+    const float rSqrMax = truncationRadius*truncationRadius;
+
+    for(int q=0; q<n; q++){
+        const cv::Point2f &xStar = queries[q];
+        float sumX = 0.0, sumY = 0.0;
+
+        if(!std::isfinite(xStar.x) || !std::isfinite(xStar.y)){
+            results[q] = cv::Point2f(NAN, NAN);
+            continue;
+        }
+
+        if(cellStart.empty()){
+            sumKernels(kx, ky, lx, ly, 0, N, xStar.x, xStar.y, INFINITY, sumX, sumY);
+        } else {
+            // Visit the 3x3 neighbourhood of cells, which covers the radius. Cells are clamped to
+            // just outside the grid, such that far queries convert to int safely and see no knots.
+            float fx = std::floor((xStar.x - gridOriginX)/truncationRadius);
+            float fy = std::floor((xStar.y - gridOriginY)/truncationRadius);
+            int cx = (int)std::max(-2.0f, std::min(fx, (float)gridCols+1));
+            int cy = (int)std::max(-2.0f, std::min(fy, (float)gridRows+1));
+            for(int y=std::max(cy-1, 0); y<=std::min(cy+1, gridRows-1); y++){
+                int xBegin = std::max(cx-1, 0);
+                int xEnd = std::min(cx+1, gridCols-1);
+                if(xBegin > xEnd)
+                    continue;
+                // cells of a row are contiguous
+                sumKernels(kx, ky, lx, ly, cellStart[y*gridCols+xBegin], cellStart[y*gridCols+xEnd+1],
+                           xStar.x, xStar.y, rSqrMax, sumX, sumY);
+            }
+        }
+
+        results[q].x = sumX + affineX[0] + xStar.x*affineX[1] + xStar.y*affineX[2];
+        results[q].y = sumY + affineY[0] + xStar.x*affineY[1] + xStar.y*affineY[2];
     }
+}
+
+// Parallel loop body over blocks of queries
+class RBFInterpolateBody : public cv::ParallelLoopBody{
+    public:
+        RBFInterpolateBody(const RBFInterpolator *_rbf, const cv::Point2f *_queries, cv::Point2f *_results, int _blockSize, int _n)
+            : rbf(_rbf), queries(_queries), results(_results), blockSize(_blockSize), n(_n){}
+        void operator()(const cv::Range &range) const{
+            for(int b=range.start; b<range.end; b++){
+                int begin = b*blockSize;
+                int end = std::min(begin+blockSize, n);
+                rbf->interpolateRange(queries+begin, results+begin, end-begin);
+            }
+        }
+    private:
+        const RBFInterpolator *rbf;
+        const cv::Point2f *queries;
+        cv::Point2f *results;
+        int blockSize, n;
+};
+
+std::vector<cv::Point2f> RBFInterpolator::interpolate(const std::vector<cv::Point2f> &queries) const{
 
-    fTilde.x += lambda(N,0) + xStar.x*lambda(N+1,0) + xStar.y*lambda(N+2,0);
-    fTilde.y += lambda(N,1) + xStar.x*lambda(N+1,1) + xStar.y*lambda(N+2,1);
+    const int n = queries.size();
+    std::vector<cv::Point2f> results(n);
+    if(n == 0)
+        return results;
+
+    // Only spawn threads when the batch is large enough to pay off
+    const int blockSize = 1024;
+    if(n <= blockSize)
+        interpolateRange(&queries[0], &results[0], n);
+    else
+        cv::parallel_for_(cv::Range(0, (n+blockSize-1)/blockSize), RBFInterpolateBody(this, &queries[0], &results[0], blockSize, n));
+
+    return results;
+}
+
+cv::Point2f RBFInterpolator::interpolate(const cv::Point2f xStar) const{
+
+    cv::Point2f fTilde;
+    interpolateRange(&xStar, &fTilde, 1);
 
     return fTilde;
 }
+
+cv::Point2f RBFInterpolator::interpolate(const std::vector<cv::Point2f> &/*x*/, const cv::Point2f xStar) const{
+
+    return interpolate(xStar);
+}
@@ -13,14 +13,36 @@ enum tRBF {RBF_GAUSSIAN};
 
 class RBFInterpolator{
     public:
-        RBFInterpolator(tRBF _type = RBF_GAUSSIAN, float _regularizationK = 0.0) : type(_type), regularizationK(_regularizationK){}
+        RBFInterpolator(tRBF _type = RBF_GAUSSIAN, float _regularizationK = 0.0) : type(_type), regularizationK(_regularizationK), truncationRadius(0.0){}
         RBFInterpolator(std::vector<cv::Point2f> dataPoints, tRBF = RBF_GAUSSIAN, float _regularizationK = 0.0);
-        void setDataPoints(const std::vector<cv::Point2f> x, const std::vector<cv::Point2f> f);
-        cv::Point2f interpolate(const std::vector<cv::Point2f> x, const cv::Point2f xStar);
+        void setDataPoints(const std::vector<cv::Point2f> &x, const std::vector<cv::Point2f> &f);
+        // Only knots within radius contribute to the interpolant (0 = all knots, default).
+        // The interpolant is continuous up to the kernel's value at radius, exp(-0.2*radius^2).
+        // Must be set before setDataPoints()
+        void setTruncationRadius(float radius){truncationRadius = radius;}
+        cv::Point2f interpolate(const cv::Point2f xStar) const;
+        // Batched interpolation (SIMD, multithreaded for large batches)
+        std::vector<cv::Point2f> interpolate(const std::vector<cv::Point2f> &queries) const;
+        // Deprecated: knots are stored by setDataPoints(), x is ignored
+        cv::Point2f interpolate(const std::vector<cv::Point2f> &x, const cv::Point2f xStar) const;
     private:
+        void interpolateRange(const cv::Point2f *queries, cv::Point2f *results, int n) const;
+        friend class RBFInterpolateBody;
+
         tRBF type;
         float regularizationK;
+        float truncationRadius;
         cv::Mat_<float> lambda;
+
+        // Knots and RBF weights as contiguous arrays (sorted by grid cell if truncated)
+        std::vector<float> knotX, knotY, lambdaX, lambdaY;
+        // Affine part [1, x, y] for both output dimensions
+        float affineX[3], affineY[3];
+
+        // Uniform grid over the knots for truncated evaluation
+        float gridOriginX, gridOriginY;
+        int gridCols, gridRows;
+        std::vector<int> cellStart;
 };
 
 #endif // RBFINTERPOLATOR_H
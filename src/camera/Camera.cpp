@@ -82,3 +82,28 @@ Camera* Camera::NewCamera(unsigned int interfaceNum, unsigned int camNum,
 
   return (Camera*)NULL;
 }
+
+bool Camera::getFrameSequence(unsigned int N,
+                              std::chrono::steady_clock::time_point deadline,
+                              CameraFrameSequence& sequence) {
+  sequence.frames.resize(N);
+  sequence.nMissing = 0;
+  sequence.startIndex = -1;
+
+  for (unsigned int i = 0; i < N; i++) {
+    if (std::chrono::steady_clock::now() > deadline)
+      sequence.frames[i] = CameraFrame();
+    else
+      sequence.frames[i] = getFrame();
+
+    if (!sequence.frames[i].memory) {
+      sequence.nMissing++;
+      continue;
+    }
+
+    if (sequence.frames[i].flags != 0 && sequence.startIndex < 0)
+      sequence.startIndex = i;
+  }
+
+  return sequence.nMissing == 0;
+}
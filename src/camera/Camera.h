@@ -1,24 +1,110 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <vector>
 
+#include <opencv2/core/core.hpp>
+
+#include "PixelUnpack.h"
+
+// Layout of the frame memory
+enum CameraPixelFormat {
+  pixelFormatMono8,    // one byte per pixel
+  pixelFormatMono16,   // 16 bit little endian per pixel, see bitDepth
+  pixelFormatMono10p,  // GenICam packed, 4 pixels in 5 bytes
+  pixelFormatMono12p   // GenICam packed, 2 pixels in 3 bytes
+};
+
+// Bits per pixel in frame memory
+inline unsigned int cameraPixelFormatBits(CameraPixelFormat format) {
+  switch (format) {
+    case pixelFormatMono16:
+      return 16;
+    case pixelFormatMono10p:
+      return 10;
+    case pixelFormatMono12p:
+      return 12;
+    default:
+      return 8;
+  }
+}
+
 struct CameraFrame {
+  // Points into buffer if the driver provides one, otherwise into driver
+  // memory which is only valid until the next call to getFrame()
   unsigned char* memory;
   unsigned int width;
   unsigned int height;
   unsigned int sizeBytes;
   unsigned int timeStamp;
   unsigned int flags;
+  CameraPixelFormat pixelFormat;
+  // Significant bits per pixel. LSB aligned for Mono16 (e.g. 12 for a Mono12
+  // sensor delivering Mono16).
+  unsigned int bitDepth;
+  // Acquisition time [s] in the device's clock, 0 if unknown. Used to align
+  // frames with projector trigger times if the camera isFrameTimeRosTime().
+  double time;
+  // Reference counted handle on the frame buffer (empty if not provided).
+  // Copies share the memory, it is returned to the driver's frame pool when
+  // the last reference is released. Treat as read-only.
+  cv::Mat buffer;
   CameraFrame()
       : memory(NULL),
         width(0),
         height(0),
         sizeBytes(0),
         timeStamp(0),
-        flags(0) {}
+        flags(0),
+        pixelFormat(pixelFormatMono8),
+        bitDepth(8),
+        time(0.0) {}
+};
+
+// Frame as OpenCV matrix which owns its data, CV_8U for Mono8 and CV_16U for
+// all other frames. 16 bit frames are scaled to the full 16 bit range, such
+// that consumers need not know the sensor's bit depth. Shares the frame buffer
+// if the driver provides one and no scaling is needed, otherwise copies.
+// Packed frames are unpacked.
+inline cv::Mat cameraFrameToMat(const CameraFrame& frame) {
+  if (frame.pixelFormat == pixelFormatMono10p ||
+      frame.pixelFormat == pixelFormatMono12p) {
+    cv::Mat mat(frame.height, frame.width, CV_16U);
+    if (frame.pixelFormat == pixelFormatMono10p)
+      pixelunpack::unpackMono10p(frame.memory, mat.ptr<unsigned short>(),
+                                 mat.total());
+    else
+      pixelunpack::unpackMono12p(frame.memory, mat.ptr<unsigned short>(),
+                                 mat.total());
+    return mat;
+  }
+
+  int type = (frame.pixelFormat == pixelFormatMono16) ? CV_16U : CV_8U;
+  cv::Mat mat = !frame.buffer.empty()
+                    ? frame.buffer
+                    : cv::Mat(frame.height, frame.width, type, frame.memory);
+
+  if (type == CV_16U && frame.bitDepth < 16) {
+    cv::Mat scaled;
+    mat.convertTo(scaled, CV_16U, 1 << (16 - frame.bitDepth));
+    return scaled;
+  }
+
+  return frame.buffer.empty() ? mat.clone() : mat;
+}
+
+// Frames acquired in one getFrameSequence() call. Reused across calls, such
+// that the frame vector is allocated only once.
+struct CameraFrameSequence {
+  // One entry per requested frame, memory is NULL for missing frames
+  std::vector<CameraFrame> frames;
+  unsigned int nMissing;
+  // Index of the first frame carrying a sequence start flag, -1 if none
+  int startIndex;
+  CameraFrameSequence() : nMissing(0), startIndex(-1) {}
 };
 
 struct CameraSettings {
@@ -49,11 +135,26 @@ class Camera {
   bool isCapturing() { return capturing; }
   virtual void stopCapture() = 0;
   virtual CameraFrame getFrame() = 0;
+  // Acquire N consecutive frames, giving up on frames not arrived by deadline.
+  // Returns true if no frame is missing. The default calls getFrame() N times,
+  // hardware triggered backends may collect the frames natively.
+  virtual bool getFrameSequence(
+      unsigned int N, std::chrono::steady_clock::time_point deadline,
+      CameraFrameSequence& sequence);
   virtual size_t getFrameSizeBytes() = 0;
   virtual size_t getFrameWidth() = 0;
   virtual size_t getFrameHeight() = 0;
   virtual CameraSettings getCameraSettings() = 0;
   virtual void setCameraSettings(CameraSettings) = 0;
+  // Requests the pixel format of subsequent frames, must not be capturing.
+  // Returns false if the camera does not support it. Mono8 is the default.
+  // Packed formats transfer fewer bytes than Mono16 at the same bit depth.
+  virtual bool setPixelFormat(CameraPixelFormat format) {
+    return format == pixelFormatMono8;
+  }
+  // True if CameraFrame::time is ROS time, the clock projectors report their
+  // trigger times in. Device clocks are not synchronized to it.
+  virtual bool isFrameTimeRosTime() { return false; }
   virtual ~Camera() {}
   virtual void get_input(const std::string& input_name,
                          std::shared_ptr<void> input_ptr) {}
@@ -0,0 +1,144 @@
+#include "CameraFramePool.h"
+
+#include <iostream>
+
+namespace {
+
+// Calls the release function of wrapped driver memory when the last cv::Mat
+// referencing it is released
+#if CV_MAJOR_VERSION < 3
+// OpenCV 2 keeps the reference count next to the allocator, which finds the
+// release function through it
+struct WrappedMemory {
+  int refcount;  // first member, the Mat's refcount points here
+  std::function<void()> *release;
+};
+
+class WrapAllocator : public cv::MatAllocator {
+ public:
+  void allocate(int dims, const int *sizes, int type, int *&refcount,
+                uchar *&datastart, uchar *&data, size_t *step) {
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--) {
+      step[i] = total;
+      total *= sizes[i];
+    }
+    uchar *memory = (uchar *)cv::fastMalloc(total);
+    WrappedMemory *wrapped = new WrappedMemory;
+    wrapped->refcount = 1;
+    wrapped->release =
+        new std::function<void()>([memory]() { cv::fastFree(memory); });
+    refcount = &wrapped->refcount;
+    datastart = data = memory;
+  }
+  void deallocate(int *refcount, uchar *, uchar *) {
+    WrappedMemory *wrapped = (WrappedMemory *)refcount;
+    (*wrapped->release)();
+    delete wrapped->release;
+    delete wrapped;
+  }
+};
+#else
+#if CV_MAJOR_VERSION < 4
+typedef int AccessFlags;
+#else
+typedef cv::AccessFlag AccessFlags;
+#endif
+
+class WrapAllocator : public cv::MatAllocator {
+ public:
+  // Never called, matrices only use the allocator of their UMatData to free it
+  cv::UMatData *allocate(int, const int *, int, void *, size_t *, AccessFlags,
+                         cv::UMatUsageFlags) const {
+    return NULL;
+  }
+  bool allocate(cv::UMatData *, AccessFlags, cv::UMatUsageFlags) const {
+    return false;
+  }
+  void deallocate(cv::UMatData *u) const {
+    if (!u) return;
+    std::function<void()> *release = (std::function<void()> *)u->userdata;
+    (*release)();
+    delete release;
+    delete u;
+  }
+};
+#endif
+
+WrapAllocator wrapAllocator;
+
+}  // namespace
+
+bool CameraFramePool::isInUse(const cv::Mat &buffer) {
+  // The pool's own header accounts for one reference
+#if CV_MAJOR_VERSION < 3
+  return buffer.refcount && *buffer.refcount > 1;
+#else
+  return buffer.u && buffer.u->refcount > 1;
+#endif
+}
+
+cv::Mat CameraFramePool::acquire(int rows, int cols, int type) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  // Round robin, such that a released buffer is not reused immediately
+  for (size_t k = 0; k < buffers.size(); k++) {
+    size_t i = (next + k) % buffers.size();
+    cv::Mat &buffer = buffers[i];
+    if (isInUse(buffer)) continue;
+
+    // Reallocates only if the frame format changed
+    buffer.create(rows, cols, type);
+    next = (i + 1) % buffers.size();
+    return buffer;
+  }
+
+  cv::Mat buffer(rows, cols, type);
+  if (buffers.size() < maxBuffers) {
+    buffers.push_back(buffer);
+    next = 0;
+  } else {
+    std::cerr << "CameraFramePool: all " << maxBuffers
+              << " buffers in use, allocating unpooled frame" << std::endl;
+  }
+
+  return buffer;
+}
+
+size_t CameraFramePool::getNumBuffersInUse() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  size_t n = 0;
+  for (size_t i = 0; i < buffers.size(); i++)
+    if (isInUse(buffers[i])) n++;
+
+  return n;
+}
+
+cv::Mat CameraFramePool::wrap(int rows, int cols, int type, void *data,
+                              std::function<void()> release) {
+  cv::Mat mat(rows, cols, type, data);
+
+#if CV_MAJOR_VERSION < 3
+  WrappedMemory *wrapped = new WrappedMemory;
+  wrapped->refcount = 1;
+  wrapped->release = new std::function<void()>(release);
+  mat.refcount = &wrapped->refcount;
+  mat.allocator = &wrapAllocator;
+#else
+  cv::UMatData *u = new cv::UMatData(&wrapAllocator);
+  u->data = u->origdata = mat.data;
+  u->size = mat.total() * mat.elemSize();
+  u->refcount = 1;
+  u->userdata = new std::function<void()>(release);
+  mat.u = u;
+#endif
+
+  return mat;
+}
+
+void CameraFramePool::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  buffers.clear();
+  next = 0;
+}
@@ -0,0 +1,44 @@
+#ifndef CAMERAFRAMEPOOL_H
+#define CAMERAFRAMEPOOL_H
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// Pool of reference counted frame buffers shared between a camera driver and
+// the processing pipeline. Buffers are handed out as cv::Mat, so frame
+// sequences and decoders keep them alive through OpenCV's reference counting.
+// A buffer returns to the pool once the pool holds its only reference.
+//
+// Drivers which can hold on to their own buffers (DMA rings, SDK images) hand
+// them out through wrap() instead, without copying into the pool.
+class CameraFramePool {
+ public:
+  CameraFramePool(size_t maxBuffers = 64) : maxBuffers(maxBuffers), next(0) {}
+  // Returns a buffer not referenced outside the pool. If all pooled buffers are
+  // in use, an unpooled buffer is allocated instead (never blocks).
+  cv::Mat acquire(int rows, int cols, int type = CV_8U);
+  // Number of pooled buffers currently referenced outside the pool
+  size_t getNumBuffersInUse();
+  // Drops all pooled buffers. Buffers still in use stay valid.
+  void clear();
+
+  // Reference counted cv::Mat over driver memory. release is called once the
+  // last reference is dropped, from whichever thread drops it, and must hand
+  // the memory back to the driver. Matrices created anew in the returned
+  // header's place (create() with another size or type) own plain memory.
+  static cv::Mat wrap(int rows, int cols, int type, void *data,
+                      std::function<void()> release);
+
+ private:
+  static bool isInUse(const cv::Mat &buffer);
+
+  std::mutex mutex;
+  std::vector<cv::Mat> buffers;
+  size_t maxBuffers;
+  size_t next;
+};
+
+#endif
@@ -34,7 +34,7 @@ std::vector<CameraInfo> CameraIDSImaging::getCameraList(){
     return ret;
 }
 
-CameraIDSImaging::CameraIDSImaging(unsigned int camNum, CameraTriggerMode triggerMode):  Camera(triggerMode), frameWidth(0), frameHeight(0), frameMemory(NULL), memoryID(0){
+CameraIDSImaging::CameraIDSImaging(unsigned int camNum, CameraTriggerMode triggerMode):  Camera(triggerMode), frameWidth(0), frameHeight(0){
 
     // Init Camera
     camera = (HIDS) camNum + 1;
@@ -78,24 +78,20 @@ CameraIDSImaging::CameraIDSImaging(unsigned int camNum, CameraTriggerMode trigge
     is_SetColorMode(camera, IS_CM_MONO8);
     int bitsPerPixel = 8;
 
-//    // Memory initialization
-//    is_ClearSequence(camera);
-//    for(unsigned int i=0; i<1; i++){
-//        frameMemory[i] = 0;
-//        memoryID[i] = 0;
-//        is_AllocImageMem(camera, frameWidth, frameHeight, bitsPerPixel, &frameMemory[i], &memoryID[i]);
-//        is_AddToSequence(camera, frameMemory[i], memoryID[i]);
-//    }
-
     // Set display mode - unecessary with InitCamera with NULL pointer to display
     is_SetDisplayMode(camera, IS_SET_DM_DIB);
 
     // Configure FIFO queue
     //is_InitImageQueue(camera, 0);
 
-    // Single frame memory
-    is_AllocImageMem(camera, frameWidth, frameHeight, bitsPerPixel, &frameMemory, &memoryID);
-    is_SetImageMem(camera, frameMemory, memoryID);
+    // Sequence ring, frames reference its buffers instead of copies
+    is_ClearSequence(camera);
+    frameMemory.resize(nSequenceBuffers, NULL);
+    memoryID.resize(nSequenceBuffers, 0);
+    for(unsigned int i=0; i<nSequenceBuffers; i++){
+        is_AllocImageMem(camera, frameWidth, frameHeight, bitsPerPixel, &frameMemory[i], &memoryID[i]);
+        is_AddToSequence(camera, frameMemory[i], memoryID[i]);
+    }
 
     // Set max available pixel clock
     unsigned int pixelClockRange[3];
@@ -253,18 +249,37 @@ CameraFrame CameraIDSImaging::getFrame(){
         //is_GetActiveImageMem(camera, &frameMemory, &memoryID);
     //    is_FreezeVideo(camera, IS_WAIT);
     } else {
-        is_GetActiveImageMem(camera, &frameMemory, &memoryID);
         is_FreezeVideo(camera, IS_WAIT);
     }
 
+    // Last completed buffer of the sequence ring
+    int seqNum;
+    char *seqMemory, *lastMemory = NULL;
+    is_GetActSeqBuf(camera, &seqNum, &seqMemory, &lastMemory);
+    int id = 0;
+    for(unsigned int i=0; i<nSequenceBuffers; i++)
+        if(frameMemory[i] == lastMemory)
+            id = memoryID[i];
+    if(id == 0){
+        std::cerr << "CameraIDSImaging: no completed frame!" << std::endl;
+        return frame;
+    }
+
     UEYEIMAGEINFO imageInfo;
-    is_GetImageInfo(camera, memoryID, &imageInfo, sizeof(imageInfo));
+    is_GetImageInfo(camera, id, &imageInfo, sizeof(imageInfo));
+
+    // The camera skips the locked buffer until the pipeline releases the frame
+    is_LockSeqBuf(camera, IS_IGNORE_PARAMETER, lastMemory);
+    HIDS cam = camera;
+    cv::Mat buffer = CameraFramePool::wrap(imageInfo.dwImageHeight, imageInfo.dwImageWidth, CV_8U, lastMemory,
+                                           [cam, lastMemory](){ is_UnlockSeqBuf(cam, IS_IGNORE_PARAMETER, lastMemory); });
 
-    frame.memory = (unsigned char*)frameMemory;
+    frame.memory = buffer.data;
     frame.width = imageInfo.dwImageWidth;
     frame.height = imageInfo.dwImageHeight;
     frame.timeStamp = imageInfo.u64TimestampDevice;
     frame.sizeBytes = imageInfo.dwImageHeight * imageInfo.dwImageWidth;
+    frame.buffer = buffer;
     return frame;
 }
 
@@ -276,7 +291,7 @@ size_t CameraIDSImaging::getFrameSizeBytes(){
     }
 
     UEYEIMAGEINFO imageInfo;
-    is_GetImageInfo(camera, memoryID, &imageInfo, sizeof(imageInfo));
+    is_GetImageInfo(camera, memoryID[0], &imageInfo, sizeof(imageInfo));
 
     return imageInfo.dwImageHeight * imageInfo.dwImageWidth;
 }
@@ -301,7 +316,10 @@ CameraIDSImaging::~CameraIDSImaging(){
     if(capturing)
         stopCapture();
 
-    is_FreeImageMem(camera, frameMemory, memoryID);
+    // Frames must be released before, their memory is freed here
+    is_ClearSequence(camera);
+    for(unsigned int i=0; i<nSequenceBuffers; i++)
+        is_FreeImageMem(camera, frameMemory[i], memoryID[i]);
 
     // Exit and free memories
     // Note: IDS defines an OpenGLContext too, which might collide with our own class
@@ -11,7 +11,10 @@
     typedef unsigned int HIDS;
 #endif
 
+#include <vector>
+
 #include "Camera.h"
+#include "CameraFramePool.h"
 
 class CameraIDSImaging : public Camera {
     public:
@@ -31,8 +34,11 @@ class CameraIDSImaging : public Camera {
     private:
         HIDS camera;
         unsigned int frameWidth, frameHeight;
-        char* frameMemory; // char pointers
-        int memoryID;
+        // Sequence ring the camera captures into. Buffers handed out as frames
+        // are locked, such that the camera skips them until they are released.
+        static const unsigned int nSequenceBuffers = 32;
+        std::vector<char*> frameMemory;
+        std::vector<int> memoryID;
         #ifdef WIN32
             HANDLE hEvent;
         #endif
@@ -1,4 +1,5 @@
 #include "CameraIIDC.h"
+#include <algorithm>
 #include <cstring>
 
 vector<CameraInfo> CameraIIDC::getCameraList(){
@@ -288,15 +289,22 @@ CameraFrame CameraIIDC::getFrame(){
         return frame;
     }
 
+    // Copy into pooled buffer, such that the DMA buffer can be returned immediately.
+    // The ring holds a single buffer (two on OS X), which the camera needs for the
+    // next frame, so IIDC frames are not handed out zero-copy.
+    cv::Mat buffer = framePool.acquire(currentFrame->size[1], currentFrame->size[0], CV_8U);
+    frame.sizeBytes = std::min<size_t>(currentFrame->image_bytes, buffer.total());
+    memcpy(buffer.data, currentFrame->image, frame.sizeBytes);
+
     // Return the frame to the ring buffer:
     dc1394_capture_enqueue(cam, currentFrame);
     currentFrame = NULL;
 
     // Copy frame address and properties
-    frame.memory = currentFrame->image;
-    frame.width = currentFrame->size[0];
-    frame.height = currentFrame->size[1];
-    frame.sizeBytes = currentFrame->image_bytes;
+    frame.memory = buffer.data;
+    frame.width = buffer.cols;
+    frame.height = buffer.rows;
+    frame.buffer = buffer;
 
     return frame;
 }
@@ -2,6 +2,7 @@
 #define CAMERAIIDC_H
 
 #include "Camera.h"
+#include "CameraFramePool.h"
 #include <dc1394/dc1394.h>
 
 using namespace std;
@@ -26,6 +27,7 @@ class CameraIIDC : public Camera {
         dc1394camera_t *cam;
         dc1394video_mode_t video_mode;
         dc1394video_frame_t *currentFrame;
+        CameraFramePool framePool;
         void flushBuffer();
 };
 
@@ -4,7 +4,6 @@
 #include <chrono>
 #include <cstring>
 #include <memory>
-#include <mutex>
 #include <thread>
 
 vector<CameraInfo> CameraROS::getCameraList() {
@@ -52,6 +51,14 @@ CameraSettings CameraROS::getCameraSettings() {
 
 void CameraROS::setCameraSettings(CameraSettings settings) {}
 
+bool CameraROS::setPixelFormat(CameraPixelFormat format) {
+  // cv_bridge converts the published images, but has no packed formats
+  if (format == pixelFormatMono10p || format == pixelFormatMono12p)
+    return false;
+  m_mono16 = (format == pixelFormatMono16);
+  return true;
+}
+
 void CameraROS::startCapture() { capturing = true; }
 
 void CameraROS::stopCapture() { capturing = false; }
@@ -62,51 +69,19 @@ CameraFrame CameraROS::getFrame() {
   if (triggerMode == triggerModeSoftware) {
     std::this_thread::sleep_for(std::chrono::microseconds(m_exposure_time_us));
 
-    {
-      boost::mutex::scoped_lock mutex_lock(m_mutex);
-      m_sw_trig_state = Esoftware_trigger_state::awaiting_image;
-    }
-
-    bool success = false;
+    // Images received before this point are stale
+    while (m_image_ring.front()) discard_image();
 
     for (int i = 0; i < m_max_retries; i++) {
       // cout << "[CameraROS] Try no:" << i << endl;
 
-      std::this_thread::sleep_for(
-          std::chrono::microseconds(m_exposure_time_us / 2));
-
-      {
-        boost::mutex::scoped_lock mutex_lock(m_mutex);
-        if (m_sw_trig_state == Esoftware_trigger_state::received_image) {
-          success = true;
-          break;
-        }
-      }
-    }
-
-    if (success) {
-      boost::mutex::scoped_lock mutex_lock(m_mutex);
-
-      // If image is in BayerGB8, convert to Mono8
-      if (!sensor_msgs::image_encodings::isMono(m_sw_trig_buffer.encoding)) {
-        m_sw_trig_buffer =
-            *cv_bridge::toCvCopy(m_sw_trig_buffer,
-                                 sensor_msgs::image_encodings::MONO8)
-                 ->toImageMsg();
+      if (m_image_ring.front()) {
+        consume_image(frame);
+        break;
       }
 
-      frame.memory = &m_sw_trig_buffer.data[0];
-      frame.height = m_sw_trig_buffer.height;
-      frame.width = m_sw_trig_buffer.width;
-      frame.sizeBytes = m_sw_trig_buffer.step;
-
-      // cout << frame.height << endl;
-      // cout << frame.width << endl;
-    }
-
-    {
-      boost::mutex::scoped_lock mutex_lock(m_mutex);
-      m_sw_trig_state = Esoftware_trigger_state::idle;
+      std::this_thread::sleep_for(
+          std::chrono::microseconds(m_exposure_time_us / 2));
     }
   }
 
@@ -132,28 +107,118 @@ CameraFrame CameraROS::getFrame() {
   return frame;
 }
 
+bool CameraROS::getFrameSequence(unsigned int N,
+                                 std::chrono::steady_clock::time_point deadline,
+                                 CameraFrameSequence& sequence) {
+  // Without an expected time, images are delivered in arrival order and
+  // aligned to the triggers by the caller
+  bool in_order = m_expected_image_time.isZero();
+
+  // Frames after the first are matched by sequence number, or by expected
+  // time if the publisher does not number its images
+  bool by_seq = m_has_sequence_numbers;
+  if (triggerMode == triggerModeSoftware ||
+      (!in_order && !by_seq && m_image_period.isZero()))
+    return Camera::getFrameSequence(N, deadline, sequence);
+
+  sequence.frames.resize(N);
+  sequence.nMissing = 0;
+  sequence.startIndex = -1;
+
+  ros::Time first_image_time = m_expected_image_time;
+  uint32_t first_seq = 0;
+  bool first_found = false;
+
+  for (unsigned int i = 0; i < N; i++) {
+    CameraFrame& frame = sequence.frames[i];
+    frame = CameraFrame();
+
+    m_expected_image_time = first_image_time + m_image_period * (double)i;
+    uint32_t seq = first_seq + i;
+
+    int status = 0;
+    while (status == 0 && std::chrono::steady_clock::now() < deadline) {
+      if (in_order) {
+        if (m_image_ring.front()) {
+          consume_image(frame);
+          status = 1;
+        }
+      } else if (first_found && by_seq)
+        status = retrieve_frame_by_seq(seq, frame);
+      else
+        status = retrieve_frame(frame);
+      if (status == 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+
+    if (status != 1) {
+      sequence.nMissing++;
+      continue;
+    }
+
+    // Sequence number of the first frame matched by trigger time
+    if (!first_found) {
+      first_seq = m_last_consumed_seq - i;
+      first_found = true;
+    }
+  }
+
+  m_expected_image_time = first_image_time;
+
+  return sequence.nMissing == 0;
+}
+
 size_t CameraROS::getFrameSizeBytes() {}
 
 size_t CameraROS::getFrameWidth() { return m_frame_width; }
 
 size_t CameraROS::getFrameHeight() { return m_frame_height; }
 
-void CameraROS::image_cb(const sensor_msgs::Image& image) {
-  if (capturing) {
-    if (triggerMode == triggerModeSoftware &&
-        m_sw_trig_state == Esoftware_trigger_state::awaiting_image) {
-      boost::mutex::scoped_lock mutex_lock(m_mutex);
-      // cout << "[CameraROS] Retrived image if dims " << image.width << "x"
-      //     << image.height << endl;
-      m_sw_trig_buffer = image;
-      m_sw_trig_state = Esoftware_trigger_state::received_image;
-    } else if (triggerMode == triggerModeHardware) {
-      boost::mutex::scoped_lock mutex_lock(m_mutex);
-      // cout << "[CameraROS] Image received with timestamp: "
-      //   << image.header.stamp << endl;
-      m_hw_trig_buffer.emplace_back(image);
+void CameraROS::image_cb(const sensor_msgs::ImageConstPtr& image) {
+  if (!capturing) return;
+
+  // Detect whether the publisher numbers images consecutively
+  if (image->header.seq == m_last_received_seq + 1)
+    m_has_sequence_numbers = true;
+  m_last_received_seq = image->header.seq;
+
+  ReceivedImage* slot = m_image_ring.beginPush();
+  if (slot == NULL) {
+    // Consumer fell behind, the ring keeps the older images. Expected in
+    // software trigger mode, where only images after a request are used.
+    m_dropped_images++;
+    if (triggerMode == triggerModeHardware)
+      cout << "[CameraROS] Image queue full, dropped " << m_dropped_images
+           << " images" << endl;
+    return;
+  }
+
+  try {
+    // Shares the message buffer if already in the requested format, converts
+    // e.g. BayerGB8
+    bool mono16 = m_mono16;
+    cv_bridge::CvImageConstPtr cv_image = cv_bridge::toCvShare(
+        image, mono16 ? sensor_msgs::image_encodings::MONO16
+                      : sensor_msgs::image_encodings::MONO8);
+
+    // The frame keeps the message (or the converted image) alive, without a
+    // copy. Rows with padding are copied into a pooled buffer.
+    const cv::Mat& mat = cv_image->image;
+    if (mat.isContinuous()) {
+      slot->buffer = CameraFramePool::wrap(mat.rows, mat.cols, mat.type(),
+                                           mat.data, [cv_image]() {});
+    } else {
+      slot->buffer = m_frame_pool.acquire(mat.rows, mat.cols, mat.type());
+      mat.copyTo(slot->buffer);
     }
+  } catch (cv_bridge::Exception& e) {
+    cout << "[CameraROS] cv_bridge exception: " << e.what() << endl;
+    return;
   }
+
+  slot->stamp = image->header.stamp;
+  slot->seq = image->header.seq;
+  m_image_ring.commitPush();
 }
 
 CameraROS::~CameraROS() {
@@ -170,62 +235,90 @@ CameraROS::~CameraROS() {
 void CameraROS::get_input(const std::string& input_name,
                           std::shared_ptr<void> input_ptr) {
   if (input_name == "expected_image_time") {
-    boost::mutex::scoped_lock mutex_lock(m_mutex);
     m_expected_image_time = *std::static_pointer_cast<ros::Time>(input_ptr);
     // std::cout << "[CameraROS] Received expected image time: "
     //          << m_expected_image_time << std::endl;
+  } else if (input_name == "image_period") {
+    m_image_period = *std::static_pointer_cast<ros::Duration>(input_ptr);
   }
 }
 
 int CameraROS::retrieve_frame(CameraFrame& frame) {
-  int result = 0;  // -1 : Missed frame, 0 : Frame not yet arrived, 1 : Frame
-                   // acquired successfully
-
-  if (m_hw_trig_buffer.size() > 0) {
-    boost::mutex::scoped_lock lock(m_mutex);
-    auto it = m_hw_trig_buffer.begin();
-    while (it != m_hw_trig_buffer.end()) {
-      double delta_t = (it->header.stamp - m_expected_image_time).toSec();
-
-      // std::cout << "[CameraROS] " << m_expected_image_time << " - "
-      //          << it->header.stamp << " = " << delta_t << std::endl;
-
-      if (delta_t < -1.0 * m_image_time_tolerance_s) {
-        // If current image is before the expected trigger time, we delete it
-        // since it is no longer of use
-        std::cout << "[CameraROS] Deleting frame, outdated" << std::endl;
-        it = m_hw_trig_buffer.erase(it);
-      } else if (delta_t >= -1.0 * m_image_time_tolerance_s &&
-                 delta_t <= m_image_time_tolerance_s) {
-        // If current image matches the trigger time, we place it in the Camera
-        // frame and delete it from the vector
-
-        // If image is in BayerGB8, convert to Mono8
-
-        if (!sensor_msgs::image_encodings::isMono(it->encoding)) {
-          *it = *cv_bridge::toCvCopy(*it, sensor_msgs::image_encodings::MONO8)
-                     ->toImageMsg();
-        }
-
-        frame.memory = &it->data[0];
-        frame.height = it->height;
-        frame.width = it->width;
-        frame.sizeBytes = it->step;
+  // -1 : Missed frame, 0 : Frame not yet arrived, 1 : Frame acquired
+  // successfully
+
+  ReceivedImage* image;
+  while ((image = m_image_ring.front()) != NULL) {
+    double delta_t = (image->stamp - m_expected_image_time).toSec();
+
+    // std::cout << "[CameraROS] " << m_expected_image_time << " - "
+    //          << image->stamp << " = " << delta_t << std::endl;
+
+    if (delta_t < -1.0 * m_image_time_tolerance_s) {
+      // If current image is before the expected trigger time, we delete it
+      // since it is no longer of use
+      std::cout << "[CameraROS] Deleting frame, outdated" << std::endl;
+      discard_image();
+    } else if (delta_t <= m_image_time_tolerance_s) {
+      // If current image matches the trigger time, we place it in the Camera
+      // frame and remove it from the queue
+      consume_image(frame);
+      std::cout << "[CameraROS] Found matching frame " << std::endl;
+      return 1;
+    } else {
+      // If image is in the future, means we have most likely missed the frame
+      // that matches the current trigger timing
+      std::cout << "[CameraROS] Missed this frame" << std::endl;
+      return -1;
+    }
+  }
 
-        std::cout << "[CameraROS] Found matching frame " << std::endl;
-        it = m_hw_trig_buffer.erase(it);
-        result = 1;
-        break;
-      }
+  return 0;
+}
 
-      else {
-        // If image is in the future, means we have most likely missed the frame
-        // that matches the current trigger timing
-        std::cout << "[CameraROS] Missed this frame" << std::endl;
-        result = -1;
-        break;
-      }
+int CameraROS::retrieve_frame_by_seq(uint32_t seq, CameraFrame& frame) {
+  // Same return values as retrieve_frame()
+
+  ReceivedImage* image;
+  while ((image = m_image_ring.front()) != NULL) {
+    int32_t delta_seq = (int32_t)(image->seq - seq);
+
+    if (delta_seq < 0) {
+      discard_image();
+    } else if (delta_seq == 0) {
+      consume_image(frame);
+      return 1;
+    } else {
+      std::cout << "[CameraROS] Missed frame " << seq << std::endl;
+      return -1;
     }
   }
-  return result;
+
+  return 0;
+}
+
+void CameraROS::consume_image(CameraFrame& frame) {
+  ReceivedImage* image = m_image_ring.front();
+
+  frame.memory = image->buffer.data;
+  frame.height = image->buffer.rows;
+  frame.width = image->buffer.cols;
+  frame.sizeBytes = image->buffer.total() * image->buffer.elemSize();
+  frame.pixelFormat = (image->buffer.depth() == CV_16U) ? pixelFormatMono16
+                                                        : pixelFormatMono8;
+  frame.bitDepth = (image->buffer.depth() == CV_16U) ? 16 : 8;
+  // Microseconds, wraps around like the other backends' counters
+  frame.timeStamp = (unsigned int)(image->stamp.toNSec() / 1000);
+  frame.time = image->stamp.toSec();
+  m_last_consumed_seq = image->seq;
+  frame.buffer = image->buffer;
+
+  // The ring must not keep a reference, such that the pool can recycle it
+  image->buffer.release();
+  m_image_ring.pop();
+}
+
+void CameraROS::discard_image() {
+  m_image_ring.front()->buffer.release();
+  m_image_ring.pop();
 }
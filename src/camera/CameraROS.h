@@ -2,15 +2,14 @@
 #define CameraROS_H
 
 #include "Camera.h"
+#include "CameraFramePool.h"
+#include "SPSCRing.h"
 
 #include <ros/ros.h>
 #include <sensor_msgs/Image.h>
 #include <versavis/TimeNumbered.h>
-#include <mutex>
-
-#include <boost/thread/mutex.hpp>
-#include <boost/thread/thread.hpp>
 
+#include <atomic>
 #include <string>
 
 using namespace std;
@@ -25,20 +24,32 @@ class CameraROS : public Camera {
 
   CameraSettings getCameraSettings();
   void setCameraSettings(CameraSettings);
+  bool setPixelFormat(CameraPixelFormat format) override;
+  // Frames are stamped by the Versavis trigger board
+  bool isFrameTimeRosTime() override { return true; }
   void startCapture();
   void stopCapture();
   CameraFrame getFrame();
+  bool getFrameSequence(unsigned int N,
+                        std::chrono::steady_clock::time_point deadline,
+                        CameraFrameSequence& sequence) override;
   size_t getFrameSizeBytes();
   size_t getFrameWidth();
   size_t getFrameHeight();
   ~CameraROS();
-  void image_cb(const sensor_msgs::Image& image);
+  void image_cb(const sensor_msgs::ImageConstPtr& image);
 
+  // Called from the same thread as getFrame()
   virtual void get_input(const std::string& input_name,
                          std::shared_ptr<void> input_ptr) override;
 
  private:
-  enum class Esoftware_trigger_state { idle, awaiting_image, received_image };
+  // Image received by the subscriber, converted to Mono8 or Mono16
+  struct ReceivedImage {
+    cv::Mat buffer;
+    ros::Time stamp;
+    uint32_t seq;
+  };
 
   std::unique_ptr<ros::NodeHandle> m_nh_ptr;
   std::unique_ptr<ros::AsyncSpinner> m_spinner_ptr;
@@ -55,15 +66,27 @@ class CameraROS : public Camera {
   // const size_t m_frame_width = 720;   // Blackfly
   // const size_t m_frame_height = 540;  //
   const unsigned int m_exposure_time_us = 8333;
-  boost::mutex m_mutex;
-  Esoftware_trigger_state m_sw_trig_state = Esoftware_trigger_state::idle;
-  sensor_msgs::Image m_sw_trig_buffer;
   const int m_max_retries = 50;
   ros::Time m_expected_image_time;
+  // Time between images of a sequence, zero if not provided
+  ros::Duration m_image_period;
   double m_image_time_tolerance_s = 0.0005;
-  std::vector<sensor_msgs::Image> m_hw_trig_buffer;
+
+  // Filled by the subscriber (spinner thread), consumed by getFrame()
+  SPSCRing<ReceivedImage, 16> m_image_ring;
+  CameraFramePool m_frame_pool;
+  std::atomic<unsigned int> m_dropped_images{0};
+  // Requested pixel format, read by the subscriber
+  std::atomic<bool> m_mono16{false};
+  // Set once the publisher numbers images consecutively
+  std::atomic<bool> m_has_sequence_numbers{false};
+  uint32_t m_last_received_seq = 0;
+  uint32_t m_last_consumed_seq = 0;
 
   int retrieve_frame(CameraFrame& frame);
+  int retrieve_frame_by_seq(uint32_t seq, CameraFrame& frame);
+  void consume_image(CameraFrame& frame);
+  void discard_image();
 };
 
 #endif
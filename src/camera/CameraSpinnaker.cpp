@@ -1,4 +1,5 @@
 ﻿#include "CameraSpinnaker.h"
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <memory>
@@ -459,6 +460,9 @@ CameraSpinnaker::CameraSpinnaker(unsigned int camNum,
   // settings.shutter = 33.333;
   settings.gain = 0.0;
   this->setCameraSettings(settings);
+
+  clearFrameQueue();
+  m_image_event = std::make_shared<CameraSpinnakerImageEvent>(this);
   return;
 }
 
@@ -488,6 +492,31 @@ CameraSettings CameraSpinnaker::getCameraSettings() {
   return settings;
 }
 
+bool CameraSpinnaker::setPixelFormat(CameraPixelFormat format) {
+  try {
+    if (!Spinnaker::GenApi::IsWritable(m_cam_ptr->PixelFormat)) {
+      cout << "Pixel format not writable..." << endl;
+      return false;
+    }
+    Spinnaker::PixelFormatEnums value = Spinnaker::PixelFormat_Mono8;
+    if (format == pixelFormatMono16)
+      value = Spinnaker::PixelFormat_Mono16;
+    else if (format == pixelFormatMono10p)
+      value = Spinnaker::PixelFormat_Mono10p;
+    else if (format == pixelFormatMono12p)
+      value = Spinnaker::PixelFormat_Mono12p;
+    m_cam_ptr->PixelFormat.SetValue(value);
+    cout << "Pixel format set to "
+         << m_cam_ptr->PixelFormat.GetCurrentEntry()->GetSymbolic() << endl;
+  } catch (Spinnaker::Exception& e) {
+    cout << "Error: " << e.what() << endl;
+    return false;
+  }
+
+  m_pixel_format = format;
+  return true;
+}
+
 void CameraSpinnaker::setCameraSettings(CameraSettings settings) {
   try {
     if (Spinnaker::GenApi::IsReadable(m_cam_ptr->ExposureTime) &&
@@ -624,6 +653,15 @@ void CameraSpinnaker::startCapture() {
     cout << "Error: " << e.what() << endl;
   }
 
+  // Deliver images through the image event handler
+  clearFrameQueue();
+  try {
+    m_cam_ptr->RegisterEvent(*m_image_event);
+    cout << "Image event handler registered" << endl;
+  } catch (Spinnaker::Exception& e) {
+    cout << "Error: " << e.what() << endl;
+  }
+
   // Begin acquiring images
   try {
     m_cam_ptr->BeginAcquisition();
@@ -660,14 +698,100 @@ void CameraSpinnaker::stopCapture() {
     cout << "Error: " << e.what() << endl;
   }
 
+  try {
+    m_cam_ptr->UnregisterEvent(*m_image_event);
+    cout << "Image event handler unregistered" << endl;
+  } catch (Spinnaker::Exception& e) {
+    cout << "Error: " << e.what() << endl;
+  }
+
+  clearFrameQueue();
+
   capturing = false;
 }
 
+void CameraSpinnakerImageEvent::OnImageEvent(Spinnaker::ImagePtr image) {
+  m_camera->pushImage(image);
+}
+
+void CameraSpinnaker::pushImage(Spinnaker::ImagePtr image) {
+  // Called on the Spinnaker acquisition thread. The image is only valid during
+  // the callback, so it is copied into a buffer of the frame pool.
+  try {
+    if (image == nullptr ||
+        image->GetImageStatus() != Spinnaker::IMAGE_NO_ERROR ||
+        image->IsIncomplete()) {
+      cout << "Image Acquisition Failed! Dropping incomplete image" << endl;
+      return;
+    }
+
+    QueuedFrame queued;
+    queued.timeStamp = image->GetTimeStamp();
+    queued.time = 1e-9 * image->GetTimeStamp();  // device clock in ns
+    queued.width = image->GetWidth();
+    queued.height = image->GetHeight();
+    switch (image->GetPixelFormat()) {
+      case Spinnaker::PixelFormat_Mono16:
+        queued.pixelFormat = pixelFormatMono16;
+        break;
+      case Spinnaker::PixelFormat_Mono10p:
+        queued.pixelFormat = pixelFormatMono10p;
+        break;
+      case Spinnaker::PixelFormat_Mono12p:
+        queued.pixelFormat = pixelFormatMono12p;
+        break;
+      default:
+        queued.pixelFormat = pixelFormatMono8;
+    }
+
+    size_t bits = cameraPixelFormatBits(queued.pixelFormat);
+    if (queued.pixelFormat == pixelFormatMono10p ||
+        queued.pixelFormat == pixelFormatMono12p)
+      queued.buffer = m_frame_pool.acquire(
+          1, ((size_t)queued.width * queued.height * bits + 7) / 8, CV_8U);
+    else
+      queued.buffer = m_frame_pool.acquire(queued.height, queued.width,
+                                           bits == 16 ? CV_16U : CV_8U);
+
+    // The image buffer may carry trailing chunk data
+    queued.sizeBytes =
+        std::min<size_t>(image->GetBufferSize(),
+                         queued.buffer.total() * queued.buffer.elemSize());
+    std::memcpy(queued.buffer.data, image->GetData(), queued.sizeBytes);
+
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+
+    // Queue full, drop the oldest frame
+    if (m_frame_queue.size() >= m_frame_queue_size) {
+      cout << "CameraSpinnaker: frame queue full, dropping oldest frame"
+           << endl;
+      m_frame_queue.pop_front();
+    }
+
+    m_frame_queue.push_back(queued);
+  } catch (Spinnaker::Exception& e) {
+    cout << "Error: " << e.what() << endl;
+    return;
+  }
+
+  m_frame_available.notify_one();
+}
+
+void CameraSpinnaker::clearFrameQueue() {
+  std::lock_guard<std::mutex> lock(m_queue_mutex);
+  m_frame_queue.clear();
+}
+
 CameraFrame CameraSpinnaker::getFrame() {
   CameraFrame frame;
 
+  std::unique_lock<std::mutex> lock(m_queue_mutex);
+
   // Activate software trigger
   if (triggerMode == triggerModeSoftware) {
+    // Discard stale frames so the triggered frame is returned
+    m_frame_queue.clear();
+
     try {
       if (m_cam_ptr->TriggerSoftware == NULL ||
           m_cam_ptr->TriggerSoftware.GetAccessMode() != Spinnaker::GenApi::WO) {
@@ -681,63 +805,73 @@ CameraFrame CameraSpinnaker::getFrame() {
     }
   }
 
-  // Fill in frame
-  Spinnaker::ImagePtr img_ptr = nullptr;
-
-  int attempts = 100;
-
-  if (m_camera_type == Ecamera_type::blackfly) {
-    std::this_thread::sleep_for(
-        std::chrono::microseconds((uint32_t)(m_exposure_time_micro_s + 4000)));
-  } else if (m_camera_type == Ecamera_type::grasshopper) {
-    std::this_thread::sleep_for(
-        std::chrono::microseconds((uint32_t)(m_exposure_time_micro_s + 4000)));
+  // Wait for the image event handler to deliver a frame
+  std::chrono::microseconds timeout(
+      (uint32_t)m_exposure_time_micro_s + m_frame_timeout_ms * 1000);
+  if (!m_frame_available.wait_for(lock, timeout,
+                                  [this] { return !m_frame_queue.empty(); })) {
+    cout << "Image Acquisition Failed! Timeout after "
+         << timeout.count() / 1000 << " ms" << endl;
+    return frame;
   }
 
-  for (int i = 0; i < attempts; i++) {
-    try {
-      img_ptr = m_cam_ptr->GetNextImage();
-    } catch (Spinnaker::Exception& e) {
-      cout << "Error: " << e.what() << endl;
-    }
+  popFrame(frame);
 
-    try {
-      // Check if image retrieval is successful
-      if (img_ptr != nullptr &&
-          img_ptr->GetImageStatus() == Spinnaker::IMAGE_NO_ERROR &&
-          !img_ptr->IsIncomplete()) {
-        // If so, feed all info into frame, break the loop and return the
-        // value cout << "Image Acquisition Successful!" << endl;
-        frame.timeStamp = img_ptr->GetTimeStamp();
-        frame.height = img_ptr->GetHeight();
-        frame.width = img_ptr->GetWidth();
-        frame.memory = (unsigned char*)img_ptr->GetData();
-        frame.sizeBytes = img_ptr->GetBufferSize();
-        break;
-      } else {
-        // If not, we sleep for a bit and try again
-        cout << "Image Acquisition Failed! Attempt " << i << "/" << attempts
-             << endl;
-        if (triggerMode == triggerModeSoftware) {
-          // Software trigger we can afford to sleep more before next check
-          std::this_thread::sleep_for(
-              std::chrono::microseconds((uint32_t)(m_exposure_time_micro_s)));
-        } else {
-          // Hardware trigger we can afford less sleep time
-          std::this_thread::sleep_for(
-              std::chrono::microseconds((uint32_t)(50)));
-        }
-      }
-    } catch (Spinnaker::Exception& e) {
-      cout << "Error: " << e.what() << endl;
+  return frame;
+}
+
+bool CameraSpinnaker::getFrameSequence(
+    unsigned int N, std::chrono::steady_clock::time_point deadline,
+    CameraFrameSequence& sequence) {
+  // Every frame needs its own software trigger
+  if (triggerMode == triggerModeSoftware)
+    return Camera::getFrameSequence(N, deadline, sequence);
+
+  sequence.frames.resize(N);
+  sequence.nMissing = 0;
+  sequence.startIndex = -1;
+
+  // Collect the hardware triggered frames under a single lock, the image
+  // event handler keeps filling the queue while we wait
+  std::unique_lock<std::mutex> lock(m_queue_mutex);
+  for (unsigned int i = 0; i < N; i++) {
+    if (!m_frame_available.wait_until(
+            lock, deadline, [this] { return !m_frame_queue.empty(); })) {
+      for (unsigned int j = i; j < N; j++) sequence.frames[j] = CameraFrame();
+      sequence.nMissing = N - i;
+      cout << "CameraSpinnaker: sequence deadline passed, missing "
+           << sequence.nMissing << " of " << N << " frames" << endl;
+      break;
     }
+    popFrame(sequence.frames[i]);
   }
 
-  return frame;
+  return sequence.nMissing == 0;
+}
+
+void CameraSpinnaker::popFrame(CameraFrame& frame) {
+  QueuedFrame queued = m_frame_queue.front();
+  m_frame_queue.pop_front();
+
+  // The buffer returns to the pool once the pipeline releases the frame
+  frame.timeStamp = queued.timeStamp;
+  frame.time = queued.time;
+  frame.height = queued.height;
+  frame.width = queued.width;
+  frame.memory = queued.buffer.data;
+  frame.sizeBytes = queued.sizeBytes;
+  frame.flags = 0;
+  // Mono16 is scaled to the full 16 bit range by the camera
+  frame.pixelFormat = queued.pixelFormat;
+  frame.bitDepth = cameraPixelFormatBits(queued.pixelFormat);
+  frame.buffer = queued.buffer;
 }
 
 size_t CameraSpinnaker::getFrameSizeBytes() {
-  return getFrameWidth() * getFrameHeight();
+  return (getFrameWidth() * getFrameHeight() *
+              cameraPixelFormatBits(m_pixel_format) +
+          7) /
+         8;
 }
 
 size_t CameraSpinnaker::getFrameWidth() {
@@ -2,13 +2,30 @@
 #define CameraSpinnaker_H
 
 #include "Camera.h"
+#include "CameraFramePool.h"
 #include "SpinGenApi/SpinnakerGenApi.h"
 #include "Spinnaker.h"
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
 using namespace std;
 
 enum class Ecamera_type { blackfly, grasshopper, size };
 
+class CameraSpinnaker;
+
+// Receives completed images from the Spinnaker acquisition thread
+class CameraSpinnakerImageEvent : public Spinnaker::ImageEvent {
+ public:
+  CameraSpinnakerImageEvent(CameraSpinnaker* camera) : m_camera(camera) {}
+  void OnImageEvent(Spinnaker::ImagePtr image);
+
+ private:
+  CameraSpinnaker* m_camera;
+};
+
 class CameraSpinnaker : public Camera {
  public:
   // Static methods
@@ -20,9 +37,13 @@ class CameraSpinnaker : public Camera {
   CameraSpinnaker(unsigned int camNum, CameraTriggerMode triggerMode);
   CameraSettings getCameraSettings();
   void setCameraSettings(CameraSettings);
+  bool setPixelFormat(CameraPixelFormat format);
   void startCapture();
   void stopCapture();
   CameraFrame getFrame();
+  bool getFrameSequence(unsigned int N,
+                        std::chrono::steady_clock::time_point deadline,
+                        CameraFrameSequence& sequence);
   size_t getFrameSizeBytes();
   size_t getFrameWidth();
   size_t getFrameHeight();
@@ -30,10 +51,36 @@ class CameraSpinnaker : public Camera {
   ~CameraSpinnaker();
 
  private:
+  friend class CameraSpinnakerImageEvent;
+
+  // Frame in the bounded queue, data lives in a buffer of m_frame_pool
+  struct QueuedFrame {
+    // Packed frames are stored as a single row of bytes
+    cv::Mat buffer;
+    unsigned int width, height;
+    CameraPixelFormat pixelFormat;
+    unsigned int sizeBytes;
+    unsigned int timeStamp;
+    double time;
+  };
+  void pushImage(Spinnaker::ImagePtr image);
+  void clearFrameQueue();
+  // Requires m_queue_mutex, the queue must not be empty
+  void popFrame(CameraFrame& frame);
+
+  static const size_t m_frame_queue_size = 8;
+  CameraFramePool m_frame_pool;
+  std::deque<QueuedFrame> m_frame_queue;
+  std::mutex m_queue_mutex;
+  std::condition_variable m_frame_available;
+  unsigned int m_frame_timeout_ms = 1000;
+  std::shared_ptr<CameraSpinnakerImageEvent> m_image_event = nullptr;
+
   Spinnaker::CameraPtr m_cam_ptr = nullptr;
   Spinnaker::SystemPtr m_sys_ptr = nullptr;
   Spinnaker::CameraPtr retrieveCameraPtrWithCamNum(unsigned int camNum);
   float m_exposure_time_micro_s = 0.0;
+  CameraPixelFormat m_pixel_format = pixelFormatMono8;
   Ecamera_type m_camera_type = Ecamera_type::size;
 };
 
@@ -6,12 +6,16 @@ TEMPLATE = app
 FORMS += CameraTest.ui
 
 HEADERS += Camera.h \
+        CameraFramePool.h \
+        PixelUnpack.h \
         ../SLVideoWidget.h \
         CameraWorker.h \
         CameraTest.h
 
 SOURCES += \
         Camera.cpp \
+        CameraFramePool.cpp \
+        PixelUnpack.cpp \
         ../SLVideoWidget.cpp \
         CameraWorker.cpp \
         CameraTest.cpp \
@@ -26,7 +26,7 @@ std::vector<CameraInfo> CameraXIMEA::getCameraList(){
     return ret;
 }
 
-CameraXIMEA::CameraXIMEA(unsigned int camNum, CameraTriggerMode triggerMode) : Camera(triggerMode), camera(NULL){
+CameraXIMEA::CameraXIMEA(unsigned int camNum, CameraTriggerMode triggerMode) : Camera(triggerMode), camera(NULL), frameWidth(0), frameHeight(0){
 
     // Set debugging level
     xiSetParamInt(0, XI_PRM_DEBUG_LEVEL, XI_DL_FATAL);
@@ -38,8 +38,10 @@ CameraXIMEA::CameraXIMEA(unsigned int camNum, CameraTriggerMode triggerMode) : C
     stat = xiOpenDevice(camNum, &camera);
     HandleResult(stat,"xiOpenDevice");
 
-    // Configure unsafe buffers (prevents old buffers, memory leak)
-    xiSetParamInt(camera, XI_PRM_BUFFER_POLICY, XI_BP_UNSAFE);
+    // Configure safe buffers (images are copied into our pooled frame buffers).
+    // Unsafe buffers are only valid until the next xiGetImage, which frames
+    // queued for the decoder regularly outlive.
+    xiSetParamInt(camera, XI_PRM_BUFFER_POLICY, XI_BP_SAFE);
 
 //    // Output frame signal
 //    xiSetParamInt(camera, XI_PRM_GPO_SELECTOR, 1);
@@ -134,6 +136,10 @@ void CameraXIMEA::startCapture(){
         HandleResult(stat,"xiSetParam (XI_PRM_TRG_SOURCE)");
     }
 
+    // Frame buffers are allocated with the ROI size
+    frameWidth = getFrameWidth();
+    frameHeight = getFrameHeight();
+
     // Start aquistion
     stat = xiStartAcquisition(camera);
     HandleResult(stat,"xiStartAcquisition");
@@ -153,27 +159,62 @@ void CameraXIMEA::stopCapture(){
 
 CameraFrame CameraXIMEA::getFrame(){
 
-    // Create single image buffer
-    XI_IMG image;
-    image.size = sizeof(XI_IMG); // must be initialized
-    //image.bp = NULL;
-    //image.bp_size = 0;
-
     if(triggerMode == triggerModeSoftware){
         // Fire software trigger
         stat = xiSetParamInt(camera, XI_PRM_TRG_SOFTWARE, 0);
         HandleResult(stat,"xiSetParam (XI_PRM_TRG_SOFTWARE)");
+    }
+
+    // Retrieve image from camera
+    CameraFrame frame;
+    retrieveFrame(1000, frame);
+
+    return frame;
+}
+
+bool CameraXIMEA::getFrameSequence(unsigned int N, std::chrono::steady_clock::time_point deadline, CameraFrameSequence &sequence){
+
+    // Software trigger needs one call per frame
+    if(triggerMode == triggerModeSoftware)
+        return Camera::getFrameSequence(N, deadline, sequence);
 
-        // Retrieve image from camera
-        stat = xiGetImage(camera, 1000, &image);
-        HandleResult(stat,"xiGetImage");
-    } else {
+    sequence.frames.resize(N);
+    sequence.nMissing = 0;
+    sequence.startIndex = -1;
 
-        // Retrieve image from camera
-        stat = xiGetImage(camera, 1000, &image);
-        HandleResult(stat,"xiGetImage");
+    // Frames are queued by the API, each waits at most until the deadline
+    for(unsigned int i=0; i<N; i++){
+        CameraFrame &frame = sequence.frames[i];
+        frame = CameraFrame();
+
+        long remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if(remaining <= 0 || !retrieveFrame(remaining, frame)){
+            sequence.nMissing++;
+            continue;
+        }
+
+        // GPI level marks the first pattern of the sequence
+        if(frame.flags != 0 && sequence.startIndex < 0)
+            sequence.startIndex = i;
     }
 
+    return sequence.nMissing == 0;
+}
+
+bool CameraXIMEA::retrieveFrame(unsigned int timeoutMs, CameraFrame &frame){
+
+    // Let the API deliver into a pooled frame buffer
+    cv::Mat buffer = framePool.acquire(frameHeight, frameWidth, CV_8U);
+    XI_IMG image;
+    image.size = sizeof(XI_IMG); // must be initialized
+    image.bp = buffer.data;
+    image.bp_size = buffer.total();
+
+    stat = xiGetImage(camera, timeoutMs, &image);
+    HandleResult(stat,"xiGetImage");
+    if(stat != XI_OK)
+        return false;
+
 //    // Empty buffer
 //    while(xiGetImage(camera, 1, &image) == XI_OK){
 //        std::cerr << "drop!" << std::endl;
@@ -184,15 +225,16 @@ CameraFrame CameraXIMEA::getFrame(){
     //std::cout << image.exposure_sub_times_us[3]  << std::endl << std::flush;
     //std::cout << image.GPI_level  << std::endl << std::flush;
 
-    CameraFrame frame;
     frame.height = image.height;
     frame.width = image.width;
     frame.memory = (unsigned char*)image.bp;
     frame.timeStamp = image.tsUSec;
+    frame.time = image.tsSec + 1e-6*image.tsUSec;
     frame.sizeBytes = image.bp_size;
     frame.flags = image.GPI_level;
+    frame.buffer = buffer;
 
-    return frame;
+    return true;
 }
 
 
@@ -2,6 +2,7 @@
 #define CAMERAXIMEA_H
 
 #include "Camera.h"
+#include "CameraFramePool.h"
 
 // XIMEA specific type
 typedef void* HANDLE;
@@ -17,13 +18,17 @@ class CameraXIMEA : public Camera {
         void startCapture();
         void stopCapture();
         CameraFrame getFrame();
+        bool getFrameSequence(unsigned int N, std::chrono::steady_clock::time_point deadline, CameraFrameSequence &sequence);
         size_t getFrameSizeBytes();
         size_t getFrameWidth();
         size_t getFrameHeight();
         ~CameraXIMEA();
     private:
+        bool retrieveFrame(unsigned int timeoutMs, CameraFrame &frame);
         HANDLE camera;
         int stat;
+        unsigned int frameWidth, frameHeight;
+        CameraFramePool framePool;
 };
 
 #endif // CAMERAXIMEA_H
@@ -0,0 +1,104 @@
+#include "PixelUnpack.h"
+
+// The SSSE3 kernels are compiled in on x86 even if the build does not enable
+// SSSE3, and selected at runtime
+#if defined(__SSSE3__)
+#define PIXELUNPACK_SSSE3
+#define PIXELUNPACK_SSSE3_TARGET
+#elif (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define PIXELUNPACK_SSSE3
+#define PIXELUNPACK_SSSE3_TARGET __attribute__((target("ssse3")))
+#endif
+
+#ifdef PIXELUNPACK_SSSE3
+#include <tmmintrin.h>
+#endif
+
+// Both formats are unpacked the same way: each 16 bit lane is loaded with the
+// two bytes its pixel spans, multiplied by a per lane power of two, which
+// moves the pixel's bits to the top, and masked.
+
+#ifdef PIXELUNPACK_SSSE3
+static bool hasSSSE3() {
+#ifdef __SSSE3__
+  return true;
+#else
+  static const bool supported = __builtin_cpu_supports("ssse3");
+  return supported;
+#endif
+}
+
+// Returns the number of pixels unpacked, a multiple of 8
+PIXELUNPACK_SSSE3_TARGET
+static size_t unpackMono10pSSSE3(const unsigned char *src, unsigned short *dst,
+                                 size_t n) {
+  // Lanes 4q+j of two 5 byte groups hold bytes 5q+j and 5q+j+1
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7,
+                                        8, 8, 9);
+  const __m128i multiplier = _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+  const __m128i mask = _mm_set1_epi16((short)0xFFC0);
+
+  // 8 pixels per iteration, loading 16 bytes for their 10
+  size_t i = 0;
+  for (; i + 13 <= n; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + i / 4 * 5));
+    v = _mm_shuffle_epi8(v, shuffle);
+    v = _mm_and_si128(_mm_mullo_epi16(v, multiplier), mask);
+    _mm_storeu_si128((__m128i *)(dst + i), v);
+  }
+  return i;
+}
+
+PIXELUNPACK_SSSE3_TARGET
+static size_t unpackMono12pSSSE3(const unsigned char *src, unsigned short *dst,
+                                 size_t n) {
+  // Lanes 2k and 2k+1 of a 3 byte group hold bytes 3k, 3k+1 and 3k+1, 3k+2
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9,
+                                        10, 10, 11);
+  const __m128i multiplier = _mm_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1);
+  const __m128i mask = _mm_set1_epi16((short)0xFFF0);
+
+  // 8 pixels per iteration, loading 16 bytes for their 12
+  size_t i = 0;
+  for (; i + 11 <= n; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + i / 2 * 3));
+    v = _mm_shuffle_epi8(v, shuffle);
+    v = _mm_and_si128(_mm_mullo_epi16(v, multiplier), mask);
+    _mm_storeu_si128((__m128i *)(dst + i), v);
+  }
+  return i;
+}
+#endif
+
+namespace pixelunpack {
+
+void unpackMono10p(const unsigned char *src, unsigned short *dst, size_t n) {
+  size_t i = 0;
+
+#ifdef PIXELUNPACK_SSSE3
+  if (hasSSSE3()) i = unpackMono10pSSSE3(src, dst, n);
+#endif
+
+  for (; i < n; i++) {
+    const unsigned char *b = src + i / 4 * 5 + i % 4;
+    unsigned int v = b[0] | (b[1] << 8);
+    dst[i] = (v << (6 - 2 * (i % 4))) & 0xFFC0;
+  }
+}
+
+void unpackMono12p(const unsigned char *src, unsigned short *dst, size_t n) {
+  size_t i = 0;
+
+#ifdef PIXELUNPACK_SSSE3
+  if (hasSSSE3()) i = unpackMono12pSSSE3(src, dst, n);
+#endif
+
+  for (; i < n; i++) {
+    const unsigned char *b = src + i / 2 * 3 + i % 2;
+    unsigned int v = b[0] | (b[1] << 8);
+    dst[i] = (v << (4 - 4 * (i % 2))) & 0xFFF0;
+  }
+}
+
+}  // namespace pixelunpack
@@ -0,0 +1,20 @@
+#ifndef PIXELUNPACK_H
+#define PIXELUNPACK_H
+
+#include <cstddef>
+
+// Unpackers of the GenICam packed pixel formats. Mono10p packs 4 pixels into
+// 5 bytes, Mono12p 2 pixels into 3 bytes, both LSB first and continuous
+// across rows. Pixels are unpacked MSB aligned to 16 bit, the range
+// cameraFrameToMat() delivers 16 bit frames in, such that unpacking and
+// scaling take a single pass.
+namespace pixelunpack {
+
+// Unpacks n pixels from src, which holds at least ceil(10*n/8) bytes
+void unpackMono10p(const unsigned char *src, unsigned short *dst, size_t n);
+// Unpacks n pixels from src, which holds at least ceil(12*n/8) bytes
+void unpackMono12p(const unsigned char *src, unsigned short *dst, size_t n);
+
+}  // namespace pixelunpack
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+
+// Lock-free ring buffer of preallocated slots for exactly one producer thread
+// and one consumer thread. Slots are filled and consumed in place, so pushing
+// and popping do not allocate.
+template <typename T, size_t Capacity>
+class SPSCRing {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "SPSCRing capacity must be a power of two");
+
+ public:
+  SPSCRing() : head(0), tail(0) {}
+
+  // Producer: slot to be filled, NULL if the ring is full
+  T* beginPush() {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == Capacity) return NULL;
+    return &slots[h & (Capacity - 1)];
+  }
+  // Producer: publish the slot returned by beginPush()
+  void commitPush() {
+    head.store(head.load(std::memory_order_relaxed) + 1,
+               std::memory_order_release);
+  }
+
+  // Consumer: oldest slot, NULL if the ring is empty
+  T* front() {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return NULL;
+    return &slots[t & (Capacity - 1)];
+  }
+  // Consumer: release the slot returned by front() to the producer
+  void pop() {
+    tail.store(tail.load(std::memory_order_relaxed) + 1,
+               std::memory_order_release);
+  }
+
+  size_t size() const {
+    return head.load(std::memory_order_acquire) -
+           tail.load(std::memory_order_acquire);
+  }
+
+ private:
+  T slots[Capacity];
+  // Monotonic write and read counters, on separate cache lines
+  alignas(64) std::atomic<size_t> head;
+  alignas(64) std::atomic<size_t> tail;
+};
+
+#endif
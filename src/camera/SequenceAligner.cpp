@@ -0,0 +1,180 @@
+#include "SequenceAligner.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Rate at which the offset estimate follows the measured offsets
+static const double offsetGain = 0.05;
+
+SequenceAligner::SequenceAligner(unsigned int nPatterns, double tolerance,
+                                 double offset, size_t window)
+    : nPatterns(nPatterns),
+      tolerance(tolerance),
+      offset(offset),
+      window(window) {
+  reset();
+}
+
+void SequenceAligner::reset() {
+  triggers.clear();
+  frames.clear();
+  nextSequenceId = 0;
+  lastPatternIndex = -1;
+  hasCurrent = false;
+  droppedSequenceId = -1;
+  completed.clear();
+  offsets.clear();
+  stats = Statistics();
+}
+
+void SequenceAligner::addTrigger(double time, unsigned int patternIndex) {
+  if ((int)patternIndex <= lastPatternIndex) nextSequenceId++;
+  lastPatternIndex = patternIndex;
+
+  Trigger trigger;
+  trigger.time = time;
+  trigger.patternIndex = patternIndex;
+  trigger.sequenceId = nextSequenceId;
+  triggers.push_back(trigger);
+
+  match();
+}
+
+void SequenceAligner::addFrame(double time, const cv::Mat &image) {
+  Frame frame;
+  frame.time = time;
+  frame.image = image;
+  frames.push_back(frame);
+
+  match();
+}
+
+void SequenceAligner::match() {
+  while (!triggers.empty() && !frames.empty()) {
+    const Trigger &trigger = triggers.front();
+    double d = frames[0].time - (trigger.time + offset);
+
+    // Frame precedes the oldest trigger, no later trigger can match it
+    if (d < -tolerance) {
+      stats.nUnmatchedFrames++;
+      frames.pop_front();
+      continue;
+    }
+
+    // No frame for this trigger, later frames are even further away
+    if (d > tolerance) {
+      stats.nMissedTriggers++;
+      dropSequence(trigger.sequenceId);
+      triggers.pop_front();
+      continue;
+    }
+
+    // The next frame may match better (jitter close to the tolerance)
+    if (frames.size() > 1) {
+      double dNext = frames[1].time - (trigger.time + offset);
+      if (std::abs(dNext) < std::abs(d)) {
+        stats.nUnmatchedFrames++;
+        frames.pop_front();
+        continue;
+      }
+    }
+
+    // Track the offset for drift compensation and statistics
+    offset += offsetGain * d;
+    offsets.push_back(
+        std::make_pair(trigger.time, frames[0].time - trigger.time));
+    if (offsets.size() > window) offsets.pop_front();
+
+    assign(trigger, frames[0].image);
+    triggers.pop_front();
+    frames.pop_front();
+  }
+
+  // Bound the window if one of the streams stalls
+  while (triggers.size() > window) {
+    stats.nMissedTriggers++;
+    dropSequence(triggers.front().sequenceId);
+    triggers.pop_front();
+  }
+  while (frames.size() > window) {
+    stats.nUnmatchedFrames++;
+    frames.pop_front();
+  }
+}
+
+void SequenceAligner::assign(const Trigger &trigger, const cv::Mat &image) {
+  if ((long)trigger.sequenceId == droppedSequenceId) return;
+
+  if (hasCurrent && current.id != trigger.sequenceId) {
+    // Previous sequence did not receive all of its frames
+    stats.nDroppedSequences++;
+    hasCurrent = false;
+  }
+
+  if (!hasCurrent) {
+    current.id = trigger.sequenceId;
+    current.startTime = trigger.time;
+    current.frames.assign(nPatterns, cv::Mat());
+    current.nFilled = 0;
+    hasCurrent = true;
+  }
+
+  if (trigger.patternIndex >= nPatterns) return;
+
+  if (current.frames[trigger.patternIndex].empty()) current.nFilled++;
+  current.frames[trigger.patternIndex] = image;
+
+  if (current.nFilled == nPatterns) {
+    completed.push_back(current);
+    stats.nSequences++;
+    hasCurrent = false;
+  }
+}
+
+void SequenceAligner::dropSequence(unsigned long sequenceId) {
+  if ((long)sequenceId == droppedSequenceId) return;
+
+  droppedSequenceId = sequenceId;
+  stats.nDroppedSequences++;
+  if (hasCurrent && current.id == sequenceId) hasCurrent = false;
+}
+
+bool SequenceAligner::popSequence(std::vector<cv::Mat> &frameSeq,
+                                  double *startTime) {
+  if (completed.empty()) return false;
+
+  frameSeq = completed.front().frames;
+  if (startTime) *startTime = completed.front().startTime;
+  completed.pop_front();
+
+  return true;
+}
+
+SequenceAligner::Statistics SequenceAligner::getStatistics() const {
+  Statistics ret = stats;
+
+  size_t n = offsets.size();
+  if (n == 0) return ret;
+
+  // Mean and standard deviation of the offset, least squares slope for drift
+  double t0 = offsets.front().first;
+  double sumT = 0, sumO = 0, sumTT = 0, sumTO = 0, sumOO = 0;
+  for (size_t i = 0; i < n; i++) {
+    double t = offsets[i].first - t0;
+    double o = offsets[i].second;
+    sumT += t;
+    sumO += o;
+    sumTT += t * t;
+    sumTO += t * o;
+    sumOO += o * o;
+  }
+
+  ret.meanOffset = sumO / n;
+  ret.stdOffset = std::sqrt(
+      std::max(0.0, sumOO / n - ret.meanOffset * ret.meanOffset));
+
+  double denom = n * sumTT - sumT * sumT;
+  if (n > 1 && denom > 0.0) ret.drift = (n * sumTO - sumT * sumO) / denom;
+
+  return ret;
+}
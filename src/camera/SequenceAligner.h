@@ -0,0 +1,91 @@
+#ifndef SEQUENCEALIGNER_H
+#define SEQUENCEALIGNER_H
+
+#include <deque>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// Associates projector trigger timestamps with camera frame timestamps and
+// assembles complete pattern sequences, ordered by pattern index.
+// Both streams must use the same clock and arrive in time order, but not in
+// lockstep. Pending triggers and frames are kept in a sliding window until
+// they can be matched. The trigger-to-frame offset is tracked, such that slow
+// clock drift does not break the association.
+class SequenceAligner {
+ public:
+  struct Statistics {
+    unsigned int nSequences;         // complete sequences assembled
+    unsigned int nDroppedSequences;  // sequences with missing frames
+    unsigned int nUnmatchedFrames;   // frames without a trigger
+    unsigned int nMissedTriggers;    // triggers without a frame
+    double meanOffset;  // [s] mean frame time minus trigger time
+    double stdOffset;   // [s] standard deviation of the offset
+    double drift;       // [s/s] slope of the offset over trigger time
+    Statistics()
+        : nSequences(0),
+          nDroppedSequences(0),
+          nUnmatchedFrames(0),
+          nMissedTriggers(0),
+          meanOffset(0.0),
+          stdOffset(0.0),
+          drift(0.0) {}
+  };
+
+  // tolerance [s] should be below half the frame period. offset [s] is the
+  // nominal frame time minus trigger time. window bounds the number of
+  // pending triggers/frames and the offsets used for statistics.
+  SequenceAligner(unsigned int nPatterns, double tolerance,
+                  double offset = 0.0, size_t window = 256);
+  // Trigger for pattern patternIndex. A new sequence starts when the pattern
+  // index does not increase.
+  void addTrigger(double time, unsigned int patternIndex);
+  void addFrame(double time, const cv::Mat &frame);
+  // Oldest complete sequence, frameSeq[i] shows pattern i
+  bool popSequence(std::vector<cv::Mat> &frameSeq, double *startTime = NULL);
+  Statistics getStatistics() const;
+  void reset();
+
+ private:
+  struct Trigger {
+    double time;
+    unsigned int patternIndex;
+    unsigned long sequenceId;
+  };
+  struct Frame {
+    double time;
+    cv::Mat image;
+  };
+  struct Sequence {
+    unsigned long id;
+    double startTime;
+    std::vector<cv::Mat> frames;
+    unsigned int nFilled;
+  };
+
+  void match();
+  void assign(const Trigger &trigger, const cv::Mat &image);
+  void dropSequence(unsigned long sequenceId);
+
+  unsigned int nPatterns;
+  double tolerance;
+  double offset;
+  size_t window;
+
+  std::deque<Trigger> triggers;
+  std::deque<Frame> frames;
+  unsigned long nextSequenceId;
+  int lastPatternIndex;
+
+  bool hasCurrent;
+  Sequence current;
+  // Frames of this sequence are discarded after a missed trigger
+  long droppedSequenceId;
+  std::deque<Sequence> completed;
+
+  // (trigger time, frame time - trigger time) of recent matches
+  std::deque<std::pair<double, double> > offsets;
+  Statistics stats;
+};
+
+#endif
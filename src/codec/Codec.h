@@ -9,6 +9,22 @@ enum CodecDir {CodecDirNone = 0,
                CodecDirVertical = 1 << 1,
                CodecDirBoth = CodecDirHorizontal | CodecDirVertical};
 
+// Procedural description of an encoding pattern, such that a projector can render it directly
+// instead of uploading a precomputed texture. The intensity in [0, 1] is a function of the pattern
+// coordinate x along dir, in units of the encoder's screenCols/screenRows.
+enum PatternType {PatternTypeConstant = 0,  // offset
+                  PatternTypeSinusoid = 1,  // offset + amplitude*cos(2*pi*x/pitch - phase)
+                  PatternTypeGrayCode = 2}; // bit 'bit' of the Gray code of column/row x
+
+struct PatternDescriptor {
+    PatternType type;
+    CodecDir dir;
+    float offset, amplitude;
+    float pitch, phase;
+    unsigned int bit;
+    PatternDescriptor() : type(PatternTypeConstant), dir(CodecDirHorizontal), offset(0.0), amplitude(0.0), pitch(1.0), phase(0.0), bit(0){}
+};
+
 // Base class for all encoders
 class Encoder {
     public:
@@ -17,6 +33,8 @@ class Encoder {
         CodecDir getDir(){return dir;}
         // Encoding
         virtual cv::Mat getEncodingPattern(unsigned int depth) = 0;
+        // Procedural description of pattern depth, false if there is none
+        virtual bool getPatternDescriptor(unsigned int /*depth*/, PatternDescriptor &/*pattern*/){return false;}
         virtual ~Encoder(){}
     protected:
         unsigned int N;
@@ -31,6 +49,8 @@ class Decoder {
         CodecDir getDir(){return dir;}
         // Decoding
         virtual void setFrame(unsigned int depth, const cv::Mat frame) = 0;
+        // Whether frames of the given depth (CV_8U, CV_16U) can be set. Callers convert other frames to CV_8U.
+        virtual bool supportsFrameDepth(int depth){return depth == CV_8U;}
         virtual void decodeFrames(cv::Mat &up, cv::Mat &vp, cv::Mat &mask, cv::Mat &shading) = 0;
         virtual ~Decoder(){}
     protected:
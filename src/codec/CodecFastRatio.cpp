@@ -72,12 +72,15 @@ void DecoderFastRatio::decodeFrames(cv::Mat &up, cv::Mat &vp, cv::Mat &mask, cv:
 //    cv::bilateralFilter(upCopy, up, 7, 500, 400);
     cv::GaussianBlur(up, up, cv::Size(0,0), 3, 3);
 
-    shading = frames[1];
+    // Thresholds are on the 16 bit scale, shading is returned on the 8 bit scale
+    cv::Mat shading16;
+    frames[1].convertTo(shading16, CV_16U, (frames[1].depth() == CV_16U) ? 1.0 : 257.0);
+    shading16.convertTo(shading, CV_8U, 1.0/257.0);
 
     // Create mask from modulation image and erode
     mask.create(shading.size(), cv::DataType<bool>::type);
 //    mask.setTo(true);
-    mask = (shading > 10000) & (shading < 65000) & (up <= screenCols) & (up >= 0);
+    mask = (shading16 > 10000) & (shading16 < 65000) & (up <= screenCols) & (up >= 0);
 
 //    cv::Mat edges;
 //    cv::Sobel(up, edges, -1, 1, 1, 7);
@@ -140,6 +140,33 @@ cv::Mat EncoderGrayCode::getEncodingPattern(unsigned int depth){
     return patterns[depth];
 }
 
+bool EncoderGrayCode::getPatternDescriptor(unsigned int depth, PatternDescriptor &pattern){
+
+    if(depth >= N)
+        return false;
+
+    // All on and all off patterns
+    if(depth < 2){
+        pattern.type = PatternTypeConstant;
+        pattern.offset = (depth == 0) ? 1.0 : 0.0;
+        return true;
+    }
+
+    unsigned int p = depth-2;
+    pattern.type = PatternTypeGrayCode;
+    if((dir & CodecDirHorizontal) && p < Nhorz){
+        pattern.dir = CodecDirHorizontal;
+        pattern.bit = ceilf(log2f((float)screenCols)) - p - 1;
+    } else {
+        if(dir & CodecDirHorizontal)
+            p -= Nhorz;
+        pattern.dir = CodecDirVertical;
+        pattern.bit = ceilf(log2f((float)screenRows)) - p - 1;
+    }
+
+    return true;
+}
+
 // Decoder
 DecoderGrayCode::DecoderGrayCode(unsigned int _screenCols, unsigned int _screenRows, CodecDir _dir) : Decoder(_screenCols, _screenRows, _dir){
 
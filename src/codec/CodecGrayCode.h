@@ -8,6 +8,7 @@ class EncoderGrayCode : public Encoder {
         EncoderGrayCode(unsigned int _screenCols, unsigned int _screenRows, CodecDir _dir);
         // Encoding
         cv::Mat getEncodingPattern(unsigned int depth);
+        bool getPatternDescriptor(unsigned int depth, PatternDescriptor &pattern);
     private:
         std::vector<cv::Mat> patterns;
 };
@@ -17,6 +17,7 @@ class DecoderPhaseShift2x3 : public Decoder {
         DecoderPhaseShift2x3(unsigned int _screenCols, unsigned int _screenRows, CodecDir _dir);
         // Decoding
         void setFrame(unsigned int depth, cv::Mat frame);
+        bool supportsFrameDepth(int depth){return depth == CV_8U || depth == CV_16U;}
         void decodeFrames(cv::Mat &up, cv::Mat &vp, cv::Mat &mask, cv::Mat &shading);
     private:
         std::vector<cv::Mat> frames;
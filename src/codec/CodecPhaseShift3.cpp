@@ -53,6 +53,21 @@ cv::Mat EncoderPhaseShift3::getEncodingPattern(unsigned int depth){
     return patterns[depth];
 }
 
+bool EncoderPhaseShift3::getPatternDescriptor(unsigned int depth, PatternDescriptor &pattern){
+
+    if(depth >= N)
+        return false;
+
+    pattern.type = PatternTypeSinusoid;
+    pattern.dir = CodecDirHorizontal;
+    pattern.offset = 0.5;
+    pattern.amplitude = 0.5;
+    pattern.pitch = screenCols;
+    pattern.phase = 2.0*M_PI/float(N) * depth;
+
+    return true;
+}
+
 // Decoder
 DecoderPhaseShift3::DecoderPhaseShift3(unsigned int _screenCols, unsigned int _screenRows, CodecDir _dir) : Decoder(_screenCols, _screenRows){
     N = 3;
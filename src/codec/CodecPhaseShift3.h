@@ -8,6 +8,7 @@ class EncoderPhaseShift3 : public Encoder {
         EncoderPhaseShift3(unsigned int _screenCols, unsigned int _screenRows, CodecDir _dir);
         // Encoding
         cv::Mat getEncodingPattern(unsigned int depth);
+        bool getPatternDescriptor(unsigned int depth, PatternDescriptor &pattern);
     private:
         std::vector<cv::Mat> patterns;
 };
@@ -17,6 +18,7 @@ class DecoderPhaseShift3 : public Decoder {
         DecoderPhaseShift3(unsigned int _screenCols, unsigned int _screenRows, CodecDir _dir);
         // Decoding
         void setFrame(unsigned int depth, cv::Mat frame);
+        bool supportsFrameDepth(int depth){return depth == CV_8U || depth == CV_16U;}
         void decodeFrames(cv::Mat &up, cv::Mat &vp, cv::Mat &mask, cv::Mat &shading);
     private:
         std::vector<cv::Mat> frames;
@@ -77,6 +77,32 @@ cv::Mat EncoderPhaseShiftNStep::getEncodingPattern(unsigned int depth){
     return patterns[depth];
 }
 
+bool EncoderPhaseShiftNStep::getPatternDescriptor(unsigned int depth, PatternDescriptor &pattern){
+
+    if(depth >= N)
+        return false;
+
+    // nSteps phase shifts followed by 3 phase cue patterns per direction
+    unsigned int nPerDir = nSteps+3;
+    pattern.dir = ((dir & CodecDirHorizontal) && depth < nPerDir) ? CodecDirHorizontal : CodecDirVertical;
+    float length = (pattern.dir == CodecDirHorizontal) ? screenCols : screenRows;
+    unsigned int i = depth % nPerDir;
+
+    // As in pstools::computePhaseVector()
+    pattern.type = PatternTypeSinusoid;
+    pattern.offset = 0.6;
+    pattern.amplitude = 0.4;
+    if(i < nSteps){
+        pattern.phase = 2.0*M_PI/nSteps * i;
+        pattern.pitch = length/(float)nPhases;
+    } else {
+        pattern.phase = 2.0*M_PI/3.0 * (i-nSteps);
+        pattern.pitch = length;
+    }
+
+    return true;
+}
+
 // Decoder
 DecoderPhaseShiftNStep::DecoderPhaseShiftNStep(unsigned int _screenCols, unsigned int _screenRows, CodecDir _dir) : Decoder(_screenCols, _screenRows, _dir){
 
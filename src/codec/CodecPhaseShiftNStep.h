@@ -10,6 +10,7 @@ class EncoderPhaseShiftNStep : public Encoder {
         EncoderPhaseShiftNStep(unsigned int _screenCols, unsigned int _screenRows, CodecDir _dir);
         // Encoding
         cv::Mat getEncodingPattern(unsigned int depth);
+        bool getPatternDescriptor(unsigned int depth, PatternDescriptor &pattern);
     private:
         std::vector<cv::Mat> patterns;
 };
@@ -19,6 +20,7 @@ class DecoderPhaseShiftNStep : public Decoder {
         DecoderPhaseShiftNStep(unsigned int _screenCols, unsigned int _screenRows, CodecDir _dir);
         // Decoding
         void setFrame(unsigned int depth, cv::Mat frame);
+        bool supportsFrameDepth(int depth){return depth == CV_8U || depth == CV_16U;}
         void decodeFrames(cv::Mat &up, cv::Mat &vp, cv::Mat &mask, cv::Mat &shading);
     private:
         std::vector<cv::Mat> frames;
@@ -0,0 +1,171 @@
+#include "PatternCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Disk cache file format: magic, version, key, number of patterns, then rows,
+// cols, type and raw data of each pattern
+static const char fileMagic[4] = {'S', 'L', 'P', 'C'};
+static const int fileVersion = 1;
+
+static size_t sequenceBytes(const std::vector<cv::Mat> &patterns) {
+  size_t bytes = 0;
+  for (unsigned int i = 0; i < patterns.size(); i++)
+    bytes += patterns[i].total() * patterns[i].elemSize();
+  return bytes;
+}
+
+std::string PatternCache::Key::toString() const {
+  std::stringstream ss;
+  ss << codec << "_" << screenCols << "x" << screenRows << "_dir" << (int)dir
+     << (diamond ? "_diamond" : "") << "_" << std::hex << calibrationHash;
+  return ss.str();
+}
+
+PatternCache &PatternCache::shared() {
+  static PatternCache cache;
+  return cache;
+}
+
+unsigned long long PatternCache::hashCalibration(const cv::Matx33f &Kp,
+                                                 const cv::Vec<float, 5> &kp) {
+  // FNV-1a over the parameter bytes
+  unsigned long long hash = 14695981039346656037ULL;
+  const unsigned char *bytes[2] = {(const unsigned char *)Kp.val,
+                                   (const unsigned char *)kp.val};
+  const size_t sizes[2] = {sizeof(Kp.val), sizeof(kp.val)};
+  for (int i = 0; i < 2; i++) {
+    for (size_t j = 0; j < sizes[i]; j++) {
+      hash ^= bytes[i][j];
+      hash *= 1099511628211ULL;
+    }
+  }
+  return hash;
+}
+
+std::vector<cv::Mat> PatternCache::get(
+    const Key &key, std::function<std::vector<cv::Mat>()> generate) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  std::string keyString = key.toString();
+
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    if (it->first == keyString) {
+      entries.splice(entries.begin(), entries, it);
+      return entries.front().second;
+    }
+  }
+
+  std::vector<cv::Mat> patterns;
+  if (!readFromDisk(keyString, patterns)) {
+    patterns = generate();
+    if (patterns.empty()) return patterns;
+    writeToDisk(keyString, patterns);
+  }
+
+  entries.push_front(std::make_pair(keyString, patterns));
+  bytes += sequenceBytes(patterns);
+  while (bytes > maxBytes && entries.size() > 1) {
+    bytes -= sequenceBytes(entries.back().second);
+    entries.pop_back();
+  }
+
+  return patterns;
+}
+
+void PatternCache::setDiskCacheDir(const std::string &dir) {
+  std::lock_guard<std::mutex> lock(mutex);
+  diskCacheDir = dir;
+}
+
+void PatternCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  entries.clear();
+  bytes = 0;
+}
+
+bool PatternCache::readFromDisk(const std::string &key,
+                                std::vector<cv::Mat> &patterns) {
+  if (diskCacheDir.empty()) return false;
+
+  std::ifstream file((diskCacheDir + "/" + key + ".patterns").c_str(),
+                     std::ios::binary);
+  if (!file.is_open()) return false;
+
+  char magic[4];
+  int version = 0;
+  file.read(magic, sizeof(magic));
+  file.read((char *)&version, sizeof(version));
+  if (!file || std::memcmp(magic, fileMagic, sizeof(magic)) != 0 ||
+      version != fileVersion)
+    return false;
+
+  // Guards against file name collisions
+  unsigned int keyLength = 0;
+  file.read((char *)&keyLength, sizeof(keyLength));
+  std::string fileKey(keyLength, '\0');
+  if (keyLength > 0) file.read(&fileKey[0], keyLength);
+  if (!file || fileKey != key) return false;
+
+  unsigned int n = 0;
+  file.read((char *)&n, sizeof(n));
+  if (n == 0) return false;
+
+  std::vector<cv::Mat> ret(n);
+  for (unsigned int i = 0; i < n && file; i++) {
+    int header[3];
+    file.read((char *)header, sizeof(header));
+    if (!file) break;
+    ret[i].create(header[0], header[1], header[2]);
+    file.read((char *)ret[i].data, ret[i].total() * ret[i].elemSize());
+  }
+
+  if (!file) {
+    std::cerr << "PatternCache: could not read cached patterns " << key
+              << std::endl;
+    return false;
+  }
+
+  patterns = ret;
+  return true;
+}
+
+void PatternCache::writeToDisk(const std::string &key,
+                               const std::vector<cv::Mat> &patterns) {
+  if (diskCacheDir.empty()) return;
+
+  // Write to a temporary file first, such that readers never see partial files
+  std::string fileName = diskCacheDir + "/" + key + ".patterns";
+  std::string tmpFileName = fileName + ".tmp";
+
+  std::ofstream file(tmpFileName.c_str(), std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "PatternCache: could not write " << tmpFileName << std::endl;
+    return;
+  }
+
+  file.write(fileMagic, sizeof(fileMagic));
+  file.write((const char *)&fileVersion, sizeof(fileVersion));
+  unsigned int keyLength = key.size();
+  file.write((const char *)&keyLength, sizeof(keyLength));
+  file.write(key.data(), keyLength);
+
+  unsigned int n = patterns.size();
+  file.write((const char *)&n, sizeof(n));
+  for (unsigned int i = 0; i < n; i++) {
+    cv::Mat pattern =
+        patterns[i].isContinuous() ? patterns[i] : patterns[i].clone();
+    int header[3] = {pattern.rows, pattern.cols, pattern.type()};
+    file.write((const char *)header, sizeof(header));
+    file.write((const char *)pattern.data, pattern.total() * pattern.elemSize());
+  }
+  file.close();
+
+  if (!file || std::rename(tmpFileName.c_str(), fileName.c_str()) != 0) {
+    std::cerr << "PatternCache: could not write " << fileName << std::endl;
+    std::remove(tmpFileName.c_str());
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef PATTERNCACHE_H
+#define PATTERNCACHE_H
+
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "Codec.h"
+
+// Cache of full resolution pattern sequences, such that restarting a scan does
+// not regenerate and distortion correct every pattern. Sequences are kept in
+// memory and optionally in a disk directory, which survives restarts of the
+// application. Cached cv::Mat are shared and must not be modified.
+class PatternCache {
+ public:
+  struct Key {
+    std::string codec;
+    unsigned int screenCols, screenRows;
+    CodecDir dir;
+    bool diamond;
+    // hashCalibration() of the lens correction applied, 0 if none
+    unsigned long long calibrationHash;
+    Key()
+        : screenCols(0),
+          screenRows(0),
+          dir(CodecDirNone),
+          diamond(false),
+          calibrationHash(0) {}
+    std::string toString() const;
+  };
+
+  // Instance shared by all encoder consumers and the projector upload
+  static PatternCache &shared();
+
+  // Keeps sequences up to maxBytes in memory, but always the most recent one.
+  // A 1080p color sequence takes 6 MB per pattern.
+  PatternCache(size_t maxBytes = 128 << 20) : maxBytes(maxBytes), bytes(0) {}
+  // Cached sequence for key. On a miss, the sequence is generated, stored in
+  // memory and written to the disk cache. Empty sequences, e.g. of an invalid
+  // codec, are not cached.
+  std::vector<cv::Mat> get(const Key &key,
+                           std::function<std::vector<cv::Mat>()> generate);
+  // Empty directory disables the disk cache
+  void setDiskCacheDir(const std::string &dir);
+  void clear();
+
+  static unsigned long long hashCalibration(const cv::Matx33f &Kp,
+                                            const cv::Vec<float, 5> &kp);
+
+ private:
+  bool readFromDisk(const std::string &key, std::vector<cv::Mat> &patterns);
+  void writeToDisk(const std::string &key,
+                   const std::vector<cv::Mat> &patterns);
+
+  std::mutex mutex;
+  // Most recently used first
+  std::list<std::pair<std::string, std::vector<cv::Mat> > > entries;
+  size_t maxBytes;
+  // Memory held by entries
+  size_t bytes;
+  std::string diskCacheDir;
+};
+
+#endif
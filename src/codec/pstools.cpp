@@ -1,9 +1,151 @@
 #include "pstools.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #ifndef M_PI
 #define M_PI 3.14159265359
 #endif
 
+static const float sqrt3 = 1.7320508f;
+
+// Scale of frame intensities to the 8 bit range. 16 bit frames span the full
+// 16 bit range.
+static double intensityScale(int depth) {
+  return (depth == CV_16U) ? 1.0 / 257.0 : 1.0;
+}
+
+#ifdef __SSE2__
+// dst[0..3] = scale * v
+static inline void storeScaled(__m128i v, __m128 scale, float *dst) {
+  _mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+}
+
+// Sign extends the low/high four 16 bit integers to 32 bit
+static inline __m128i lowToInt32(__m128i v) {
+  return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+}
+static inline __m128i highToInt32(__m128i v) {
+  return _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+}
+#endif
+
+// Quadrature components of three frames shifted by 2pi/3 along a row,
+// x = 2*I1 - I2 - I3 and y = sqrt(3)*(I2 - I3), scaled by scale. The
+// differences are formed exactly in the integer domain.
+static void quadratureRow(const uchar *I1, const uchar *I2, const uchar *I3,
+                          int n, float scale, float *x, float *y) {
+  int i = 0;
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 xScale = _mm_set1_ps(scale);
+  const __m128 yScale = _mm_set1_ps(scale * sqrt3);
+  for (; i + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(I1 + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(I2 + i));
+    __m128i c = _mm_loadu_si128((const __m128i *)(I3 + i));
+
+    // |x| <= 510 and |y| <= 255 fit into 16 bits
+    __m128i a16[2] = {_mm_unpacklo_epi8(a, zero), _mm_unpackhi_epi8(a, zero)};
+    __m128i b16[2] = {_mm_unpacklo_epi8(b, zero), _mm_unpackhi_epi8(b, zero)};
+    __m128i c16[2] = {_mm_unpacklo_epi8(c, zero), _mm_unpackhi_epi8(c, zero)};
+    for (int h = 0; h < 2; h++) {
+      __m128i x16 = _mm_sub_epi16(_mm_add_epi16(a16[h], a16[h]),
+                                  _mm_add_epi16(b16[h], c16[h]));
+      __m128i y16 = _mm_sub_epi16(b16[h], c16[h]);
+      storeScaled(lowToInt32(x16), xScale, x + i + 8 * h);
+      storeScaled(highToInt32(x16), xScale, x + i + 8 * h + 4);
+      storeScaled(lowToInt32(y16), yScale, y + i + 8 * h);
+      storeScaled(highToInt32(y16), yScale, y + i + 8 * h + 4);
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    x[i] = scale * (2 * I1[i] - I2[i] - I3[i]);
+    y[i] = scale * sqrt3 * (I2[i] - I3[i]);
+  }
+}
+
+static void quadratureRow(const ushort *I1, const ushort *I2, const ushort *I3,
+                          int n, float scale, float *x, float *y) {
+  int i = 0;
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 xScale = _mm_set1_ps(scale);
+  const __m128 yScale = _mm_set1_ps(scale * sqrt3);
+  for (; i + 8 <= n; i += 8) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(I1 + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(I2 + i));
+    __m128i c = _mm_loadu_si128((const __m128i *)(I3 + i));
+
+    // 32 bit differences
+    __m128i a32[2] = {_mm_unpacklo_epi16(a, zero), _mm_unpackhi_epi16(a, zero)};
+    __m128i b32[2] = {_mm_unpacklo_epi16(b, zero), _mm_unpackhi_epi16(b, zero)};
+    __m128i c32[2] = {_mm_unpacklo_epi16(c, zero), _mm_unpackhi_epi16(c, zero)};
+    for (int h = 0; h < 2; h++) {
+      __m128i x32 = _mm_sub_epi32(_mm_add_epi32(a32[h], a32[h]),
+                                  _mm_add_epi32(b32[h], c32[h]));
+      __m128i y32 = _mm_sub_epi32(b32[h], c32[h]);
+      storeScaled(x32, xScale, x + i + 4 * h);
+      storeScaled(y32, yScale, y + i + 4 * h);
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    x[i] = scale * (2 * I1[i] - I2[i] - I3[i]);
+    y[i] = scale * sqrt3 * (I2[i] - I3[i]);
+  }
+}
+
+// Phase and/or magnitude of three CV_8U or CV_16U frames, row by row
+class QuadratureBody : public cv::ParallelLoopBody {
+ public:
+  QuadratureBody(const cv::Mat &I1, const cv::Mat &I2, const cv::Mat &I3,
+                 cv::Mat *phase, cv::Mat *magnitude)
+      : I1(I1), I2(I2), I3(I3), phase(phase), magnitude(magnitude) {}
+
+  void operator()(const cv::Range &range) const {
+    int cols = I1.cols;
+    float scale = intensityScale(I1.depth());
+    cv::Mat x(1, cols, CV_32F), y(1, cols, CV_32F), m(1, cols, CV_32F);
+
+    for (int r = range.start; r < range.end; r++) {
+      if (I1.depth() == CV_16U)
+        quadratureRow(I1.ptr<ushort>(r), I2.ptr<ushort>(r), I3.ptr<ushort>(r),
+                      cols, scale, x.ptr<float>(), y.ptr<float>());
+      else
+        quadratureRow(I1.ptr<uchar>(r), I2.ptr<uchar>(r), I3.ptr<uchar>(r),
+                      cols, scale, x.ptr<float>(), y.ptr<float>());
+
+      if (phase) {
+        cv::Mat phaseRow = phase->row(r);
+        cv::phase(x, y, phaseRow);
+      }
+      if (magnitude) {
+        cv::magnitude(x, y, m);
+        cv::Mat magnitudeRow = magnitude->row(r);
+        m.convertTo(magnitudeRow, CV_8U);
+      }
+    }
+  }
+
+ private:
+  const cv::Mat &I1, &I2, &I3;
+  cv::Mat *phase, *magnitude;
+};
+
+static bool hasIntegerKernel(const cv::Mat &I1, const cv::Mat &I2,
+                             const cv::Mat &I3) {
+  return (I1.type() == CV_8UC1 || I1.type() == CV_16UC1) &&
+         I2.type() == I1.type() && I3.type() == I1.type() &&
+         I2.size() == I1.size() && I3.size() == I1.size();
+}
+
 namespace pstools {
 
 // Cosine function vector (3-channel)
@@ -28,6 +170,13 @@ cv::Mat computePhaseVector(unsigned int length, float phase, float pitch) {
 
 // Absolute phase from 3 frames
 cv::Mat getPhase(const cv::Mat I1, const cv::Mat I2, const cv::Mat I3) {
+  if (hasIntegerKernel(I1, I2, I3)) {
+    cv::Mat phase(I1.size(), CV_32F);
+    cv::parallel_for_(cv::Range(0, I1.rows),
+                      QuadratureBody(I1, I2, I3, &phase, NULL));
+    return phase;
+  }
+
   cv::Mat_<float> I1_(I1);
   cv::Mat_<float> I2_(I2);
   cv::Mat_<float> I3_(I3);
@@ -41,6 +190,13 @@ cv::Mat getPhase(const cv::Mat I1, const cv::Mat I2, const cv::Mat I3) {
 
 // Absolute magnitude from 3 frames
 cv::Mat getMagnitude(const cv::Mat I1, const cv::Mat I2, const cv::Mat I3) {
+  if (hasIntegerKernel(I1, I2, I3)) {
+    cv::Mat magnitude(I1.size(), CV_8U);
+    cv::parallel_for_(cv::Range(0, I1.rows),
+                      QuadratureBody(I1, I2, I3, NULL, &magnitude));
+    return magnitude;
+  }
+
   cv::Mat_<float> I1_(I1);
   cv::Mat_<float> I2_(I2);
   cv::Mat_<float> I3_(I3);
@@ -67,7 +223,7 @@ std::vector<cv::Mat> getDFTComponents(const std::vector<cv::Mat> frames) {
   unsigned int w = I.cols;
   unsigned int h = I.rows;
   I = I.reshape(1, h * w);
-  I.convertTo(I, CV_32F);
+  I.convertTo(I, CV_32F, intensityScale(I.depth()));
   cv::Mat fI;
   cv::dft(I, fI, cv::DFT_ROWS + cv::DFT_COMPLEX_OUTPUT);
   fI = fI.reshape(N * 2, h);
@@ -9,6 +9,8 @@ namespace pstools {
 
     cv::Mat computePhaseVector(unsigned int length, float phase, float pitch);
     cv::Mat computePhaseVectorDithered(unsigned int length, float phase, float pitch);
+    // CV_8U and CV_16U frames are decoded by vectorized integer kernels. The
+    // magnitude and DFT components of 16 bit frames are on the 8 bit scale.
     cv::Mat getPhase(const cv::Mat I1, const cv::Mat I2, const cv::Mat I3);
     cv::Mat getMagnitude(const cv::Mat I1, const cv::Mat I2, const cv::Mat I3);
     std::vector<cv::Mat> getDFTComponents(const std::vector<cv::Mat> frames);
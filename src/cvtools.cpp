@@ -6,6 +6,10 @@
 
 #include <stdio.h>
 
+#include <map>
+#include <mutex>
+#include <vector>
+
 namespace cvtools
 {
 // Phase correlation image registration including scale, rotation and translational shift
@@ -63,51 +67,118 @@ cv::Mat logPolar(const cv::Mat &image, float scale)
 // Forward distortion of points. The inverse of the undistortion in cv::initUndistortRectifyMap().
 // Inspired by Pascal Thomet, http://code.opencv.org/issues/1387#note-11
 // Convention for distortion parameters: http://www.vision.caltech.edu/bouguetj/calib_doc/htmls/parameters.html
-void initDistortMap(const cv::Matx33f cameraMatrix, const cv::Vec<float, 5> distCoeffs, const cv::Size size,
-                    cv::Mat &map1, cv::Mat &map2)
+// Pre-distortion maps for a range of rows. Rows are computed in float, such
+// that the inner loop vectorizes, and converted to fixed point if requested.
+class DistortMapBody : public cv::ParallelLoopBody
 {
-  float fx = cameraMatrix(0, 0);
-  float fy = cameraMatrix(1, 1);
-  float ux = cameraMatrix(0, 2);
-  float uy = cameraMatrix(1, 2);
-
-  float k1 = distCoeffs[0];
-  float k2 = distCoeffs[1];
-  float p1 = distCoeffs[2];
-  float p2 = distCoeffs[3];
-  float k3 = distCoeffs[4];
-
-  map1.create(size, CV_32F);
-  map2.create(size, CV_32F);
+public:
+  DistortMapBody(const cv::Matx33f &cameraMatrix, const cv::Vec<float, 5> &distCoeffs, cv::Mat &map1, cv::Mat &map2)
+    : cameraMatrix(cameraMatrix), distCoeffs(distCoeffs), map1(map1), map2(map2)
+  {
+  }
 
-  for (int col = 0; col < size.width; col++)
+  void operator()(const cv::Range &range) const
   {
-    for (int row = 0; row < size.height; row++)
+    float fx = cameraMatrix(0, 0);
+    float fy = cameraMatrix(1, 1);
+    float ux = cameraMatrix(0, 2);
+    float uy = cameraMatrix(1, 2);
+
+    float k1 = distCoeffs[0];
+    float k2 = distCoeffs[1];
+    float p1 = distCoeffs[2];
+    float p2 = distCoeffs[3];
+    float k3 = distCoeffs[4];
+
+    int cols = map1.cols;
+    bool fixedPoint = (map1.type() == CV_16SC2);
+    cv::Mat rowMapX(1, cols, CV_32F), rowMapY(1, cols, CV_32F);
+
+    for (int row = range.start; row < range.end; row++)
     {
+      float *mapX = fixedPoint ? rowMapX.ptr<float>() : map1.ptr<float>(row);
+      float *mapY = fixedPoint ? rowMapY.ptr<float>() : map2.ptr<float>(row);
+
       // move origo to principal point and convert using focal length
-      float x = (col - ux) / fx;
       float y = (row - uy) / fy;
 
-      float xCorrected, yCorrected;
+      for (int col = 0; col < cols; col++)
+      {
+        float x = (col - ux) / fx;
+
+        // Step 1 : correct distortion
+        float r2 = x * x + y * y;
+        // radial
+        float radial = 1.f + r2 * (k1 + r2 * (k2 + r2 * k3));
+        // tangential
+        float xCorrected = x * radial + (2.f * p1 * x * y + p2 * (r2 + 2.f * x * x));
+        float yCorrected = y * radial + (p1 * (r2 + 2.f * y * y) + 2.f * p2 * x * y);
+
+        // convert back to pixel coordinates and correct the vector in the opposite direction
+        mapX[col] = 2.f * col - (xCorrected * fx + ux);
+        mapY[col] = 2.f * row - (yCorrected * fy + uy);
+      }
 
-      // Step 1 : correct distortion
-      float r2 = x * x + y * y;
-      // radial
-      xCorrected = x * (1. + k1 * r2 + k2 * r2 * r2 + k3 * r2 * r2 * r2);
-      yCorrected = y * (1. + k1 * r2 + k2 * r2 * r2 + k3 * r2 * r2 * r2);
-      // tangential
-      xCorrected = xCorrected + (2. * p1 * x * y + p2 * (r2 + 2. * x * x));
-      yCorrected = yCorrected + (p1 * (r2 + 2. * y * y) + 2. * p2 * x * y);
+      if (fixedPoint)
+      {
+        cv::Mat rowMap1 = map1.row(row), rowMap2 = map2.row(row);
+        cv::convertMaps(rowMapX, rowMapY, rowMap1, rowMap2, CV_16SC2);
+      }
+    }
+  }
 
-      // convert back to pixel coordinates
-      float col_displaced = xCorrected * fx + ux;
-      float row_displaced = yCorrected * fy + uy;
+private:
+  cv::Matx33f cameraMatrix;
+  cv::Vec<float, 5> distCoeffs;
+  cv::Mat &map1, &map2;
+};
 
-      // correct the vector in the opposite direction
-      map1.at<float>(row, col) = col + (col - col_displaced);
-      map2.at<float>(row, col) = row + (row - row_displaced);
-    }
+void initDistortMap(const cv::Matx33f cameraMatrix, const cv::Vec<float, 5> distCoeffs, const cv::Size size,
+                    cv::Mat &map1, cv::Mat &map2, int m1type)
+{
+  CV_Assert(m1type == CV_32FC1 || m1type == CV_16SC2);
+
+  if (m1type == CV_16SC2)
+  {
+    map1.create(size, CV_16SC2);
+    map2.create(size, CV_16UC1);
+  }
+  else
+  {
+    map1.create(size, CV_32F);
+    map2.create(size, CV_32F);
+  }
+
+  cv::parallel_for_(cv::Range(0, size.height), DistortMapBody(cameraMatrix, distCoeffs, map1, map2));
+}
+
+void cachedDistortMap(const cv::Matx33f cameraMatrix, const cv::Vec<float, 5> distCoeffs, const cv::Size size,
+                      cv::Mat &map1, cv::Mat &map2)
+{
+  // Key of calibration and size, compared bitwise
+  std::vector<float> key(cameraMatrix.val, cameraMatrix.val + 9);
+  key.insert(key.end(), distCoeffs.val, distCoeffs.val + 5);
+  key.push_back(size.width);
+  key.push_back(size.height);
+
+  static std::mutex mutex;
+  static std::map<std::vector<float>, std::pair<cv::Mat, cv::Mat> > cache;
+  std::lock_guard<std::mutex> lock(mutex);
+
+  std::map<std::vector<float>, std::pair<cv::Mat, cv::Mat> >::iterator it = cache.find(key);
+  if (it == cache.end())
+  {
+    // Only a few calibrations are used per session
+    if (cache.size() >= 4)
+      cache.clear();
+
+    cv::Mat newMap1, newMap2;
+    initDistortMap(cameraMatrix, distCoeffs, size, newMap1, newMap2, CV_16SC2);
+    it = cache.insert(std::make_pair(key, std::make_pair(newMap1, newMap2))).first;
   }
+
+  map1 = it->second.first;
+  map2 = it->second.second;
 }
 
 // Downsample a texture which was created in virtual column/row space for a diamond pixel array projector
@@ -7,8 +7,13 @@ namespace cvtools
 {
 void phaseCorrelate(const cv::Mat &im1, const cv::Mat &im2, float &scale, float &angle, cv::Point2f &shift);
 cv::Mat logPolar(const cv::Mat &image, float scale);
+// Maps for cv::remap() pre-distorting an image for a lens. m1type is CV_32FC1 (float maps) or CV_16SC2 (fixed point
+// maps, map2 CV_16UC1), which remap faster.
 void initDistortMap(const cv::Matx33f cameraMatrix, const cv::Vec<float, 5> distCoeffs, const cv::Size size,
-                    cv::Mat &map1, cv::Mat &map2);
+                    cv::Mat &map1, cv::Mat &map2, int m1type = CV_32FC1);
+// Fixed point maps as above, computed once per lens and size. The maps are shared and must not be written to.
+void cachedDistortMap(const cv::Matx33f cameraMatrix, const cv::Vec<float, 5> distCoeffs, const cv::Size size,
+                      cv::Mat &map1, cv::Mat &map2);
 cv::Mat diamondDownsample(cv::Mat &pattern);
 void imshow(const char *windowName, cv::Mat im, unsigned int x, unsigned int y);
 void imagesc(const char *windowName, cv::Mat im);
@@ -10,8 +10,40 @@
 #include <thread>
 #include "usb.h"
 
+// What the Lightcrafter is known to hold. Shared by all instances, since they
+// talk to the same device. Reset on connect and disconnect, as the device may
+// be power cycled or reset in between.
+struct DeviceState {
+  bool sequence_valid = false;
+  bool sequence_validated = false;
+  unsigned long long sequence_hash = 0;
+
+  bool config_valid = false;
+  int num_lut_entries = 0;
+  int num_splash_lut_entries = 0;
+
+  bool timing_valid = false;
+  unsigned int exposure_period_us = 0;
+  unsigned int frame_period_us = 0;
+
+  bool trigger_mode_valid = false;
+  int trigger_mode = 0;
+
+  bool led_currents_valid = false;
+  unsigned char led_currents[3] = {0, 0, 0};
+
+  bool led_enables_valid = false;
+  bool led_sequencer_control = false;
+};
+
+static DeviceState g_device_state;
+
 Lightcrafter_4500_pattern_api::Lightcrafter_4500_pattern_api() {}
 
+void Lightcrafter_4500_pattern_api::invalidate_device_state() {
+  g_device_state = DeviceState();
+}
+
 Lightcrafter_4500_pattern_api::~Lightcrafter_4500_pattern_api() {
   this->close();
 }
@@ -32,10 +64,15 @@ int Lightcrafter_4500_pattern_api::init() {
     return -1;
   }
 
+  // The projector may have been power cycled or reset while disconnected
+  invalidate_device_state();
+
   // Make sure LC is not in standby
   bool is_standby;
   DLPC350_GetPowerMode(&is_standby);
   if (is_standby) {
+    // Pattern LUT and registers do not survive standby
+    invalidate_device_state();
     DLPC350_SetPowerMode(0);
     sleep_ms(5000);
     std::cout
@@ -72,6 +109,8 @@ int Lightcrafter_4500_pattern_api::close() {
       set_pat_seq_stop();
     }
 
+    invalidate_device_state();
+
     if (DLPC350_USB_Close() < 0) {
       showError("Could not close!");
       return -1;
@@ -130,9 +169,6 @@ int Lightcrafter_4500_pattern_api::send_pattern_sequence(
     return -1;
   }
 
-  // Clear existing pattern in LC
-  DLPC350_ClearPatLut();
-
   // Go through all patterns, check exposure timings for patterns that share the
   // same exposure period
   for (i = 0; i < (int)m_pattern_store.size(); i++) {
@@ -177,29 +213,6 @@ int Lightcrafter_4500_pattern_api::send_pattern_sequence(
       }
     }
 
-    /**
-    std::cout << "Pattern "
-              << "[" << i << "] "
-              << "TrigType = " << curr_pattern.trigger_type << ","
-              << "PatNum = " << curr_pattern.pattern_number << ","
-              << "BitDepth = " << curr_pattern.bit_depth << ","
-              << "LEDSelect = " << curr_pattern.led_select << ","
-              << "InvertPattern = " << curr_pattern.invert_pattern << ","
-              << "Insert Black = " << curr_pattern.insert_black_frame << ","
-              << "BufSwap = " << curr_pattern.buffer_swap << ","
-              << "TrigOutPrev = " << curr_pattern.trigger_out_prev << std::endl;
-    **/
-
-    // If everything checks out, add pattern
-    if (DLPC350_AddToPatLut(
-            curr_pattern.trigger_type, curr_pattern.pattern_number,
-            curr_pattern.bit_depth, curr_pattern.led_select,
-            curr_pattern.invert_pattern, curr_pattern.insert_black_frame,
-            curr_pattern.buffer_swap, curr_pattern.trigger_out_prev) < 0) {
-      showError("Error Updating LUT");
-      return -1;
-    }
-
     // If there is a buffer swap or if this is the first pattern (image needs
     // to be changed for this pattern)
     if (curr_pattern.buffer_swap || num_splash_lut_entries == 0) {
@@ -230,32 +243,115 @@ int Lightcrafter_4500_pattern_api::send_pattern_sequence(
     }
   }
 
+  // Skip the upload if the projector already holds this sequence, either
+  // uploaded on this connection and confirmed by a cheap read back of its
+  // configuration, or found by reading back the whole sequence
+  unsigned long long hash = sequence_hash(exposure_period_us, frame_period_us);
+  bool is_uploaded = g_device_state.sequence_valid &&
+                     g_device_state.sequence_hash == hash &&
+                     projector_holds_config(num_splash_lut_entries,
+                                            exposure_period_us,
+                                            frame_period_us);
+  if (!is_uploaded && !g_device_state.sequence_valid &&
+      projector_holds_sequence(splash_lut, num_splash_lut_entries,
+                               exposure_period_us, frame_period_us)) {
+    g_device_state.sequence_valid = true;
+    g_device_state.sequence_validated = false;
+    g_device_state.sequence_hash = hash;
+    is_uploaded = true;
+  }
+
+  if (is_uploaded) {
+    // Stopping restarts the sequence from its first pattern
+    this->set_pattern_mode();
+    set_led_sequencer_control(true);
+    if (g_device_state.sequence_validated) return 0;
+    if (validate_pattern() < 0) return -1;
+    g_device_state.sequence_validated = true;
+    return 0;
+  }
+
+  g_device_state.sequence_valid = false;
+
+  // Clear existing pattern in LC
+  DLPC350_ClearPatLut();
+
+  for (i = 0; i < (int)m_pattern_store.size(); i++) {
+    auto curr_pattern = m_pattern_store[i];
+
+    /**
+    std::cout << "Pattern "
+              << "[" << i << "] "
+              << "TrigType = " << curr_pattern.trigger_type << ","
+              << "PatNum = " << curr_pattern.pattern_number << ","
+              << "BitDepth = " << curr_pattern.bit_depth << ","
+              << "LEDSelect = " << curr_pattern.led_select << ","
+              << "InvertPattern = " << curr_pattern.invert_pattern << ","
+              << "Insert Black = " << curr_pattern.insert_black_frame << ","
+              << "BufSwap = " << curr_pattern.buffer_swap << ","
+              << "TrigOutPrev = " << curr_pattern.trigger_out_prev << std::endl;
+    **/
+
+    // If everything checks out, add pattern
+    if (DLPC350_AddToPatLut(
+            curr_pattern.trigger_type, curr_pattern.pattern_number,
+            curr_pattern.bit_depth, curr_pattern.led_select,
+            curr_pattern.invert_pattern, curr_pattern.insert_black_frame,
+            curr_pattern.buffer_swap, curr_pattern.trigger_out_prev) < 0) {
+      showError("Error Updating LUT");
+      return -1;
+    }
+  }
+
   // Start pattern mode
   this->set_pattern_mode();
+  set_led_sequencer_control(true);
+
+  // Registers keep their values, only write those that change
+  DeviceState& dev = g_device_state;
 
   // Config pattern mode
   unsigned int num_patterns_trigout2 =
       1;  // Does not matter a lot since we are not using trigout
   bool repeat_mode = true;
-  if (DLPC350_SetPatternConfig(num_lut_entries, repeat_mode,
-                               num_patterns_trigout2,
-                               num_splash_lut_entries) < 0) {
-    showError("Error Sending Pattern Config");
-    return -1;
+  if (!dev.config_valid || dev.num_lut_entries != num_lut_entries ||
+      dev.num_splash_lut_entries != num_splash_lut_entries) {
+    dev.config_valid = false;
+    if (DLPC350_SetPatternConfig(num_lut_entries, repeat_mode,
+                                 num_patterns_trigout2,
+                                 num_splash_lut_entries) < 0) {
+      showError("Error Sending Pattern Config");
+      return -1;
+    }
+    dev.num_lut_entries = num_lut_entries;
+    dev.num_splash_lut_entries = num_splash_lut_entries;
+    dev.config_valid = true;
   }
 
   // Set exposure and fram period
-  if (DLPC350_SetExposure_FramePeriod(exposure_period_us, frame_period_us) <
-      0) {
-    showError("Error Sending Exposure period");
-    return -1;
+  if (!dev.timing_valid || dev.exposure_period_us != exposure_period_us ||
+      dev.frame_period_us != frame_period_us) {
+    dev.timing_valid = false;
+    if (DLPC350_SetExposure_FramePeriod(exposure_period_us, frame_period_us) <
+        0) {
+      showError("Error Sending Exposure period");
+      return -1;
+    }
+    dev.exposure_period_us = exposure_period_us;
+    dev.frame_period_us = frame_period_us;
+    dev.timing_valid = true;
   }
 
   trig_mode = 1;  // Internal trigger
   // Configure Trigger Mode - 0 or 1
-  if (DLPC350_SetPatternTriggerMode(trig_mode) < 0) {
-    showError("Error Sending trigger Mode");
-    return -1;
+  if (!dev.trigger_mode_valid || dev.trigger_mode != trig_mode) {
+    dev.trigger_mode_valid = false;
+    if (DLPC350_SetPatternTriggerMode(trig_mode) < 0) {
+      showError("Error Sending trigger Mode");
+      return -1;
+    }
+    dev.trigger_mode = trig_mode;
+    dev.trigger_mode_valid = true;
   }
 
   // Send Pattern LUT
@@ -282,7 +378,106 @@ int Lightcrafter_4500_pattern_api::send_pattern_sequence(
     return -1;
   }
 
-  return validate_pattern();
+  if (validate_pattern() < 0) return -1;
+
+  dev.sequence_valid = true;
+  dev.sequence_validated = true;
+  dev.sequence_hash = hash;
+
+  return 0;
+}
+
+unsigned long long Lightcrafter_4500_pattern_api::sequence_hash(
+    unsigned int exposure_period_us, unsigned int frame_period_us) const {
+  // FNV-1a over all fields sent to the projector
+  unsigned long long hash = 14695981039346656037ULL;
+  auto add = [&hash](unsigned int value) {
+    for (int i = 0; i < 4; i++) {
+      hash ^= (value >> (8 * i)) & 0xFF;
+      hash *= 1099511628211ULL;
+    }
+  };
+
+  add(exposure_period_us);
+  add(frame_period_us);
+  add(m_pattern_store.size());
+  for (const single_pattern& pattern : m_pattern_store) {
+    add(pattern.trigger_type);
+    add(pattern.pattern_number);
+    add(pattern.bit_depth);
+    add(pattern.led_select);
+    add(pattern.image_indice);
+    add(pattern.invert_pattern | (pattern.insert_black_frame << 1) |
+        (pattern.buffer_swap << 2) | (pattern.trigger_out_prev << 3));
+  }
+
+  return hash;
+}
+
+bool Lightcrafter_4500_pattern_api::projector_holds_config(
+    int num_splash_lut_entries, unsigned int exposure_period_us,
+    unsigned int frame_period_us) {
+  bool is_in_pattern_mode = false;
+  if (DLPC350_GetMode(&is_in_pattern_mode) < 0 || !is_in_pattern_mode)
+    return false;
+
+  unsigned int num_lut_entries, num_patterns_trigout2, num_images;
+  bool repeat_mode;
+  if (DLPC350_GetPatternConfig(&num_lut_entries, &repeat_mode,
+                               &num_patterns_trigout2, &num_images) < 0)
+    return false;
+  if (num_lut_entries != m_pattern_store.size() || !repeat_mode ||
+      (int)num_images != num_splash_lut_entries)
+    return false;
+
+  unsigned int exposure, frame_period;
+  if (DLPC350_GetExposure_FramePeriod(&exposure, &frame_period) < 0 ||
+      exposure != exposure_period_us || frame_period != frame_period_us)
+    return false;
+
+  int trig_mode;
+  if (DLPC350_GetPatternTriggerMode(&trig_mode) < 0 || trig_mode != 1)
+    return false;
+
+  return true;
+}
+
+bool Lightcrafter_4500_pattern_api::projector_holds_sequence(
+    const unsigned char* splash_lut, int num_splash_lut_entries,
+    unsigned int exposure_period_us, unsigned int frame_period_us) {
+  if (!projector_holds_config(num_splash_lut_entries, exposure_period_us,
+                              frame_period_us))
+    return false;
+
+  // Read back the pattern LUT, one transfer for all entries
+  if (DLPC350_GetPatLut(m_pattern_store.size()) < 0) return false;
+  for (int i = 0; i < (int)m_pattern_store.size(); i++) {
+    const single_pattern& pattern = m_pattern_store[i];
+    int trigger_type, pattern_number, bit_depth, led_select;
+    bool invert_pattern, insert_black_frame, buffer_swap, trigger_out_prev;
+    DLPC350_GetPatLutItem(i, &trigger_type, &pattern_number, &bit_depth,
+                          &led_select, &invert_pattern, &insert_black_frame,
+                          &buffer_swap, &trigger_out_prev);
+    if (trigger_type != pattern.trigger_type ||
+        pattern_number != pattern.pattern_number ||
+        bit_depth != pattern.bit_depth || led_select != pattern.led_select ||
+        invert_pattern != pattern.invert_pattern ||
+        insert_black_frame != pattern.insert_black_frame ||
+        buffer_swap != pattern.buffer_swap ||
+        trigger_out_prev != pattern.trigger_out_prev)
+      return false;
+  }
+
+  // Reads whole packets, leave room beyond 64 entries
+  unsigned char image_lut[128];
+  if (DLPC350_GetImageLut(image_lut, num_splash_lut_entries) < 0) return false;
+  for (int i = 0; i < num_splash_lut_entries; i++)
+    if (image_lut[i] != splash_lut[i]) return false;
+
+  std::cout << "Lightcrafter already holds the pattern sequence, skipping upload"
+            << std::endl;
+
+  return true;
 }
 
 void Lightcrafter_4500_pattern_api::print_projector_info() {
@@ -332,16 +527,17 @@ int Lightcrafter_4500_pattern_api::set_pattern_mode() {
   } else {
     // Switch to Pattern Mode
     DLPC350_SetMode(true);
-    sleep_ms(100);
 
-    for (int i = 0; i < m_max_retries; i++) {
+    // Poll frequently, resend the command every 100 ms
+    const int resend_polls = 100 / m_poll_interval_ms;
+    for (int i = 0; i < m_max_retries * resend_polls; i++) {
+      sleep_ms(m_poll_interval_ms);
       DLPC350_GetMode(&is_in_pattern_mode);
       if (is_in_pattern_mode) {
         result = 0;
         break;
-      } else {
+      } else if ((i + 1) % resend_polls == 0) {
         DLPC350_SetMode(true);
-        sleep_ms(100);
       }
     }
   }
@@ -368,16 +564,17 @@ int Lightcrafter_4500_pattern_api::set_video_mode() {
     // If we stopped pattern sequence successfully, switch to video mode
     if (pattern_mode == 0) {
       DLPC350_SetMode(false);
-      sleep_ms(100);
 
-      for (int i = 0; i < m_max_retries; i++) {
+      // Poll frequently, resend the command every 100 ms
+      const int resend_polls = 100 / m_poll_interval_ms;
+      for (int i = 0; i < m_max_retries * resend_polls; i++) {
+        sleep_ms(m_poll_interval_ms);
         DLPC350_GetMode(&is_in_pattern_mode);
         if (!is_in_pattern_mode) {
           result = 0;
           break;
-        } else {
+        } else if ((i + 1) % resend_polls == 0) {
           DLPC350_SetMode(false);
-          sleep_ms(100);
         }
       }
     }
@@ -390,6 +587,7 @@ int Lightcrafter_4500_pattern_api::set_video_mode() {
 }
 
 int Lightcrafter_4500_pattern_api::set_pat_seq_start() {
+  set_led_sequencer_control(true);
   return set_pat_seq_mode(2);
 }
 
@@ -414,20 +612,27 @@ int Lightcrafter_4500_pattern_api::set_pat_seq_mode(unsigned int desired_mode) {
 
   if (is_in_pattern_mode) {
     unsigned int current_pat_mode;
+
+    // Nothing to do if the sequence is already in the desired mode
+    if (DLPC350_GetPatternDisplay(&current_pat_mode) == 0 &&
+        current_pat_mode == desired_mode)
+      return 0;
+
     DLPC350_PatternDisplay(desired_mode);
-    sleep_ms(100);
 
-    for (int i = 0; i < m_max_retries; i++) {
+    // Poll frequently, resend the command every 100 ms
+    const int resend_polls = 100 / m_poll_interval_ms;
+    for (int i = 0; i < m_max_retries * resend_polls; i++) {
+      sleep_ms(m_poll_interval_ms);
       DLPC350_GetPatternDisplay(&current_pat_mode);
 
       if (current_pat_mode == desired_mode) {
         // Mode change successful
         result = 0;
         break;
-      } else {
+      } else if ((i + 1) % resend_polls == 0) {
         // Else try change mode again
         DLPC350_PatternDisplay(desired_mode);
-        sleep_ms(100);
       }
     }
   } else {
@@ -502,10 +707,11 @@ int Lightcrafter_4500_pattern_api::validate_pattern() {
     if (ready) {
       break;
     } else {
-      sleep_ms(200);
+      sleep_ms(m_poll_interval_ms);
     }
 
-    if (i++ > m_max_retries) break;
+    // Same overall timeout as polling every 200 ms
+    if (i++ > m_max_retries * 200 / m_poll_interval_ms) break;
   } while (1);
 
   // Print out any possible warnings and errors
@@ -548,8 +754,39 @@ int Lightcrafter_4500_pattern_api::validate_pattern() {
 int Lightcrafter_4500_pattern_api::set_led_currents(unsigned char r,
                                                     unsigned char g,
                                                     unsigned char b) {
+  DeviceState& dev = g_device_state;
+  if (dev.led_currents_valid && dev.led_currents[0] == r &&
+      dev.led_currents[1] == g && dev.led_currents[2] == b)
+    return 0;
+
   // r,g and b values are the ones displayed on the GUI
-  return DLPC350_SetLedCurrents(255 - r, 255 - g, 255 - b);
+  int status = DLPC350_SetLedCurrents(255 - r, 255 - g, 255 - b);
+
+  dev.led_currents_valid = (status >= 0);
+  dev.led_currents[0] = r;
+  dev.led_currents[1] = g;
+  dev.led_currents[2] = b;
+
+  return status;
+}
+
+int Lightcrafter_4500_pattern_api::set_led_sequencer_control(bool enabled) {
+  DeviceState& dev = g_device_state;
+  if (dev.led_enables_valid && dev.led_sequencer_control == enabled) return 0;
+
+  // With sequencer control, the pattern LUT selects the LEDs. Otherwise all
+  // LEDs are off.
+  int status = DLPC350_SetLedEnables(enabled, false, false, false);
+
+  dev.led_enables_valid = (status >= 0);
+  dev.led_sequencer_control = enabled;
+
+  return status;
+}
+
+int Lightcrafter_4500_pattern_api::blank() {
+  set_pat_seq_stop();
+  return set_led_sequencer_control(false);
 }
 
 int Lightcrafter_4500_pattern_api::get_led_currents(unsigned char& r,
@@ -41,14 +41,34 @@ class Lightcrafter_4500_pattern_api {
   int set_pat_seq_start();
   int set_pat_seq_pause();
   int set_pat_seq_stop();
+  // Blanks the output by switching off the LEDs, keeps the uploaded sequence
+  int blank();
   void sleep_ms(int ms);
+  // Forget what the projector is known to hold, e.g. after a power cycle
+  static void invalidate_device_state();
 
  private:
   const int m_max_retries = 10;
+  // Polling interval while waiting for mode changes and validation
+  const int m_poll_interval_ms = 10;
   int set_pat_seq_mode(unsigned int desired_mode);
   std::vector<single_pattern> m_pattern_store = {};
   void check_and_fix_buffer_swaps();
   int validate_pattern();
+  // Identifies everything send_pattern_sequence() writes to the projector
+  unsigned long long sequence_hash(unsigned int exposure_period_us,
+                                   unsigned int frame_period_us) const;
+  // Reads back the pattern mode, configuration and timing, a few short
+  // transfers
+  bool projector_holds_config(int num_splash_lut_entries,
+                              unsigned int exposure_period_us,
+                              unsigned int frame_period_us);
+  // Reads back the pattern configuration, LUT and image LUT
+  bool projector_holds_sequence(const unsigned char* splash_lut,
+                                int num_splash_lut_entries,
+                                unsigned int exposure_period_us,
+                                unsigned int frame_period_us);
+  int set_led_sequencer_control(bool enabled);
 };
 
 #endif  // LIGHTCRAFTER_4500_PATTERN_API_H
@@ -0,0 +1,37 @@
+TEMPLATE = app
+CONFIG -= app_bundle
+CONFIG -= qt
+TARGET = LC4500Firmware
+
+INCLUDEPATH += .. ../codec LC4500API
+
+HEADERS += LC4500PatternImages.h \
+        LC4500API/Lightcrafter_4500_pattern_api.h \
+        LC4500API/dlpc350_firmware.h \
+        ../cvtools.h
+
+SOURCES += mainLC4500Firmware.cpp \
+        LC4500PatternImages.cpp \
+        LC4500API/dlpc350_firmware.cpp \
+        LC4500API/dlpc350_common.cpp \
+        ../cvtools.cpp \
+        ../codec/pstools.cpp \
+        ../codec/phaseunwrap.cpp \
+        ../codec/phasecorr.cpp \
+        ../codec/CodecPhaseShift2x3.cpp \
+        ../codec/CodecPhaseShiftDescatter.cpp \
+        ../codec/CodecPhaseShift3.cpp \
+        ../codec/CodecPhaseShift3FastWrap.cpp \
+        ../codec/CodecPhaseShift3Unwrap.cpp \
+        ../codec/CodecPhaseShift4.cpp \
+        ../codec/CodecFastRatio.cpp \
+        ../codec/CodecPhaseShift2p1.cpp \
+        ../codec/CodecPhaseShift2p1Tpu.cpp \
+        ../codec/CodecPhaseShiftModulated.cpp \
+        ../codec/CodecPhaseShiftMicro.cpp \
+        ../codec/CodecGrayCode.cpp \
+        ../codec/CodecPhaseShiftNStep.cpp
+
+# pkg-config libs
+CONFIG += link_pkgconfig
+PKGCONFIG += opencv
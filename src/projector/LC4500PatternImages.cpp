@@ -0,0 +1,275 @@
+#include "LC4500PatternImages.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "cvtools.h"
+#include "dlpc350_firmware.h"
+
+// Native resolution of the DLPC350 splash images
+static const int nativeCols = 912;
+static const int nativeRows = 1140;
+
+// dlpc350_firmware keeps its state in globals
+static std::mutex firmwareMutex;
+
+namespace lc4500patterns {
+
+std::vector<cv::Mat> renderPatterns(Encoder *encoder, unsigned int screenCols,
+                                    unsigned int screenRows, bool diamond) {
+  std::vector<cv::Mat> patterns(encoder->getNPatterns());
+
+  for (unsigned int i = 0; i < patterns.size(); i++) {
+    cv::Mat pattern = encoder->getEncodingPattern(i);
+
+    // general repmat
+    pattern = cv::repeat(pattern, screenRows / pattern.rows + 1,
+                         screenCols / pattern.cols + 1);
+    pattern = pattern(cv::Range(0, screenRows), cv::Range(0, screenCols));
+
+    if (diamond) pattern = cvtools::diamondDownsample(pattern);
+
+    if (pattern.channels() > 1) cv::extractChannel(pattern, pattern, 0);
+
+    patterns[i] = pattern;
+  }
+
+  return patterns;
+}
+
+// dst |= bit srcBit of src, moved to bit dstBit, for n pixels
+static void packBitPlane(const uchar *src, uchar *dst, int n, int srcBit,
+                         int dstBit) {
+  const uchar mask = 1 << dstBit;
+  int x = 0;
+
+#ifdef __SSE2__
+  // The 16 bit shifts move bits across byte boundaries, but never into the
+  // masked bit
+  const __m128i maskv = _mm_set1_epi8((char)mask);
+  const __m128i shift = _mm_cvtsi32_si128(std::abs(dstBit - srcBit));
+  for (; x + 16 <= n; x += 16) {
+    __m128i s = _mm_loadu_si128((const __m128i *)(src + x));
+    s = (dstBit > srcBit) ? _mm_sll_epi16(s, shift) : _mm_srl_epi16(s, shift);
+    __m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+    d = _mm_or_si128(d, _mm_and_si128(s, maskv));
+    _mm_storeu_si128((__m128i *)(dst + x), d);
+  }
+#endif
+
+  for (; x < n; x++) dst[x] |= ((src[x] >> srcBit) & 1) << dstBit;
+}
+
+class PackBody : public cv::ParallelLoopBody {
+ public:
+  PackBody(const std::vector<cv::Mat> &patterns, int bitDepth, cv::Mat *planes)
+      : patterns(patterns), bitDepth(bitDepth), planes(planes) {}
+
+  void operator()(const cv::Range &range) const {
+    for (int y = range.start; y < range.end; y++) {
+      for (size_t i = 0; i < patterns.size(); i++) {
+        const uchar *src = patterns[i].ptr<uchar>(y);
+        int cols = patterns[i].cols;
+
+        for (int j = 0; j < bitDepth; j++) {
+          int plane = i * bitDepth + j;
+          uchar *dst = planes[plane / 8].ptr<uchar>(y);
+
+          // Whole channel
+          if (bitDepth == 8) {
+            std::memcpy(dst, src, cols);
+            break;
+          }
+
+          packBitPlane(src, dst, cols, 8 - bitDepth + j, plane % 8);
+        }
+      }
+    }
+  }
+
+ private:
+  const std::vector<cv::Mat> &patterns;
+  int bitDepth;
+  cv::Mat *planes;
+};
+
+std::vector<cv::Mat> packPatterns(const std::vector<cv::Mat> &patterns,
+                                  int bitDepth, int firstImageIndex,
+                                  std::vector<single_pattern> *sequence) {
+  std::vector<cv::Mat> images;
+  if (sequence) sequence->clear();
+
+  if (bitDepth < 1 || bitDepth > 8) {
+    std::cerr << "lc4500patterns: invalid bit depth " << bitDepth << std::endl;
+    return images;
+  }
+  if (patterns.empty()) return images;
+
+  cv::Size size = patterns[0].size();
+  std::vector<cv::Mat> gray(patterns.size());
+  for (size_t i = 0; i < patterns.size(); i++) {
+    if (patterns[i].size() != size || patterns[i].depth() != CV_8U) {
+      std::cerr << "lc4500patterns: patterns must be 8-bit and of equal size"
+                << std::endl;
+      return images;
+    }
+    if (patterns[i].channels() > 1)
+      cv::extractChannel(patterns[i], gray[i], 0);
+    else
+      gray[i] = patterns[i];
+  }
+
+  int patternsPerImage = 24 / bitDepth;
+  for (size_t begin = 0; begin < gray.size(); begin += patternsPerImage) {
+    size_t end = std::min(begin + patternsPerImage, gray.size());
+    std::vector<cv::Mat> imagePatterns(gray.begin() + begin,
+                                       gray.begin() + end);
+
+    // G, R, B bit planes
+    cv::Mat planes[3];
+    for (int c = 0; c < 3; c++) planes[c] = cv::Mat::zeros(size, CV_8U);
+
+    cv::parallel_for_(cv::Range(0, size.height),
+                      PackBody(imagePatterns, bitDepth, planes));
+
+    cv::Mat bgr[3] = {planes[2], planes[0], planes[1]};
+    cv::Mat image;
+    cv::merge(bgr, 3, image);
+    images.push_back(image);
+
+    if (sequence) {
+      for (size_t i = begin; i < end; i++) {
+        single_pattern pattern;
+        pattern.pattern_number = i - begin;
+        pattern.bit_depth = bitDepth;
+        pattern.led_select = 7;
+        pattern.image_indice = firstImageIndex + images.size() - 1;
+        // The DMD shows a new image after a buffer swap only
+        pattern.buffer_swap = (i == begin);
+        sequence->push_back(pattern);
+      }
+    }
+  }
+
+  return images;
+}
+
+static void putLittleEndian(unsigned char *dst, unsigned int value,
+                            int nBytes) {
+  for (int i = 0; i < nBytes; i++) dst[i] = (value >> (8 * i)) & 0xFF;
+}
+
+std::vector<unsigned char> encodeBmp(const cv::Mat &image) {
+  CV_Assert(image.type() == CV_8UC3);
+
+  const int fileHeaderSize = 14, infoHeaderSize = 40;
+  const int offset = fileHeaderSize + infoHeaderSize;
+  int lineLength = (image.cols * 3 + 3) / 4 * 4;
+  int imageSize = lineLength * image.rows;
+
+  std::vector<unsigned char> bmp(offset + imageSize, 0);
+  unsigned char *header = &bmp[0];
+
+  header[0] = 'B';
+  header[1] = 'M';
+  putLittleEndian(header + 2, bmp.size(), 4);
+  putLittleEndian(header + 10, offset, 4);
+
+  unsigned char *info = header + fileHeaderSize;
+  putLittleEndian(info + 0, infoHeaderSize, 4);
+  putLittleEndian(info + 4, image.cols, 4);
+  putLittleEndian(info + 8, image.rows, 4);
+  putLittleEndian(info + 12, 1, 2);   // planes
+  putLittleEndian(info + 14, 24, 2);  // bits per pixel
+  putLittleEndian(info + 20, imageSize, 4);
+
+  // Bottom-up rows
+  for (int y = 0; y < image.rows; y++)
+    std::memcpy(&bmp[offset + (image.rows - 1 - y) * lineLength],
+                image.ptr(y), image.cols * 3);
+
+  return bmp;
+}
+
+int buildFirmware(const std::vector<unsigned char> &baseFirmware,
+                  const std::vector<cv::Mat> &images, int nKeepImages,
+                  std::vector<unsigned char> &firmware) {
+  std::lock_guard<std::mutex> lock(firmwareMutex);
+
+  if (baseFirmware.empty() || nKeepImages < 0 ||
+      nKeepImages + images.size() > MAX_SPLASH_IMAGES)
+    return ERROR_WRONG_PARAMS;
+
+  int error = DLPC350_Frmw_CopyAndVerifyImage(&baseFirmware[0],
+                                              baseFirmware.size());
+  if (error < 0) return error;
+
+  if (nKeepImages > 0 && nKeepImages > DLPC350_Frmw_GetSplashCount())
+    return ERROR_WRONG_PARAMS;
+
+  // Images to keep must be read before the splash buffer is rebuilt
+  std::vector<cv::Mat> splashImages;
+  for (int i = 0; i < nKeepImages; i++) {
+    cv::Mat image(nativeRows, nativeCols, CV_8UC3);
+    error = DLPC350_Frmw_GetSpashImage(image.ptr(), i);
+    if (error < 0) return error;
+    splashImages.push_back(image);
+  }
+  splashImages.insert(splashImages.end(), images.begin(), images.end());
+
+  error = DLPC350_Frmw_SPLASH_InitBuffer(splashImages.size());
+  if (error < 0) return ERROR_WRONG_PARAMS;
+
+  for (size_t i = 0; i < splashImages.size(); i++) {
+    std::vector<unsigned char> bmp = encodeBmp(splashImages[i]);
+    uint8 compression = SPLASH_NOCOMP_SPECIFIED;
+    uint32 compressedSize;
+    error = DLPC350_Frmw_SPLASH_AddSplash(&bmp[0], &compression,
+                                          &compressedSize);
+    if (error < 0) return error;
+  }
+
+  char token[] = "DEFAULT.PATTERNCONFIG.NUM_SPLASH";
+  uint32 nSplash = splashImages.size();
+  error = DLPC350_Frmw_WriteApplConfigData(token, &nSplash, 1);
+  if (error < 0) return error;
+
+  unsigned char *buffer;
+  uint32 size;
+  DLPC350_Frmw_Get_NewFlashImage(&buffer, &size);
+  firmware.assign(buffer, buffer + size);
+
+  return 0;
+}
+
+std::string errorString(int error) {
+  switch (error) {
+    case 0:
+      return "no error";
+    case ERROR_NO_MEM_FOR_MALLOC:
+      return "out of memory";
+    case ERROR_FRMW_FLASH_TABLE_SIGN_MISMATCH:
+      return "not a DLPC350 firmware image";
+    case ERROR_NO_SPLASH_IMAGE:
+      return "splash image missing in firmware";
+    case ERROR_NOT_BMP_FILE:
+    case ERROR_NOT_24bit_BMP_FILE:
+      return "invalid image";
+    case ERROR_INIT_NOT_DONE_PROPERLY:
+      return "firmware not initialized";
+    case ERROR_WRONG_PARAMS:
+      return "invalid parameters";
+    case ERROR_NO_SPACE_IN_FRMW:
+      return "images do not fit into flash";
+    default:
+      return "unknown error";
+  }
+}
+}
@@ -0,0 +1,47 @@
+#ifndef LC4500PATTERNIMAGES_H
+#define LC4500PATTERNIMAGES_H
+
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "Codec.h"
+#include "Lightcrafter_4500_pattern_api.h"
+
+// Generation of LightCrafter 4500 flash images from encoder patterns.
+// The DLPC350 displays patterns as bit planes of 24-bit images: bit plane k of
+// an image is G(k) for k < 8, R(k-8) for k < 16 and B(k-16) otherwise.
+// A pattern of bit depth b occupies b consecutive bit planes, such that an
+// image holds 24/b patterns.
+namespace lc4500patterns {
+
+// Full resolution, single channel patterns of encoder, which must have been
+// created for screenCols x screenRows. With diamond, the patterns are
+// downsampled to the diamond pixel layout of the DMD.
+std::vector<cv::Mat> renderPatterns(Encoder *encoder, unsigned int screenCols,
+                                    unsigned int screenRows, bool diamond);
+
+// Packs 8-bit patterns (CV_8UC1, or CV_8UC3 of which the first channel is
+// used) into CV_8UC3 images in the DLPC350 bit plane layout (BGR channel
+// order, as cv::imwrite expects). Each pattern is represented by its bitDepth
+// most significant bits. sequence receives one entry per pattern, addressing
+// images from firstImageIndex on.
+std::vector<cv::Mat> packPatterns(const std::vector<cv::Mat> &patterns,
+                                  int bitDepth, int firstImageIndex = 0,
+                                  std::vector<single_pattern> *sequence = NULL);
+
+// Uncompressed 24-bit BMP file of a CV_8UC3 image
+std::vector<unsigned char> encodeBmp(const cv::Mat &image);
+
+// Firmware image with the splash images of baseFirmware from index
+// nKeepImages on replaced by images. Returns 0 on success, or the
+// dlpc350_firmware error code.
+int buildFirmware(const std::vector<unsigned char> &baseFirmware,
+                  const std::vector<cv::Mat> &images, int nKeepImages,
+                  std::vector<unsigned char> &firmware);
+
+std::string errorString(int error);
+}
+
+#endif
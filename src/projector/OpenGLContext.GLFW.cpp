@@ -47,7 +47,7 @@ std::vector<ScreenInfo> OpenGLContext::GetScreenInfo() {
 }
 
 OpenGLContext::OpenGLContext(uint _screenNum)
-    : screenNum(_screenNum), screenResX(0), screenResY(0) {
+    : screenNum(_screenNum), screenResX(0), screenResY(0), swapInterval(1) {
   contextInfo = new OpenGLContextInfo();
 
   if (!glfwInit()) std::cerr << "Could not initialize GLFW!" << std::endl;
@@ -110,6 +110,12 @@ void OpenGLContext::makeContextCurrent() {
   glfwMakeContextCurrent(contextInfo->window);
 }
 
+void OpenGLContext::setSwapInterval(int interval) {
+  glfwMakeContextCurrent(contextInfo->window);
+  glfwSwapInterval(interval);
+  swapInterval = interval;
+}
+
 void OpenGLContext::flush() {
   // Swap buffers
   glfwSwapBuffers(contextInfo->window);
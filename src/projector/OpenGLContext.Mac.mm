@@ -30,7 +30,7 @@ std::vector<ScreenInfo> OpenGLContext::GetScreenInfo(){
     return ret;
 }
 
-OpenGLContext::OpenGLContext(unsigned int _screenNum){
+OpenGLContext::OpenGLContext(unsigned int _screenNum) : swapInterval(1){
     // Set instance var
     screenNum = _screenNum;
     std::vector<ScreenInfo> screens = GetScreenInfo();
@@ -90,6 +90,12 @@ OpenGLContext::~OpenGLContext(){
     //[[_openGLContext view] dealloc];
 }
 
+void OpenGLContext::setSwapInterval(int interval){
+    const GLint glInterval = interval;
+    [contextInfo->context setValues:&glInterval forParameter:NSOpenGLCPSwapInterval];
+    swapInterval = interval;
+}
+
 void OpenGLContext::flush(){
     // Flush OpenGL commands
     [contextInfo->context flushBuffer];
@@ -46,7 +46,7 @@ std::vector<ScreenInfo> OpenGLContext::GetScreenInfo(){
     return ret;
 }
 
-OpenGLContext::OpenGLContext(uint _screenNum) : screenNum(_screenNum){
+OpenGLContext::OpenGLContext(uint _screenNum) : screenNum(_screenNum), swapInterval(1){
 
     contextInfo = new OpenGLContextInfo();
 
@@ -158,13 +158,24 @@ void OpenGLContext::makeContextCurrent(){
     glXMakeCurrent(contextInfo->display, contextInfo->window, contextInfo->context);
 }
 
+void OpenGLContext::setSwapInterval(int interval){
+    const char *glx_extensions = glXQueryExtensionsString(contextInfo->display, screenNum);
+    if (strstr(glx_extensions, "GLX_EXT_swap_control")) {
+        PFNGLXSWAPINTERVALEXTPROC SwapIntervalEXT = (PFNGLXSWAPINTERVALEXTPROC)glXGetProcAddressARB((const GLubyte*)"glXSwapIntervalEXT");
+        SwapIntervalEXT(contextInfo->display, contextInfo->window, interval);
+        swapInterval = interval;
+    } else {
+        std::cerr << "OpenGLContext.Unix Error: Could not access swap interval extension!" << std::endl;
+    }
+}
+
 void OpenGLContext::flush(){
 
     // Swap buffers
     glXSwapBuffers(contextInfo->display, contextInfo->window);
 
-    // Synchronize CPU with vsync buffer swap
-    glFinish();
+    // ProjectorOpenGL fences each frame and waits on the fence when the frame
+    // must be on screen, so the swap does not block here.
     //glXWaitGL();
 
 }
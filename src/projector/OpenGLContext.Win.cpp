@@ -119,7 +119,7 @@ struct OpenGLContext::OpenGLContextInfo{
     OpenGLContextInfo() : hdc(NULL), hglrc(NULL), hwnd(NULL){}
 };
 
-OpenGLContext::OpenGLContext(unsigned int _screenNum) : screenNum(_screenNum){
+OpenGLContext::OpenGLContext(unsigned int _screenNum) : screenNum(_screenNum), swapInterval(1){
 
     std::vector<ScreenInfo> screenInfo = OpenGLContext::GetScreenInfo();
     screenResX = screenInfo[screenNum].resX;
@@ -213,6 +213,17 @@ void OpenGLContext::makeContextCurrent(){
     wglMakeCurrent(contextInfo->hdc, contextInfo->hglrc);
 }
 
+void OpenGLContext::setSwapInterval(int interval){
+    wglMakeCurrent(contextInfo->hdc, contextInfo->hglrc);
+
+    typedef BOOL (WINAPI *PFNWGLSWAPINTERVALEXTPROC)(int);
+    PFNWGLSWAPINTERVALEXTPROC SwapIntervalEXT = (PFNWGLSWAPINTERVALEXTPROC)wglGetProcAddress("wglSwapIntervalEXT");
+    if(SwapIntervalEXT && SwapIntervalEXT(interval))
+        swapInterval = interval;
+    else
+        std::cerr << "OpenGLContext.Win Error: Could not set swap interval!" << std::endl;
+}
+
 void OpenGLContext::flush(){
     // Swap buffers
     SwapBuffers(contextInfo->hdc);
@@ -32,10 +32,15 @@ class OpenGLContext{
         unsigned int getScreenResY(){return screenResY;}
         ~OpenGLContext();
         void makeContextCurrent();
+        // Queue a buffer swap. Does not wait for the flip to happen.
         void flush();
+        // Number of vertical blanks per buffer swap, 0 disables vsync
+        void setSwapInterval(int interval);
+        int getSwapInterval(){return swapInterval;}
     private:
         unsigned int screenNum;
         unsigned int screenResX, screenResY;
+        int swapInterval;
         // Opaque data type defined in platform specific files
         struct OpenGLContextInfo;
         OpenGLContextInfo *contextInfo;
@@ -6,6 +6,8 @@
 #include <string>
 #include <vector>
 
+struct PatternDescriptor;
+
 // Abstract Projector base class
 class Projector {
  public:
@@ -15,6 +17,25 @@ class Projector {
   virtual void setPattern(unsigned int patternNumber, const unsigned char *tex,
                           unsigned int texWidth, unsigned int texHeight) = 0;
   virtual void displayPattern(unsigned int patternNumber) = 0;
+  // Define preset pattern to be rendered procedurally. Returns false if not
+  // supported, in which case the pattern must be defined with setPattern
+  virtual bool setPatternProcedural(unsigned int patternNumber,
+                                    const PatternDescriptor &pattern) {
+    return false;
+  }
+  // Id of the frame queued by the last display call. Projectors which only
+  // return once the frame is displayed need not track frames.
+  virtual unsigned long getFrameId() { return 0; }
+  // True once frame id is on screen (non-blocking)
+  virtual bool isFrameComplete(unsigned long id) { return true; }
+  // Blocks until frame id is on screen or timeout [ms] expires. Returns false
+  // on timeout.
+  virtual bool waitFrameComplete(unsigned long id, unsigned int timeout) {
+    return true;
+  }
+  // True if the projector steps through the pattern sequence by itself once
+  // pattern 0 is displayed, such that the camera can collect it in one batch
+  virtual bool isSequencing() { return false; }
   // Upload and display pattern on the fly
   virtual void displayTexture(const unsigned char *tex, unsigned int width,
                               unsigned int height) = 0;
@@ -28,7 +49,12 @@ class Projector {
   virtual void init() {
   }  // Allows for additional configurations after load_params is called
 
-  virtual std::shared_ptr<void> getOutput(const std::string &output_name) {}
+  // Outputs may be consumed by getOutput(), hasOutput() only tells whether
+  // the projector provides them
+  virtual std::shared_ptr<void> getOutput(const std::string &output_name) {
+    return nullptr;
+  }
+  virtual bool hasOutput(const std::string &output_name) { return false; }
 };
 
 #endif
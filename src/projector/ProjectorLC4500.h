@@ -15,6 +15,7 @@ class ProjectorLC4500 : public Projector {
         // Define preset pattern sequence and upload to GPU
         void setPattern(unsigned int patternNumber, const unsigned char *tex, unsigned int texWidth, unsigned int texHeight);
         void displayPattern(unsigned int patternNumber);
+        bool isSequencing(){return true;}
         // Upload and display pattern on the fly
         void displayTexture(const unsigned char *tex, unsigned int width, unsigned int height);
         void displayBlack();
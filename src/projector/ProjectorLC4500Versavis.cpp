@@ -52,10 +52,12 @@ void ProjectorLC4500Versavis::displayPattern(unsigned int pattern_no) {
     // trigger was detected slightly earlier than this function was called, we
     // just take it that is ok to proceed
     if (m_first_time_hardware_triggered) {
+      boost::mutex::scoped_lock lock(m_mutex);
       auto current = std::chrono::system_clock::now();
-      std::chrono::duration<double> duration = current - m_buffer.first;
+      std::chrono::duration<double> duration =
+          current - m_trigger_history.back().first;
       if (duration.count() < m_trigger_tolerance) {
-        m_trigger_time = m_buffer.second;
+        m_trigger_time = m_trigger_history.back().second;
         return;
       }
     }
@@ -88,7 +90,10 @@ void ProjectorLC4500Versavis::displayPattern(unsigned int pattern_no) {
       }
     }
 
-    m_trigger_time = m_buffer.second;
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      m_trigger_time = m_trigger_history.back().second;
+    }
 
     // std::cout << std::endl;
 
@@ -118,31 +123,9 @@ void ProjectorLC4500Versavis::displayTexture(const unsigned char *tex,
                                               unsigned int texHeight) {}
 
 void ProjectorLC4500Versavis::displayBlack() {
-  std::vector<single_pattern> pattern_vec = {};
-
-  // Settings for black pattern (pattern number 24, bit depth 1)
-  single_pattern temp;
-  temp.trigger_type = m_is_hardware_triggered ? 1 : 0;
-  temp.pattern_number = 24;
-  temp.bit_depth = 1;
-  temp.led_select = 7;
-  temp.image_indice = 0;
-  temp.invert_pattern = false;
-  temp.insert_black_frame = false;
-  temp.buffer_swap = true;
-  temp.trigger_out_prev = false;
-
-  unsigned int exposure_period = m_is_hardware_triggered
-                                     ? m_hardware_triggered_timings_us[0]
-                                     : m_software_trigger_timings_us[0];
-
-  unsigned int frame_period = m_is_hardware_triggered
-                                  ? m_hardware_triggered_timings_us[1]
-                                  : m_software_trigger_timings_us[1];
-
-  pattern_vec.push_back(temp);
-
-  m_projector.play_pattern_sequence(pattern_vec, exposure_period, frame_period);
+  // Switching off the LEDs keeps the pattern sequence on the projector, such
+  // that the next scan does not need to upload it again
+  m_projector.blank();
 }
 
 void ProjectorLC4500Versavis::display_8_bit_image(int image_indice,
@@ -229,8 +212,14 @@ void ProjectorLC4500Versavis::sub_cb(
 
   boost::mutex::scoped_lock lock(m_mutex);
   m_counter = time_numbered_ptr->number;
-  m_buffer.first = std::chrono::system_clock::now();
-  m_buffer.second = time_numbered_ptr->time;
+  m_trigger_history.push_back(std::make_pair(std::chrono::system_clock::now(),
+                                             time_numbered_ptr->time));
+  if (m_trigger_history.size() > m_trigger_history_size)
+    m_trigger_history.pop_front();
+
+  // Bounded, in case nobody collects them
+  if (m_pending_sequence_start_times.size() < m_trigger_history_size)
+    m_pending_sequence_start_times.push_back(time_numbered_ptr->time.toSec());
 
   // std::cout << "Versavis counter: " << m_counter << std::endl;
 }
@@ -449,11 +438,31 @@ std::shared_ptr<void> ProjectorLC4500Versavis::getOutput(
     // Multiply by factor of 2 because remember we display 2 exposures on
     // the projector, for 30Hz, we are displaying 4 exposures instead
 
+  } else if (output_name == "sequence_start_times") {
+    // Trigger times received since the last call, for sequence alignment
+    boost::mutex::scoped_lock mutex_lock(m_mutex);
+    auto times = std::make_shared<std::vector<double> >();
+    times->swap(m_pending_sequence_start_times);
+    return std::static_pointer_cast<void>(times);
+
+  } else if (output_name == "image_period") {
+    // Time between consecutive camera images within a hardware triggered
+    // sequence
+    return std::static_pointer_cast<void>(std::make_shared<ros::Duration>(
+        0, m_hardware_triggered_timings_us[0] *
+               ((m_is_30_hz_8333_us_exposure) ? 4 : 2) * 1000));
+
   } else {
     return nullptr;
   }
 }
 
+bool ProjectorLC4500Versavis::hasOutput(const std::string &output_name) {
+  return output_name == "expected_image_time" ||
+         output_name == "sequence_start_times" ||
+         output_name == "image_period";
+}
+
 std::vector<single_pattern>
 ProjectorLC4500Versavis::getScanningPattern2Plus1Software() {
   std::vector<single_pattern> pattern_vec = {};
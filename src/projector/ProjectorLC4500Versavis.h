@@ -3,6 +3,7 @@
 
 #include <sys/types.h>
 #include <chrono>
+#include <deque>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -27,6 +28,7 @@ class ProjectorLC4500Versavis : public Projector {
   void setPattern(unsigned int patternNumber, const unsigned char *tex,
                   unsigned int texWidth, unsigned int texHeight);
   void displayPattern(unsigned int patternNumber);
+  bool isSequencing() { return m_is_hardware_triggered; }
   //  Upload and display pattern on the fly
   void displayTexture(const unsigned char *tex, unsigned int width,
                       unsigned int height);
@@ -54,6 +56,7 @@ class ProjectorLC4500Versavis : public Projector {
 
   virtual std::shared_ptr<void> getOutput(
       const std::string &output_name) override;
+  virtual bool hasOutput(const std::string &output_name) override;
 
   void startProjection();
 
@@ -100,8 +103,13 @@ class ProjectorLC4500Versavis : public Projector {
   bool m_display_horizontal_pattern = true;
   bool m_display_vertical_pattern = true;
 
-  std::pair<std::chrono::time_point<std::chrono::system_clock>, ros::Time>
-      m_buffer;
+  // Recent triggers (time received, versavis trigger time), newest last
+  std::deque<
+      std::pair<std::chrono::time_point<std::chrono::system_clock>, ros::Time> >
+      m_trigger_history;
+  const size_t m_trigger_history_size = 64;
+  // Sequence start times [s] not yet handed out by getOutput()
+  std::vector<double> m_pending_sequence_start_times;
   ros::Time m_trigger_time;
   int m_pattern_no = -1;
   double m_trigger_tolerance = 0.01;
@@ -1,7 +1,125 @@
 #include "ProjectorOpenGL.h"
 
+#include <algorithm>
+#include <cstring>
+
+// Upload buffers in the ring, one is written while the others are in transfer
+static const size_t nUploadBuffers = 3;
+// Flips queued ahead of the display with and without vsync
+static const size_t maxPendingFramesVsync = 2;
+static const size_t maxPendingFrames = 16;
+
+static const GLchar *patternVertexShaderSource =
+    "#version 130\n"
+    "void main(){\n"
+    "    gl_Position = ftransform();\n"
+    "}\n";
+
+// Renders PatternDescriptor patterns. Each screen pixel samples the ideal pattern at the position given
+// by the inverse projector lens distortion, as the remap with cvtools::initDistortMap() does on the CPU.
+static const GLchar *patternFragmentShaderSource =
+    "#version 130\n"
+    "uniform vec2 screenRes;\n"
+    "uniform vec2 patternSize;\n"
+    "uniform bool diamond;\n"
+    "uniform bool undistort;\n"
+    "uniform vec4 Kp;\n"           // fx, fy, ux, uy
+    "uniform float kp[5];\n"       // k1, k2, p1, p2, k3
+    "uniform int type;\n"
+    "uniform bool vertical;\n"
+    "uniform float offset;\n"
+    "uniform float amplitude;\n"
+    "uniform float pitch;\n"
+    "uniform float phase;\n"
+    "uniform int bit;\n"
+    "void main(){\n"
+    "    // Pixel coordinates with origin in the upper left corner\n"
+    "    vec2 pixel = vec2(floor(gl_FragCoord.x), screenRes.y - 1.0 - floor(gl_FragCoord.y));\n"
+    "    if(diamond)\n"
+    "        pixel.x = 2.0*pixel.x + mod(pixel.y, 2.0);\n"
+    "    vec2 src = pixel;\n"
+    "    if(undistort){\n"
+    "        vec2 p = (pixel - Kp.zw)/Kp.xy;\n"
+    "        float r2 = dot(p, p);\n"
+    "        float radial = 1.0 + kp[0]*r2 + kp[1]*r2*r2 + kp[4]*r2*r2*r2;\n"
+    "        vec2 tangential = vec2(2.0*kp[2]*p.x*p.y + kp[3]*(r2 + 2.0*p.x*p.x),\n"
+    "                               kp[2]*(r2 + 2.0*p.y*p.y) + 2.0*kp[3]*p.x*p.y);\n"
+    "        vec2 displaced = (p*radial + tangential)*Kp.xy + Kp.zw;\n"
+    "        src = 2.0*pixel - displaced;\n"
+    "    }\n"
+    "    float value = 0.0;\n"
+    "    if(all(greaterThanEqual(src, vec2(0.0))) && all(lessThanEqual(src, patternSize - 1.0))){\n"
+    "        float x = vertical ? src.y : src.x;\n"
+    "        if(type == 1){\n"
+    "            value = offset + amplitude*cos(6.28318530718*x/pitch - phase);\n"
+    "        } else if(type == 2){\n"
+    "            int code = int(floor(x + 0.5));\n"
+    "            value = float(((code ^ (code >> 1)) >> bit) & 1);\n"
+    "        } else {\n"
+    "            value = offset;\n"
+    "        }\n"
+    "    }\n"
+    "    gl_FragColor = vec4(value, value, value, 1.0);\n"
+    "}\n";
+
+static GLuint compileShader(GLenum shaderType, const GLchar *source){
+
+    GLuint shader = glCreateShader(shaderType);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    GLint status;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if(status != GL_TRUE){
+        GLint len = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
+        std::vector<GLchar> log(len+1, 0);
+        glGetShaderInfoLog(shader, len, NULL, &log[0]);
+        std::cerr << "ProjectorOpenGL: Could not compile shader!" << std::endl << &log[0] << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+GLuint ProjectorOpenGL::createPatternShader(){
+
+    if(!GLEW_VERSION_3_0)
+        return 0;
 
-ProjectorOpenGL::ProjectorOpenGL(unsigned int _screenNum){
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, patternVertexShaderSource);
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, patternFragmentShaderSource);
+    if(!vertexShader || !fragmentShader){
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if(status != GL_TRUE){
+        std::cerr << "ProjectorOpenGL: Could not link pattern shader!" << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+ProjectorOpenGL::ProjectorOpenGL(unsigned int _screenNum) : shaderProgram(0), diamondPattern(false), streamTexture(0), streamTextureWidth(0), streamTextureHeight(0),
+                                                               uploadBufferSize(0), nextUploadBuffer(0), hasSync(false), frameId(0){
+
+    // No distortion until calibration parameters are loaded
+    std::fill(Kp, Kp+4, 0.0f);
+    std::fill(kp, kp+5, 0.0f);
 
     // Create the OpenGL context
     context = new OpenGLContext(_screenNum);
@@ -22,78 +140,201 @@ ProjectorOpenGL::ProjectorOpenGL(unsigned int _screenNum){
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
     
-    // Set up fragment shader
     GLenum err = glewInit();
     if(err != GLEW_OK)
         std::cerr << "ProjectorOpenGL: Could not initialize GLEW!" << std::endl;
 
-//    const GLchar *vertexShaderSource =
-//    "void main(){\n"
-//    "    gl_Position = ftransform();\n"
-//    "}";
-
-
-//    const GLchar *fragmentShaderSource =
-//    "uniform sampler2D texture;\n"
-//    "void main(void){\n"
-//    "   gl_FragColor = texture2D(texture, gl_TexCoord[0].st);\n"
-//    "}";
-
-//    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-//    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-//    glCompileShader(vertexShader);
-//    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-//    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-//    glCompileShader(fragmentShader);
-
-//    GLint status;
-//    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &status);
-//    if(status != GL_TRUE)
-//        std::cerr << "ProjectorOpenGL: Could not compile vertex shader!" << std::endl;
-
-//    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &status);
-//    if(status != GL_TRUE)
-//        std::cerr << "ProjectorOpenGL: Could not compile fragment shader!" << std::endl;
-
-//    int len = 0;
-//    glGetShaderiv(vertexShader, GL_INFO_LOG_LENGTH, &len);
-//    char* log = new char[len];
-//    glGetShaderInfoLog(vertexShader, len, NULL, log);
-//    std::cout << log << std::endl;
-
-//    glGetShaderiv(fragmentShader, GL_INFO_LOG_LENGTH, &len);
-//    glGetShaderInfoLog(fragmentShader, len, NULL, log);
-//    std::cout << log << std::endl;
-
-//    shaderProgram = glCreateProgram();
-//    glAttachShader(shaderProgram, vertexShader);
-//    glAttachShader(shaderProgram, fragmentShader);
-//    glLinkProgram(shaderProgram);
-//    glUseProgram(shaderProgram);
+    shaderProgram = createPatternShader();
+
+    // Texture all patterns are streamed through
+    glGenTextures(1, &streamTexture);
+    glBindTexture(GL_TEXTURE_2D, streamTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_FALSE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    // Ring of pixel unpack buffers for asynchronous uploads. Each holds one full screen RGB texture.
+    // With ARB_buffer_storage, buffers are mapped once and stay mapped (persistent, coherent).
+    hasSync = GLEW_ARB_sync;
+    if(hasSync && GLEW_ARB_pixel_buffer_object){
+        bool persistent = GLEW_ARB_buffer_storage;
+        uploadBufferSize = 3*context->getScreenResX()*context->getScreenResY();
+        uploadBuffers.resize(nUploadBuffers);
+        for(unsigned int i=0; i<uploadBuffers.size(); i++){
+            glGenBuffers(1, &uploadBuffers[i].buffer);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffers[i].buffer);
+            if(persistent){
+                GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                glBufferStorage(GL_PIXEL_UNPACK_BUFFER, uploadBufferSize, NULL, flags);
+                uploadBuffers[i].mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, uploadBufferSize, flags);
+            } else {
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, uploadBufferSize, NULL, GL_STREAM_DRAW);
+            }
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if(!persistent)
+            std::cout << "ProjectorOpenGL: ARB_buffer_storage not supported, mapping upload buffers per frame." << std::endl;
+    } else {
+        std::cerr << "ProjectorOpenGL: pixel buffer objects or sync objects not supported, uploading synchronously." << std::endl;
+    }
 
     context->flush();
 }
 
+bool ProjectorOpenGL::waitFence(GLsync fence, GLuint64 timeout){
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    return (result == GL_ALREADY_SIGNALED) || (result == GL_CONDITION_SATISFIED);
+}
+
+void ProjectorOpenGL::uploadTexture(const unsigned char *tex, unsigned int texWidth, unsigned int texHeight){
+
+    glBindTexture(GL_TEXTURE_2D, streamTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // Texture storage is only reallocated when the pattern size changes
+    if(texWidth != streamTextureWidth || texHeight != streamTextureHeight){
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texWidth, texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        streamTextureWidth = texWidth;
+        streamTextureHeight = texHeight;
+    }
+
+    size_t size = 3*texWidth*texHeight;
+    if(uploadBuffers.empty() || size > uploadBufferSize){
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texWidth, texHeight, GL_RGB, GL_UNSIGNED_BYTE, tex);
+        return;
+    }
+
+    UploadBuffer &uploadBuffer = uploadBuffers[nextUploadBuffer];
+    nextUploadBuffer = (nextUploadBuffer+1) % uploadBuffers.size();
+
+    // Normally signaled long ago, the ring is only exhausted if the GPU falls behind
+    if(uploadBuffer.fence){
+        if(!waitFence(uploadBuffer.fence, 1000000000))
+            std::cerr << "ProjectorOpenGL: timeout waiting for upload buffer!" << std::endl;
+        glDeleteSync(uploadBuffer.fence);
+        uploadBuffer.fence = 0;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer.buffer);
+
+    if(uploadBuffer.mapped){
+        memcpy(uploadBuffer.mapped, tex, size);
+    } else {
+        // The fence guarantees the GPU is done with this buffer, no implicit synchronization needed
+        void *ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        memcpy(ptr, tex, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    // Transfer from the pixel buffer (offset 0) runs asynchronously on the GPU
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texWidth, texHeight, GL_RGB, GL_UNSIGNED_BYTE, (const GLvoid*)0);
+    uploadBuffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void ProjectorOpenGL::drawTexture(unsigned int texWidth, unsigned int texHeight){
+
+    float texWidthf = (float)context->getScreenResX()/texWidth;
+    float texHeightf = (float)context->getScreenResY()/texHeight;
+
+    glBegin(GL_QUADS);
+        glTexCoord2f(0, 0); glVertex2i(0, 0);
+        glTexCoord2f(texWidthf, 0); glVertex2i(1, 0);
+        glTexCoord2f(texWidthf, texHeightf); glVertex2i(1, 1);
+        glTexCoord2f(0, texHeightf); glVertex2i(0, 1);
+    glEnd();
+}
+
+void ProjectorOpenGL::present(){
+
+    if(!hasSync){
+        context->flush();
+        frameId++;
+        return;
+    }
+
+    // With vsync, every queued flip occupies one refresh. Bounding the number of pending flips
+    // keeps the swap from blocking inside the driver, so it returns as soon as the flip is queued.
+    size_t maxPending = context->getSwapInterval() > 0 ? maxPendingFramesVsync : maxPendingFrames;
+    while(frameFences.size() >= maxPending){
+        waitFence(frameFences.front().second, 1000000000);
+        glDeleteSync(frameFences.front().second);
+        frameFences.pop_front();
+    }
+
+    context->flush();
+
+    // Signaled once the GPU has executed the flip
+    frameId++;
+    frameFences.push_back(std::make_pair(frameId, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)));
+    glFlush();
+}
+
+void ProjectorOpenGL::setSwapInterval(int interval){
+    context->setSwapInterval(interval);
+}
+
+bool ProjectorOpenGL::isFrameComplete(unsigned long id){
+    return waitFrameComplete(id, 0);
+}
+
+bool ProjectorOpenGL::waitFrameComplete(unsigned long id, unsigned int timeout){
+
+    if(id > frameId)
+        return false;
+
+    context->makeContextCurrent();
+
+    if(!hasSync){
+        glFinish();
+        return true;
+    }
+
+    // Fences signal in order and are retired once signaled
+    if(frameFences.empty() || id < frameFences.front().first)
+        return true;
+
+    size_t k = id - frameFences.front().first;
+    if(!waitFence(frameFences[k].second, (GLuint64)timeout*1000000))
+        return false;
+
+    for(size_t i=0; i<=k; i++)
+        glDeleteSync(frameFences[i].second);
+    frameFences.erase(frameFences.begin(), frameFences.begin()+k+1);
+
+    return true;
+}
+
 void ProjectorOpenGL::setPattern(unsigned int patternNumber, const unsigned char *tex, unsigned int texWidth, unsigned int texHeight){
 
+    if(patternNumber > patterns.size()){
+        std::cerr << "ProjectorOpenGL: cannot set pattern " << patternNumber << " before setting " << patterns.size() << " -- " << patternNumber-1 << std::endl;
+        return;
+    }
+
     context->makeContextCurrent();
 
-    if(patternNumber+1 == frameBuffers.size()+1){
+    if(patternNumber == patterns.size())
+        patterns.push_back(Pattern());
+
+    Pattern &pattern = patterns[patternNumber];
+    pattern.procedural = false;
 
-        GLuint frameBuffer;
+    if(pattern.frameBuffer == 0){
 
         // Generate frame buffer object
-        glGenFramebuffers(1, &frameBuffer);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frameBuffer);
-        frameBuffers.push_back(frameBuffer);
+        glGenFramebuffers(1, &pattern.frameBuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, pattern.frameBuffer);
 
         // Generate render buffer object to store pixel data
-        GLuint renderBuffer;
-        glGenRenderbuffers(1,&renderBuffer);
-        glBindRenderbuffer(GL_RENDERBUFFER, renderBuffer);
+        glGenRenderbuffers(1, &pattern.renderBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, pattern.renderBuffer);
         glRenderbufferStorage(GL_RENDERBUFFER,GL_RGBA8, context->getScreenResX(), context->getScreenResY());
 
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, pattern.renderBuffer);
 
         GLint status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
         if (status != GL_FRAMEBUFFER_COMPLETE)
@@ -101,42 +342,83 @@ void ProjectorOpenGL::setPattern(unsigned int patternNumber, const unsigned char
         else
           std::cout << "Framebuffer Complete" << std::endl;
 
-    } else if (patternNumber < frameBuffers.size()) {
+    } else {
 
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frameBuffers[patternNumber]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, pattern.frameBuffer);
 
-    } else if (patternNumber+1 > frameBuffers.size()+1){
+    }
 
-        std::cerr << "ProjectorOpenGL: cannot set pattern " << patternNumber << " before setting " << frameBuffers.size() << " -- " << patternNumber-1 << std::endl;
-        return;
+    // Render pattern into buffer
+    uploadTexture(tex, texWidth, texHeight);
+    drawTexture(texWidth, texHeight);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+bool ProjectorOpenGL::setPatternProcedural(unsigned int patternNumber, const PatternDescriptor &descriptor){
 
+    if(shaderProgram == 0)
+        return false;
+
+    if(patternNumber > patterns.size()){
+        std::cerr << "ProjectorOpenGL: cannot set pattern " << patternNumber << " before setting " << patterns.size() << " -- " << patternNumber-1 << std::endl;
+        return false;
     }
 
-    // Render pattern into buffer
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texWidth, texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, tex);
+    context->makeContextCurrent();
 
-    glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_FALSE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    if(patternNumber == patterns.size())
+        patterns.push_back(Pattern());
 
-    float texWidthf = (float)context->getScreenResX()/texWidth;
-    float texHeightf = (float)context->getScreenResY()/texHeight;
+    // Procedural patterns need no frame buffer
+    Pattern &pattern = patterns[patternNumber];
+    if(pattern.frameBuffer){
+        glDeleteFramebuffers(1, &pattern.frameBuffer);
+        glDeleteRenderbuffers(1, &pattern.renderBuffer);
+        pattern.frameBuffer = 0;
+        pattern.renderBuffer = 0;
+    }
+    pattern.procedural = true;
+    pattern.descriptor = descriptor;
+
+    return true;
+}
+
+void ProjectorOpenGL::drawProcedural(const PatternDescriptor &descriptor){
+
+    glUseProgram(shaderProgram);
+
+    float screenResX = context->getScreenResX();
+    float screenResY = context->getScreenResY();
+
+    glUniform2f(glGetUniformLocation(shaderProgram, "screenRes"), screenResX, screenResY);
+    glUniform2f(glGetUniformLocation(shaderProgram, "patternSize"), diamondPattern ? 2*screenResX : screenResX, screenResY);
+    glUniform1i(glGetUniformLocation(shaderProgram, "diamond"), diamondPattern);
+    glUniform1i(glGetUniformLocation(shaderProgram, "undistort"), Kp[0] != 0.0 && Kp[1] != 0.0);
+    glUniform4fv(glGetUniformLocation(shaderProgram, "Kp"), 1, Kp);
+    glUniform1fv(glGetUniformLocation(shaderProgram, "kp"), 5, kp);
+
+    glUniform1i(glGetUniformLocation(shaderProgram, "type"), descriptor.type);
+    glUniform1i(glGetUniformLocation(shaderProgram, "vertical"), descriptor.dir == CodecDirVertical);
+    glUniform1f(glGetUniformLocation(shaderProgram, "offset"), descriptor.offset);
+    glUniform1f(glGetUniformLocation(shaderProgram, "amplitude"), descriptor.amplitude);
+    glUniform1f(glGetUniformLocation(shaderProgram, "pitch"), descriptor.pitch);
+    glUniform1f(glGetUniformLocation(shaderProgram, "phase"), descriptor.phase);
+    glUniform1i(glGetUniformLocation(shaderProgram, "bit"), descriptor.bit);
 
     glBegin(GL_QUADS);
-        glTexCoord2f(0, 0); glVertex2i(0, 0);
-        glTexCoord2f(texWidthf, 0); glVertex2i(1, 0);
-        glTexCoord2f(texWidthf, texHeightf); glVertex2i(1, 1);
-        glTexCoord2f(0, texHeightf); glVertex2i(0, 1);
+        glVertex2i(0, 0);
+        glVertex2i(1, 0);
+        glVertex2i(1, 1);
+        glVertex2i(0, 1);
     glEnd();
 
+    glUseProgram(0);
 }
 
 void ProjectorOpenGL::displayPattern(unsigned int patternNumber){
 
-    if(patternNumber+1 > frameBuffers.size()){
+    if(patternNumber+1 > patterns.size()){
         std::cerr << "ProjectorOpenGL: cannot display pattern " << patternNumber << "! Out of bounds." << std::endl;
         return;
     }
@@ -144,58 +426,55 @@ void ProjectorOpenGL::displayPattern(unsigned int patternNumber){
     context->makeContextCurrent();
 
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, frameBuffers[patternNumber]);
-
-    glBlitFramebuffer(0, 0, context->getScreenResX(), context->getScreenResY(), 0, 0, context->getScreenResX(), context->getScreenResY(), GL_COLOR_BUFFER_BIT, GL_NEAREST);
-
-//    glClear(GL_COLOR_BUFFER_BIT);
 
-    //glBindTexture(GL_TEXTURE_2D, textures[patternNumber].texName);
+    const Pattern &pattern = patterns[patternNumber];
+    if(pattern.procedural){
+        drawProcedural(pattern.descriptor);
+    } else {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, pattern.frameBuffer);
+        glBlitFramebuffer(0, 0, context->getScreenResX(), context->getScreenResY(), 0, 0, context->getScreenResX(), context->getScreenResY(), GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
 
-//    GLint locTex = glGetUniformLocation(shaderProgram, "texture");
-//    glUniform1i(locTex, 0);
+    present();
+}
 
-    context->flush();
+void ProjectorOpenGL::loadParam(const std::string &param_name, std::shared_ptr<void> param_ptr){
+
+    // Projector lens distortion and pixel layout applied to procedural patterns
+    if(param_name == "projector_Kp"){
+        cv::Matx33f K = *std::static_pointer_cast<cv::Matx33f>(param_ptr);
+        Kp[0] = K(0,0); Kp[1] = K(1,1); Kp[2] = K(0,2); Kp[3] = K(1,2);
+    } else if(param_name == "projector_kp"){
+        cv::Vec<float, 5> k = *std::static_pointer_cast< cv::Vec<float, 5> >(param_ptr);
+        for(unsigned int i=0; i<5; i++)
+            kp[i] = k[i];
+    } else if(param_name == "diamond_pattern"){
+        diamondPattern = *std::static_pointer_cast<bool>(param_ptr);
+    }
 }
 
 void ProjectorOpenGL::displayTexture(const unsigned char *tex, unsigned int texWidth, unsigned int texHeight){
 
     context->makeContextCurrent();
 
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texWidth, texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, tex);
-    
-//    glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_FALSE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    
-    float texWidthf = (float)context->getScreenResX()/texWidth;
-    float texHeightf = (float)context->getScreenResY()/texHeight;
-    
-    glBegin(GL_QUADS);
-        glTexCoord2f(0, 0); glVertex2i(0, 0);
-        glTexCoord2f(texWidthf, 0); glVertex2i(1, 0);
-        glTexCoord2f(texWidthf, texHeightf); glVertex2i(1, 1);
-        glTexCoord2f(0, texHeightf); glVertex2i(0, 1);
-    glEnd();
-    
-    context->flush();
+    uploadTexture(tex, texWidth, texHeight);
+    drawTexture(texWidth, texHeight);
+
+    present();
 }
 
 void ProjectorOpenGL::displayBlack(){
     context->makeContextCurrent();
     glClearColor(0.0, 0.0, 0.0, 1.0);
     glClear(GL_COLOR_BUFFER_BIT);
-    context->flush();
+    present();
 }
 
 void ProjectorOpenGL::displayWhite(){
     context->makeContextCurrent();
     glClearColor(1.0, 1.0, 1.0, 1.0);
     glClear(GL_COLOR_BUFFER_BIT);
-    context->flush();
+    present();
 }
 
 void ProjectorOpenGL::getScreenRes(unsigned int *nx, unsigned int *ny){
@@ -205,6 +484,32 @@ void ProjectorOpenGL::getScreenRes(unsigned int *nx, unsigned int *ny){
 
 ProjectorOpenGL::~ProjectorOpenGL(){
     context->makeContextCurrent();
+
+    for(unsigned int i=0; i<frameFences.size(); i++)
+        glDeleteSync(frameFences[i].second);
+
+    for(unsigned int i=0; i<uploadBuffers.size(); i++){
+        if(uploadBuffers[i].fence)
+            glDeleteSync(uploadBuffers[i].fence);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffers[i].buffer);
+        if(uploadBuffers[i].mapped)
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glDeleteBuffers(1, &uploadBuffers[i].buffer);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    glDeleteTextures(1, &streamTexture);
+
+    for(unsigned int i=0; i<patterns.size(); i++){
+        if(patterns[i].frameBuffer){
+            glDeleteFramebuffers(1, &patterns[i].frameBuffer);
+            glDeleteRenderbuffers(1, &patterns[i].renderBuffer);
+        }
+    }
+
+    if(shaderProgram)
+        glDeleteProgram(shaderProgram);
+
     delete context;
 }
 
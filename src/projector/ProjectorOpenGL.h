@@ -3,12 +3,14 @@
 
 #include <iostream>
 #include <vector>
+#include <deque>
 #include <sys/types.h>
 
 #include <GL/glew.h>
 
 #include "Projector.h"
 #include "OpenGLContext.h"
+#include "Codec.h"
 
 
 // ProjectorOpenGL implementations
@@ -19,16 +21,69 @@ class ProjectorOpenGL : public Projector {
         // Define preset pattern sequence and upload to GPU
         void setPattern(unsigned int patternNumber, const unsigned char *tex, unsigned int texWidth, unsigned int texHeight);
         void displayPattern(unsigned int patternNumber);
-        // Upload and display pattern on the fly
+        // Pattern rendered by a fragment shader on display, needs no pattern memory
+        bool setPatternProcedural(unsigned int patternNumber, const PatternDescriptor &pattern);
+        // Upload and display pattern on the fly. Returns once the texture is copied
+        // into the upload ring and the flip is queued, the GPU transfer is asynchronous.
         void displayTexture(const unsigned char *tex, unsigned int width, unsigned int height);
         void displayBlack();
         void displayWhite();
         void getScreenRes(unsigned int *nx, unsigned int *ny);
+        // Number of vertical blanks per flip, 0 disables vsync
+        void setSwapInterval(int interval);
+        // Id of the frame queued by the last display call
+        unsigned long getFrameId(){return frameId;}
+        // True once the GPU has executed the flip of frame id (non-blocking)
+        bool isFrameComplete(unsigned long id);
+        // Blocks until frame id is complete or timeout [ms] expires
+        bool waitFrameComplete(unsigned long id, unsigned int timeout);
+        // "projector_Kp" (cv::Matx33f), "projector_kp" (cv::Vec<float, 5>) and "diamond_pattern" (bool)
+        // define the lens distortion and pixel layout of procedural patterns
+        void loadParam(const std::string &param_name, std::shared_ptr<void> param_ptr);
         ~ProjectorOpenGL();
     private:
-        std::vector<GLuint> frameBuffers;
+        // Preset pattern, either stored in a frame buffer or rendered procedurally
+        struct Pattern{
+            GLuint frameBuffer, renderBuffer;
+            bool procedural;
+            PatternDescriptor descriptor;
+            Pattern() : frameBuffer(0), renderBuffer(0), procedural(false){}
+        };
+        struct UploadBuffer{
+            GLuint buffer;
+            // Persistently mapped pointer, NULL if mapped per upload
+            void *mapped;
+            // Signaled once the GPU has consumed the last upload
+            GLsync fence;
+            UploadBuffer() : buffer(0), mapped(NULL), fence(0){}
+        };
+        void uploadTexture(const unsigned char *tex, unsigned int texWidth, unsigned int texHeight);
+        void drawTexture(unsigned int texWidth, unsigned int texHeight);
+        void drawProcedural(const PatternDescriptor &descriptor);
+        void present();
+        GLuint createPatternShader();
+        bool waitFence(GLsync fence, GLuint64 timeout);
+
+        std::vector<Pattern> patterns;
         OpenGLContext *context;
+
+        // Procedural pattern shader, 0 if not supported
         GLuint shaderProgram;
+        float Kp[4]; // fx, fy, ux, uy
+        float kp[5]; // k1, k2, p1, p2, k3
+        bool diamondPattern;
+
+        // Streaming texture fed from a ring of pixel unpack buffers
+        GLuint streamTexture;
+        unsigned int streamTextureWidth, streamTextureHeight;
+        std::vector<UploadBuffer> uploadBuffers;
+        size_t uploadBufferSize;
+        size_t nextUploadBuffer;
+
+        // Fences placed after each queued flip, oldest first
+        bool hasSync;
+        std::deque< std::pair<unsigned long, GLsync> > frameFences;
+        unsigned long frameId;
 };
 
 #endif
@@ -4,6 +4,8 @@ CONFIG += qt qtmain
 TARGET = ProjectorTest
 TEMPLATE = app
 
+INCLUDEPATH += ../codec
+
 HEADERS += Projector.h\
         OpenGLContext.h\
         ProjectorOpenGL.h\
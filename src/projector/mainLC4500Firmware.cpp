@@ -0,0 +1,180 @@
+// Builds a LightCrafter 4500 firmware image holding the patterns of an encoder
+// as splash images. The resulting pattern sequence is printed, such that it can
+// be entered into the projector configuration.
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "CodecFastRatio.h"
+#include "CodecGrayCode.h"
+#include "CodecPhaseShift2p1.h"
+#include "CodecPhaseShift2p1Tpu.h"
+#include "CodecPhaseShift2x3.h"
+#include "CodecPhaseShift3.h"
+#include "CodecPhaseShift3FastWrap.h"
+#include "CodecPhaseShift3Unwrap.h"
+#include "CodecPhaseShift4.h"
+#include "CodecPhaseShiftDescatter.h"
+#include "CodecPhaseShiftMicro.h"
+#include "CodecPhaseShiftModulated.h"
+#include "CodecPhaseShiftNStep.h"
+#include "LC4500PatternImages.h"
+
+static Encoder *createEncoder(const std::string &codec, unsigned int screenCols,
+                              unsigned int screenRows, CodecDir dir) {
+  if (codec == "CodecPhaseShift3")
+    return new EncoderPhaseShift3(screenCols, screenRows, dir);
+  else if (codec == "CodecPhaseShift4")
+    return new EncoderPhaseShift4(screenCols, screenRows, dir);
+  else if (codec == "CodecPhaseShift2x3")
+    return new EncoderPhaseShift2x3(screenCols, screenRows, dir);
+  else if (codec == "CodecPhaseShift3Unwrap")
+    return new EncoderPhaseShift3Unwrap(screenCols, screenRows, dir);
+  else if (codec == "CodecPhaseShiftNStep")
+    return new EncoderPhaseShiftNStep(screenCols, screenRows, dir);
+  else if (codec == "CodecPhaseShift3FastWrap")
+    return new EncoderPhaseShift3FastWrap(screenCols, screenRows, dir);
+  else if (codec == "CodecPhaseShift2p1")
+    return new EncoderPhaseShift2p1(screenCols, screenRows, dir);
+  else if (codec == "CodecPhaseShift2p1Tpu")
+    return new EncoderPhaseShift2p1Tpu(screenCols, screenRows, dir);
+  else if (codec == "CodecPhaseShiftDescatter")
+    return new EncoderPhaseShiftDescatter(screenCols, screenRows, dir);
+  else if (codec == "CodecPhaseShiftModulated")
+    return new EncoderPhaseShiftModulated(screenCols, screenRows, dir);
+  else if (codec == "CodecPhaseShiftMicro")
+    return new EncoderPhaseShiftMicro(screenCols, screenRows, dir);
+  else if (codec == "CodecFastRatio")
+    return new EncoderFastRatio(screenCols, screenRows, dir);
+  else if (codec == "CodecGrayCode")
+    return new EncoderGrayCode(screenCols, screenRows, dir);
+  return NULL;
+}
+
+static void printUsage() {
+  std::cout
+      << "Usage: LC4500Firmware <base firmware> <output firmware> <codec>"
+         " [options]\n"
+         "  --dir <h|v|b>       coding direction (default h)\n"
+         "  --bitdepth <1..8>   bits per pattern (default 8)\n"
+         "  --keep <n>          keep the first n splash images of the base"
+         " firmware (default 0)\n"
+         "  --diamond           diamond pixel layout\n"
+         "  --images <prefix>   also write the packed images as BMP files\n";
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    printUsage();
+    return 1;
+  }
+
+  std::string baseFileName = argv[1];
+  std::string outFileName = argv[2];
+  std::string codec = argv[3];
+  CodecDir dir = CodecDirHorizontal;
+  int bitDepth = 8;
+  int nKeepImages = 0;
+  bool diamond = false;
+  std::string imagePrefix;
+
+  for (int i = 4; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = (i + 1 < argc);
+    if (arg == "--dir" && hasValue) {
+      std::string value = argv[++i];
+      if (value == "v")
+        dir = CodecDirVertical;
+      else if (value == "b")
+        dir = CodecDirBoth;
+    } else if (arg == "--bitdepth" && hasValue) {
+      bitDepth = std::atoi(argv[++i]);
+    } else if (arg == "--keep" && hasValue) {
+      nKeepImages = std::atoi(argv[++i]);
+    } else if (arg == "--diamond") {
+      diamond = true;
+    } else if (arg == "--images" && hasValue) {
+      imagePrefix = argv[++i];
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  // Native resolution of Lightcrafter 4500
+  unsigned int screenResX = 912, screenResY = 1140;
+  unsigned int screenCols = diamond ? 2 * screenResX : screenResX;
+  unsigned int screenRows = screenResY;
+
+  Encoder *encoder = createEncoder(codec, screenCols, screenRows, dir);
+  if (!encoder) {
+    std::cerr << "LC4500Firmware: invalid codec " << codec << std::endl;
+    return 1;
+  }
+
+  std::ifstream baseFile(baseFileName.c_str(), std::ios::binary);
+  if (!baseFile.is_open()) {
+    std::cerr << "LC4500Firmware: could not read " << baseFileName << std::endl;
+    return 1;
+  }
+  std::vector<unsigned char> baseFirmware(
+      (std::istreambuf_iterator<char>(baseFile)),
+      std::istreambuf_iterator<char>());
+
+  int64_t start = cv::getTickCount();
+
+  std::vector<cv::Mat> patterns =
+      lc4500patterns::renderPatterns(encoder, screenCols, screenRows, diamond);
+  delete encoder;
+
+  std::vector<single_pattern> sequence;
+  std::vector<cv::Mat> images = lc4500patterns::packPatterns(
+      patterns, bitDepth, nKeepImages, &sequence);
+  if (images.empty()) return 1;
+
+  double packTime = (cv::getTickCount() - start) / cv::getTickFrequency();
+
+  if (!imagePrefix.empty()) {
+    for (size_t i = 0; i < images.size(); i++)
+      cv::imwrite(cv::format("%s%d.bmp", imagePrefix.c_str(),
+                             (int)(nKeepImages + i)),
+                  images[i]);
+  }
+
+  std::vector<unsigned char> firmware;
+  int error = lc4500patterns::buildFirmware(baseFirmware, images, nKeepImages,
+                                            firmware);
+  if (error != 0) {
+    std::cerr << "LC4500Firmware: could not build firmware: "
+              << lc4500patterns::errorString(error) << std::endl;
+    return 1;
+  }
+
+  double buildTime = (cv::getTickCount() - start) / cv::getTickFrequency();
+
+  std::ofstream outFile(outFileName.c_str(), std::ios::binary);
+  outFile.write((const char *)&firmware[0], firmware.size());
+  if (!outFile) {
+    std::cerr << "LC4500Firmware: could not write " << outFileName
+              << std::endl;
+    return 1;
+  }
+
+  std::cout << patterns.size() << " patterns packed into " << images.size()
+            << " images in " << packTime * 1000.0 << " ms, firmware built in "
+            << buildTime * 1000.0 << " ms" << std::endl;
+  std::cout << "pattern\timage\tpattern number\tbit depth" << std::endl;
+  for (size_t i = 0; i < sequence.size(); i++)
+    std::cout << i << "\t" << sequence[i].image_indice << "\t"
+              << sequence[i].pattern_number << "\t" << sequence[i].bit_depth
+              << std::endl;
+
+  return 0;
+}
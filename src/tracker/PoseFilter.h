@@ -11,9 +11,12 @@
 #include <QObject>
 #include <QTime>
 
-#include <opencv2/video/tracking.hpp>
 #include <Eigen/Eigen>
 
+#include "PoseFilterEKF.h"
+
+// Qt wrapper around PoseFilterEKF for use in a processing chain (across threads)
+// Time deltas are measured on arrival. Use PoseFilterEKF directly for synchronous filtering.
 class PoseFilter : public QObject{
     Q_OBJECT
 
@@ -21,6 +24,7 @@ class PoseFilter : public QObject{
         PoseFilter();
         ~PoseFilter();
         void filterPoseEstimate(const Eigen::Affine3f &Told, Eigen::Affine3f &Tnew);
+        void predictPose(Eigen::Affine3f &Tpred) const;
     public slots:
         void filterPoseEstimate(Eigen::Affine3f T);
     signals:
@@ -29,14 +33,9 @@ class PoseFilter : public QObject{
         //void imshow(const char* windowName, cv::Mat im, unsigned int x, unsigned int y);
     private:
         QTime time;
-
-        // Extended Kalman filter structures
-        // Notation according to Goddard "Pose and Motion Estimation...", U Tennessee, 1997
-        Eigen::Matrix<float, 13, 1> s; // state [tx,ty,tz,qw,qx,qy,qz,vx,xy,vz,ox,oy,oz]
-        Eigen::Matrix<float, 13, 13> Q; // process noise covariance matrix (Q)
-        Eigen::Matrix<float, 7, 7> R; // measurement noise covariance matrix (R)
-        Eigen::Matrix<float, 13, 13> P; // error covariance
-
+        PoseFilterEKF ekf;
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
 
 #endif // PoseFilter_H
@@ -0,0 +1,193 @@
+/*
+ *
+ MVTracker - Multi View Tracking for Pose Estimation
+ (c) 2014 Jakob Wilm, DTU, Kgs.Lyngby, Denmark
+ *
+*/
+
+#ifndef PoseFilterEKF_H
+#define PoseFilterEKF_H
+
+#include <Eigen/Eigen>
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <cmath>
+
+// Synchronous constant velocity pose filter (extended Kalman filter)
+// Header only and free of Qt, such that it can be used directly in the tracking loop.
+// All matrices are fixed size, hence predict() and update() do not allocate.
+class PoseFilterEKF {
+    public:
+        typedef Eigen::Matrix<float, 13, 1> State;
+        typedef Eigen::Matrix<float, 13, 13> StateMatrix;
+        typedef Eigen::Matrix<float, 7, 1> Measurement;
+
+        PoseFilterEKF(){
+            reset();
+        }
+
+        void reset(){
+            // Set initial state
+            s.setZero();
+            s(3) = 1.0;
+
+            // Set process variances
+            Q = 0.5 * StateMatrix::Identity();
+
+            // Set measurement variances
+            R = 1.0 * Eigen::Matrix<float, 7, 7>::Identity();
+
+            // Initialize error covariance
+            P.setZero();
+            P.topLeftCorner(7,7) = 1.0*Eigen::Matrix<float, 7, 7>::Identity();
+            P.bottomRightCorner(6,6) = 100.0*Eigen::Matrix<float, 6, 6>::Identity();
+
+            nUpdates = 0;
+        }
+
+        // Predicted pose tau seconds after the last update (does not alter the filter state)
+        void predict(float tau, Eigen::Affine3f &Tpred) const{
+            State sPred;
+            propagate(s, tau, sPred, NULL);
+            stateToPose(sPred, Tpred);
+        }
+
+        // Predict tau seconds ahead and correct with measurement Tmeas
+        void update(const Eigen::Affine3f &Tmeas, float tau, Eigen::Affine3f &Tnew){
+
+            // get measurement
+            Measurement z;
+            z.head(3) = Tmeas.translation();
+            Eigen::Quaternionf qtemp(Tmeas.rotation());
+            z(3) = qtemp.w();
+            z.tail(3) = qtemp.vec();
+
+            // prediction of state and Jacobian of prediction function
+            StateMatrix Phi;
+            State sPred;
+            propagate(s, tau, sPred, &Phi);
+            s = sPred;
+
+            // Jacobian of measurement function
+            Eigen::Vector4f q = s.segment(3, 4);
+            Eigen::Matrix<float, 7, 13> H;
+            H.setZero();
+            H.topLeftCorner(3,3) = Eigen::Matrix3f::Identity();
+            float qnorm = q.norm();
+            H(3,3) = (qnorm*qnorm - q(0))/(qnorm*qnorm*qnorm);
+            H(4,4) = (qnorm*qnorm - q(1))/(qnorm*qnorm*qnorm);
+            H(5,5) = (qnorm*qnorm - q(2))/(qnorm*qnorm*qnorm);
+            H(6,6) = (qnorm*qnorm - q(3))/(qnorm*qnorm*qnorm);
+
+            // prediction of covariance
+            P = Phi*P*Phi.transpose() + Q;
+
+            // prediction of measurement
+            Measurement h = s.head(7);
+
+            // Kalman gain
+            Eigen::Matrix<float, 13, 7> K = P*H.transpose()*(H*P*H.transpose() + R).inverse();
+
+            // update state estimate
+            s = s + K*(z - h);
+
+            // renormalize quaternion
+            q = s.segment(3, 4);
+            q.normalize();
+            s.segment(3, 4) = q;
+
+            // update covariance
+            P = (StateMatrix::Identity() - K*H)*P;
+
+            // write updated measurement estimate
+            stateToPose(s, Tnew);
+
+            nUpdates++;
+        }
+
+        // Number of measurements incorporated since the last reset
+        unsigned int getNumberOfUpdates() const{ return nUpdates; }
+        const State& getState() const{ return s; }
+
+    private:
+        static void stateToPose(const State &state, Eigen::Affine3f &T){
+            T.setIdentity();
+            T.translation() = state.head(3);
+            Eigen::Quaternionf q(state(3), state(4), state(5), state(6));
+            T.linear() = q.normalized().matrix();
+        }
+
+        // Constant velocity motion model. Optionally returns the Jacobian Phi.
+        static void propagate(const State &s0, float tau, State &s1, StateMatrix *Phi){
+
+            s1 = s0;
+            s1.head(3) = s0.head(3) + tau*s0.segment(7, 3);
+
+            Eigen::Vector3f omega = s0.segment(10, 3);
+            float ox = omega(0);
+            float oy = omega(1);
+            float oz = omega(2);
+            float onorm = std::max(omega.norm(), 0.00001f);
+
+            Eigen::Matrix4f OmegaBar;
+            OmegaBar << 0, -ox, -oy, -oz,
+                        ox, 0, -oz, oy,
+                        oy, oz, 0, -ox,
+                        oz, -oy, ox, 0;
+            OmegaBar = 0.5*OmegaBar;
+
+            float cosHalf = std::cos(onorm*tau/2.0f);
+            float sinHalf = std::sin(onorm*tau/2.0f);
+
+            Eigen::Matrix4f Qtran = cosHalf*Eigen::Matrix4f::Identity() + 2.0f/onorm*sinHalf*OmegaBar;
+
+            Eigen::Vector4f q = Qtran*s0.segment(3, 4);
+            s1.segment(3, 4) = q;
+
+            if(!Phi)
+                return;
+
+            // quaternion rotation partial derivatives
+            Eigen::Matrix4f dOdx;
+            dOdx << 0, -1, 0, 0, 1, 0, 0, 0, 0, 0, 0, -1, 0, 0, 1, 0;
+            Eigen::Matrix4f dOdy;
+            dOdy << 0, 0, -1, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, -1, 0, 0;
+            Eigen::Matrix4f dOdz;
+            dOdz << 0, 0, 0, -1, 0, 0, -1, 0, 0, 1, 0, 0, 1, 0, 0, 0;
+
+            float onorm2 = onorm*onorm;
+            float onorm3 = onorm2*onorm;
+
+            Eigen::Matrix<float, 4, 3> Qomega;
+            Qomega.col(0) = (-ox*tau/(2*onorm) * sinHalf * Eigen::Matrix4f::Identity() +
+                             (ox*tau/onorm2 * cosHalf - 2.0f*ox/onorm3 * sinHalf) * OmegaBar +
+                             2.0f/onorm * sinHalf * dOdx) * q;
+            Qomega.col(1) = (-oy*tau/(2*onorm) * sinHalf * Eigen::Matrix4f::Identity() +
+                             (oy*tau/onorm2 * cosHalf - 2.0f*oy/onorm3 * sinHalf) * OmegaBar +
+                             2.0f/onorm * sinHalf * dOdy) * q;
+            Qomega.col(2) = (-oz*tau/(2*onorm) * sinHalf * Eigen::Matrix4f::Identity() +
+                             (oz*tau/onorm2 * cosHalf - 2.0f*oz/onorm3 * sinHalf) * OmegaBar +
+                             2.0f/onorm * sinHalf * dOdz) * q;
+
+            Phi->setZero();
+            Phi->topLeftCorner(6,6) = Eigen::Matrix<float, 6, 6>::Identity();
+            Phi->topRightCorner(6,6) = tau*Eigen::Matrix<float, 6, 6>::Identity();
+            Phi->block(3,3,4,4) = Qtran;
+            Phi->block(3,10,4,3) = Qomega;
+            Phi->bottomRightCorner(6,6) = Eigen::Matrix<float, 6, 6>::Identity();
+        }
+
+        // Extended Kalman filter structures
+        // Notation according to Goddard "Pose and Motion Estimation...", U Tennessee, 1997
+        State s; // state [tx,ty,tz,qw,qx,qy,qz,vx,xy,vz,ox,oy,oz]
+        StateMatrix Q; // process noise covariance matrix (Q)
+        Eigen::Matrix<float, 7, 7> R; // measurement noise covariance matrix (R)
+        StateMatrix P; // error covariance
+        unsigned int nUpdates;
+
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+#endif // PoseFilterEKF_H
@@ -44,7 +44,7 @@ TrackerICP::TrackerICP(){
 
     lastTransformation = Eigen::Matrix4f::Identity();
 
-    poseFilter = new PoseFilter();
+    lastUpdateTime = std::chrono::steady_clock::now();
 }
 
 void TrackerICP::setReference(PointCloudConstPtr refPointCloud){
@@ -64,6 +64,10 @@ void TrackerICP::setReference(PointCloudConstPtr refPointCloud){
 
     icp->setInputTarget(refPointCloudNormals);
 
+    // Restart motion model from the reference pose
+    lastTransformation = Eigen::Matrix4f::Identity();
+    poseFilter.reset();
+    lastUpdateTime = std::chrono::steady_clock::now();
 }
 
 void TrackerICP::setCameraMatrix(Eigen::Matrix3f _cameraMatrix){
@@ -93,9 +97,18 @@ void TrackerICP::determineTransformation(PointCloudConstPtr pointCloud, Eigen::A
 //    correspondenceRejectorBoundary->setInputSource<pcl::PointXYZRGBNormal>(pointCloudNormals);
     icp->setInputSource(pointCloudNormals);
 
+    // Time since last filter update
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    float tau = std::chrono::duration<float>(now - lastUpdateTime).count();
+
+    // Initial guess from motion prior (last pose until velocity estimates are available)
+    Eigen::Affine3f Tguess = lastTransformation;
+    if(poseFilter.getNumberOfUpdates() > 1)
+        poseFilter.predict(tau, Tguess);
+
     // Align
     pcl::PointCloud<pcl::PointXYZRGBNormal> registeredPointCloud;
-    icp->align(registeredPointCloud, lastTransformation.matrix());
+    icp->align(registeredPointCloud, Tguess.matrix());
 
     //std::cout << "Nr of iterations: " << icp->nr_iterations_ << std::endl;
 
@@ -121,7 +134,8 @@ void TrackerICP::determineTransformation(PointCloudConstPtr pointCloud, Eigen::A
     if(converged){
         Eigen::Affine3f Traw;
         Traw.matrix() = icp->getFinalTransformation();
-        poseFilter->filterPoseEstimate(Traw, T);
+        poseFilter.update(Traw, tau, T);
+        lastUpdateTime = now;
         //T = Traw;
         lastTransformation = T;
     } else {
@@ -3,7 +3,9 @@
 
 #include "Tracker.h"
 
-#include "PoseFilter.h"
+#include "PoseFilterEKF.h"
+
+#include <chrono>
 
 #include <pcl/registration/icp.h>
 #include <pcl/filters/approximate_voxel_grid.h>
@@ -49,7 +51,9 @@ class TrackerICP : public Tracker {
 
         pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr refPointCloudNormals;
 
-        PoseFilter *poseFilter;
+        // Motion prior, used as initial guess for ICP
+        PoseFilterEKF poseFilter;
+        std::chrono::steady_clock::time_point lastUpdateTime;
 
 };
 
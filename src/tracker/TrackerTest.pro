@@ -11,7 +11,8 @@ HEADERS += Tracker.h \
            CorrEstOrgProjFast.h \
            CorrRejectOrgBoundFast.h \
            CorrEstKdTreeFast.h \
-           TrackerPCL.h
+           TrackerPCL.h \
+           PoseFilterEKF.h
 
 SOURCES += mainTrackerTest.cpp\
            TrackerICP.cpp \
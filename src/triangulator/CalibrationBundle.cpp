@@ -0,0 +1,301 @@
+#include "CalibrationBundle.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <set>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include "Triangulator.h"
+
+// File format: header, table directory, then the table data, each table
+// aligned to 64 bytes. All values are little endian.
+static const char fileMagic[4] = {'S', 'L', 'C', 'B'};
+static const uint32_t fileVersion = 2;
+static const size_t tableAlignment = 64;
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t sourceHash;
+  float Kc[9], kc[5], Kp[9], kp[5], Rp[9], Tp[3];
+  double camError, projError, stereoError;
+  int32_t frameWidth, frameHeight, screenResX, screenResY;
+  // Zero terminated
+  char calibrationDateTime[64];
+  uint32_t nTables;
+};
+
+struct TableEntry {
+  char name[32];
+  int32_t rows, cols, type;
+  uint64_t offset;
+};
+
+// Only accessed through the atomic shared_ptr functions
+static CalibrationBundle::ConstPtr currentBundle;
+
+// FNV-1a
+static uint64_t hashBytes(const char *data, size_t size) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Bundles are named by the hash of their source (calibration.xml ->
+// calibration.<hash>.slbundle). A new calibration thus never replaces a bundle
+// file, which fails on Windows while the file exists or is still mapped.
+static QString bundleFileName(const QString &calibrationFile,
+                              uint64_t sourceHash) {
+  QFileInfo info(calibrationFile);
+  return info.path() + "/" + info.completeBaseName() +
+         QString(".%1.slbundle").arg((qulonglong)sourceHash, 16, 16,
+                                     QChar('0'));
+}
+
+// Removes the bundles of other versions of the calibration file. Bundles which
+// are still mapped cannot be removed on Windows, they are removed by a later
+// call.
+static void removeStaleBundles(const QString &calibrationFile,
+                               const QString &bundleFile) {
+  QFileInfo info(calibrationFile);
+  QDir dir(info.path());
+  QStringList patterns;
+  patterns << info.completeBaseName() + ".????????????????.slbundle"
+           << info.completeBaseName() + ".slbundle";
+  QStringList names = dir.entryList(patterns, QDir::Files);
+  for (int i = 0; i < names.size(); i++)
+    if (names[i] != QFileInfo(bundleFile).fileName())
+      dir.remove(names[i]);
+}
+
+cv::Mat CalibrationBundle::getTable(const std::string &name) const {
+  std::map<std::string, cv::Mat>::const_iterator it = tables.find(name);
+  return (it != tables.end()) ? it->second : cv::Mat();
+}
+
+CalibrationBundle::~CalibrationBundle() {}
+
+CalibrationBundle::ConstPtr CalibrationBundle::load(
+    const QString &calibrationFile) {
+  static std::mutex mutex;
+  static std::map<QString, std::weak_ptr<const CalibrationBundle> > cache;
+  // Bundle files which could not be written, reported once
+  static std::set<QString> writeFailed;
+
+  // The calibration file is only hashed, not parsed
+  QByteArray source;
+  QFile sourceFile(calibrationFile);
+  if (sourceFile.open(QIODevice::ReadOnly)) source = sourceFile.readAll();
+  uint64_t sourceHash = hashBytes(source.constData(), source.size()) ^
+                        (uint64_t)Triangulator::tablesVersion;
+
+  // Building is serialized, such that workers starting together share one
+  // bundle
+  std::lock_guard<std::mutex> lock(mutex);
+
+  ConstPtr bundle = cache[calibrationFile].lock();
+  if (bundle && bundle->sourceHash == sourceHash) return bundle;
+
+  QString bundleFile = bundleFileName(calibrationFile, sourceHash);
+  bundle = map(bundleFile, sourceHash);
+
+  if (!bundle) {
+    CalibrationData calibration;
+    if (!source.isEmpty()) calibration.load(calibrationFile);
+    bundle = build(calibration, sourceHash);
+
+    // Without a calibration file, there is nothing to cache
+    if (!source.isEmpty()) {
+      if (write(bundleFile, *bundle)) {
+        ConstPtr mapped = map(bundleFile, sourceHash);
+        if (mapped) bundle = mapped;
+      } else if (writeFailed.insert(bundleFile).second) {
+        std::cerr << "CalibrationBundle: could not write "
+                  << bundleFile.toStdString()
+                  << ", tables are rebuilt at each load" << std::endl;
+      }
+    }
+  }
+
+  if (!source.isEmpty()) removeStaleBundles(calibrationFile, bundleFile);
+
+  cache[calibrationFile] = bundle;
+  return bundle;
+}
+
+CalibrationBundle::ConstPtr CalibrationBundle::fromCalibration(
+    const CalibrationData &calibration) {
+  return build(calibration, 0);
+}
+
+CalibrationBundle::ConstPtr CalibrationBundle::current() {
+  ConstPtr bundle = std::atomic_load(&currentBundle);
+  if (bundle) return bundle;
+
+  // First use. If another thread published meanwhile, its bundle wins.
+  bundle = load("calibration.xml");
+  ConstPtr expected;
+  if (!std::atomic_compare_exchange_strong(&currentBundle, &expected, bundle))
+    return expected;
+  return bundle;
+}
+
+void CalibrationBundle::publish(ConstPtr bundle) {
+  std::atomic_store(&currentBundle, bundle);
+}
+
+std::shared_ptr<CalibrationBundle> CalibrationBundle::build(
+    const CalibrationData &calibration, uint64_t sourceHash) {
+  std::shared_ptr<CalibrationBundle> bundle(new CalibrationBundle);
+  bundle->calibration = calibration;
+  bundle->sourceHash = sourceHash;
+
+  Tables tables = Triangulator::computeTables(calibration);
+  for (size_t i = 0; i < tables.size(); i++)
+    bundle->tables[tables[i].first] = tables[i].second;
+
+  return bundle;
+}
+
+CalibrationBundle::ConstPtr CalibrationBundle::map(const QString &bundleFile,
+                                                   uint64_t sourceHash) {
+  std::unique_ptr<QFile> file(new QFile(bundleFile));
+  if (!file->open(QIODevice::ReadOnly) ||
+      file->size() < (qint64)sizeof(FileHeader))
+    return ConstPtr();
+
+  const uchar *data = file->map(0, file->size());
+  if (!data) return ConstPtr();
+
+  FileHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0 ||
+      header.version != fileVersion || header.sourceHash != sourceHash)
+    return ConstPtr();
+
+  std::shared_ptr<CalibrationBundle> bundle(new CalibrationBundle);
+  bundle->sourceHash = sourceHash;
+
+  CalibrationData &calibration = bundle->calibration;
+  calibration.Kc = cv::Matx33f(header.Kc);
+  calibration.kc = cv::Vec<float, 5>(header.kc);
+  calibration.Kp = cv::Matx33f(header.Kp);
+  calibration.kp = cv::Vec<float, 5>(header.kp);
+  calibration.Rp = cv::Matx33f(header.Rp);
+  calibration.Tp = cv::Vec3f(header.Tp);
+  calibration.cam_error = header.camError;
+  calibration.proj_error = header.projError;
+  calibration.stereo_error = header.stereoError;
+  calibration.frameWidth = header.frameWidth;
+  calibration.frameHeight = header.frameHeight;
+  calibration.screenResX = header.screenResX;
+  calibration.screenResY = header.screenResY;
+  header.calibrationDateTime[sizeof(header.calibrationDateTime) - 1] = '\0';
+  calibration.calibrationDateTime = header.calibrationDateTime;
+
+  size_t directoryEnd =
+      sizeof(FileHeader) + header.nTables * sizeof(TableEntry);
+  if (directoryEnd > (size_t)file->size()) return ConstPtr();
+
+  for (uint32_t i = 0; i < header.nTables; i++) {
+    TableEntry entry;
+    std::memcpy(&entry, data + sizeof(FileHeader) + i * sizeof(TableEntry),
+                sizeof(entry));
+    entry.name[sizeof(entry.name) - 1] = '\0';
+
+    size_t size = (size_t)entry.rows * entry.cols * CV_ELEM_SIZE(entry.type);
+    if (entry.offset + size > (size_t)file->size()) return ConstPtr();
+
+    // Views into the read-only mapping, writing to them segfaults
+    bundle->tables[entry.name] = cv::Mat(entry.rows, entry.cols, entry.type,
+                                         (void *)(data + entry.offset));
+  }
+
+  bundle->file = std::move(file);
+  return bundle;
+}
+
+bool CalibrationBundle::write(const QString &bundleFile,
+                              const CalibrationBundle &bundle) {
+  const CalibrationData &calibration = bundle.calibration;
+
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+  header.version = fileVersion;
+  header.sourceHash = bundle.sourceHash;
+  std::memcpy(header.Kc, calibration.Kc.val, sizeof(header.Kc));
+  std::memcpy(header.kc, calibration.kc.val, sizeof(header.kc));
+  std::memcpy(header.Kp, calibration.Kp.val, sizeof(header.Kp));
+  std::memcpy(header.kp, calibration.kp.val, sizeof(header.kp));
+  std::memcpy(header.Rp, calibration.Rp.val, sizeof(header.Rp));
+  std::memcpy(header.Tp, calibration.Tp.val, sizeof(header.Tp));
+  header.camError = calibration.cam_error;
+  header.projError = calibration.proj_error;
+  header.stereoError = calibration.stereo_error;
+  header.frameWidth = calibration.frameWidth;
+  header.frameHeight = calibration.frameHeight;
+  header.screenResX = calibration.screenResX;
+  header.screenResY = calibration.screenResY;
+  std::strncpy(header.calibrationDateTime,
+               calibration.calibrationDateTime.c_str(),
+               sizeof(header.calibrationDateTime) - 1);
+  header.nTables = bundle.tables.size();
+
+  std::vector<TableEntry> directory;
+  std::vector<cv::Mat> data;
+  uint64_t offset = sizeof(FileHeader) + header.nTables * sizeof(TableEntry);
+  for (std::map<std::string, cv::Mat>::const_iterator it =
+           bundle.tables.begin();
+       it != bundle.tables.end(); ++it) {
+    cv::Mat table = it->second.isContinuous() ? it->second : it->second.clone();
+
+    TableEntry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    std::strncpy(entry.name, it->first.c_str(), sizeof(entry.name) - 1);
+    entry.rows = table.rows;
+    entry.cols = table.cols;
+    entry.type = table.type();
+    offset = (offset + tableAlignment - 1) / tableAlignment * tableAlignment;
+    entry.offset = offset;
+    offset += table.total() * table.elemSize();
+
+    directory.push_back(entry);
+    data.push_back(table);
+  }
+
+  // Write to a temporary file first, such that readers never see partial files
+  std::string fileName = bundleFile.toLocal8Bit().constData();
+  std::string tmpFileName = fileName + ".tmp";
+  std::ofstream file(tmpFileName.c_str(), std::ios::binary);
+  if (!file.is_open()) return false;
+
+  file.write((const char *)&header, sizeof(header));
+  file.write((const char *)directory.data(),
+             directory.size() * sizeof(TableEntry));
+  for (size_t i = 0; i < data.size(); i++) {
+    static const char padding[tableAlignment] = {0};
+    file.write(padding, directory[i].offset - (uint64_t)file.tellp());
+    file.write((const char *)data[i].data, data[i].total() * data[i].elemSize());
+  }
+  file.close();
+
+  // A file of the same name is left over from an invalid bundle of the same
+  // source, which is not mapped. Renaming fails on Windows if it exists.
+  if (file) std::remove(fileName.c_str());
+  if (!file || std::rename(tmpFileName.c_str(), fileName.c_str()) != 0) {
+    std::remove(tmpFileName.c_str());
+    return false;
+  }
+
+  return true;
+}
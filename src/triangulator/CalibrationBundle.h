@@ -0,0 +1,72 @@
+#ifndef CALIBRATIONBUNDLE_H
+#define CALIBRATIONBUNDLE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <QString>
+
+#include <opencv2/opencv.hpp>
+
+#include "CalibrationData.h"
+
+class QFile;
+
+// Binary bundle of a calibration and the per pixel tables derived from it
+// (lens correction maps and triangulation tables). It is written next to the
+// calibration file (calibration.xml -> calibration.<hash>.slbundle), rebuilt
+// when the calibration file changes, and memory mapped read-only. All workers of the
+// process share one mapping, such that starting the pipeline neither parses
+// XML nor recomputes tables.
+//
+// Bundles are immutable. The scan worker checks for a newly published bundle
+// between sequences, regenerates its patterns with it and passes it on with
+// each frame sequence, the decoder with the phase images and the triangulator
+// in the depth image. Workers rebuild their derived state when the bundle they
+// receive differs from their own. Publishing a new bundle thus takes effect
+// during a running scan, without restarting the pipeline, and never mixes
+// calibrations within a frame.
+class CalibrationBundle {
+ public:
+  typedef std::shared_ptr<const CalibrationBundle> ConstPtr;
+  typedef std::vector<std::pair<std::string, cv::Mat> > Tables;
+
+  // Shared bundle of an XML calibration file. Without a calibration file, the
+  // default calibration is used.
+  static ConstPtr load(const QString &calibrationFile);
+  // Bundle built in memory, without a file
+  static ConstPtr fromCalibration(const CalibrationData &calibration);
+
+  // Calibration of the running pipeline, initially that of calibration.xml.
+  // Thread safe.
+  static ConstPtr current();
+  // Atomically replaces the current bundle
+  static void publish(ConstPtr bundle);
+
+  const CalibrationData &getCalibration() const { return calibration; }
+  // View of a table, empty if missing. Valid while the bundle is referenced.
+  // The view must not be written to: tables of a bundle file are mapped
+  // read-only, and writes segfault. Clone it to modify it.
+  cv::Mat getTable(const std::string &name) const;
+
+  ~CalibrationBundle();
+
+ private:
+  CalibrationBundle() : sourceHash(0) {}
+  static std::shared_ptr<CalibrationBundle> build(
+      const CalibrationData &calibration, uint64_t sourceHash);
+  static ConstPtr map(const QString &bundleFile, uint64_t sourceHash);
+  static bool write(const QString &bundleFile, const CalibrationBundle &bundle);
+
+  CalibrationData calibration;
+  uint64_t sourceHash;
+  std::map<std::string, cv::Mat> tables;
+  // Owns the mapped memory, NULL for bundles built in memory
+  std::unique_ptr<QFile> file;
+};
+
+#endif
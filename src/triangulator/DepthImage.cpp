@@ -0,0 +1,33 @@
+#include "DepthImage.h"
+
+#include <cmath>
+
+void DepthImage::crop(const cv::Point3f &minimum, const cv::Point3f &maximum) {
+  for (int r = 0; r < z.rows; r++) {
+    float *depth = z.ptr<float>(r);
+    const cv::Vec2f *ray = rays.ptr<cv::Vec2f>(r);
+    for (int c = 0; c < z.cols; c++) {
+      float x = depth[c] * ray[c][0];
+      float y = depth[c] * ray[c][1];
+      // Comparisons are false for NaN, such that invalid points stay invalid
+      bool inside = (depth[c] >= minimum.z && depth[c] <= maximum.z &&
+                     x >= minimum.x && x <= maximum.x && y >= minimum.y &&
+                     y <= maximum.y);
+      if (!inside) depth[c] = NAN;
+    }
+  }
+}
+
+cv::Mat DepthImage::computeRays(const cv::Matx33f &Kc, cv::Size size) {
+  cv::Matx33f KcInv = Kc.inv();
+  cv::Mat rays(size, CV_32FC2);
+  for (int r = 0; r < size.height; r++) {
+    cv::Vec2f *ray = rays.ptr<cv::Vec2f>(r);
+    for (int c = 0; c < size.width; c++) {
+      cv::Vec3f direction = KcInv * cv::Vec3f(c, r, 1.0f);
+      ray[c] = cv::Vec2f(direction[0] / direction[2],
+                         direction[1] / direction[2]);
+    }
+  }
+  return rays;
+}
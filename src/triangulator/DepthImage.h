@@ -0,0 +1,39 @@
+#ifndef DEPTHIMAGE_H
+#define DEPTHIMAGE_H
+
+#include <memory>
+
+#include <opencv2/opencv.hpp>
+
+class CalibrationBundle;
+
+// Organized scan result in the undistorted camera frame, stored as depth and
+// shading (5 bytes per pixel instead of 32 for pcl::PointXYZRGB). The point
+// of pixel (c, r) is z(r, c) * (rays(r, c)[0], rays(r, c)[1], 1). The rays
+// depend on the calibration only and are shared between frames.
+struct DepthImage {
+  cv::Mat z;        // CV_32F, NaN for invalid points
+  cv::Mat shading;  // CV_8U
+  cv::Mat rays;     // CV_32FC2
+  // Calibration the image was triangulated with
+  std::shared_ptr<const CalibrationBundle> bundle;
+
+  int cols() const { return z.cols; }
+  int rows() const { return z.rows; }
+  cv::Point3f point(int r, int c) const {
+    float depth = z.at<float>(r, c);
+    const cv::Vec2f &ray = rays.at<cv::Vec2f>(r, c);
+    return cv::Point3f(depth * ray[0], depth * ray[1], depth);
+  }
+
+  // Invalidates points outside of the axis aligned box [minimum, maximum]
+  void crop(const cv::Point3f &minimum, const cv::Point3f &maximum);
+
+  // Rays Kc^-1 * (c, r, 1) of the pixels of an undistorted camera image
+  static cv::Mat computeRays(const cv::Matx33f &Kc, cv::Size size);
+};
+
+typedef std::shared_ptr<DepthImage> DepthImagePtr;
+typedef std::shared_ptr<const DepthImage> DepthImageConstPtr;
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef DEPTHIMAGEPCL_H
+#define DEPTHIMAGEPCL_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "DepthImage.h"
+
+// Organized PCL cloud of a depth image, for consumers which need PCL types.
+// PointT needs xyz and rgb fields. Invalid points are NaN.
+template <typename PointT>
+void depthImageToPointCloud(const DepthImage &depthImage,
+                            pcl::PointCloud<PointT> &pointCloud) {
+  int cols = depthImage.cols(), rows = depthImage.rows();
+  pointCloud.width = cols;
+  pointCloud.height = rows;
+  pointCloud.is_dense = false;
+  pointCloud.points.resize((size_t)cols * rows);
+
+  for (int r = 0; r < rows; r++) {
+    const float *z = depthImage.z.ptr<float>(r);
+    const unsigned char *shading = depthImage.shading.ptr<unsigned char>(r);
+    const cv::Vec2f *ray = depthImage.rays.ptr<cv::Vec2f>(r);
+    PointT *points = &pointCloud.points[(size_t)r * cols];
+    for (int c = 0; c < cols; c++) {
+      PointT &p = points[c];
+      p.x = z[c] * ray[c][0];
+      p.y = z[c] * ray[c][1];
+      p.z = z[c];
+      p.r = p.g = p.b = shading[c];
+      p.a = 255;
+    }
+  }
+}
+
+template <typename PointT>
+typename pcl::PointCloud<PointT>::Ptr depthImageToPointCloud(
+    const DepthImage &depthImage) {
+  typename pcl::PointCloud<PointT>::Ptr pointCloud(
+      new pcl::PointCloud<PointT>);
+  depthImageToPointCloud(depthImage, *pointCloud);
+  return pointCloud;
+}
+
+#endif
@@ -0,0 +1,153 @@
+#include "OrganizedMesher.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// mask[x] = 0xFF if the edge between a[x] and b[x] is valid, 0 otherwise
+static void edgeMask(const float *a, const float *b, unsigned char *mask,
+                     int n, float maxDepthJump) {
+  int x = 0;
+
+#ifdef __SSE2__
+  const __m128 t = _mm_set1_ps(maxDepthJump);
+  const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+  for (; x + 16 <= n; x += 16) {
+    __m128i m[4];
+    for (int k = 0; k < 4; k++) {
+      __m128 za = _mm_loadu_ps(a + x + 4 * k);
+      __m128 zb = _mm_loadu_ps(b + x + 4 * k);
+      __m128 d = _mm_and_ps(_mm_sub_ps(za, zb), absMask);
+      // Comparisons with NaN are false
+      m[k] = _mm_castps_si128(
+          _mm_cmple_ps(d, _mm_mul_ps(t, _mm_min_ps(za, zb))));
+    }
+    // Saturating packs keep 0xFF..FF as 0xFF
+    __m128i m01 = _mm_packs_epi32(m[0], m[1]);
+    __m128i m23 = _mm_packs_epi32(m[2], m[3]);
+    _mm_storeu_si128((__m128i *)(mask + x), _mm_packs_epi16(m01, m23));
+  }
+#endif
+
+  for (; x < n; x++) {
+    float d = std::abs(a[x] - b[x]);
+    mask[x] = (d <= maxDepthJump * std::min(a[x], b[x])) ? 0xFF : 0;
+  }
+}
+
+// dst = a & b & c
+static void andMasks(const unsigned char *a, const unsigned char *b,
+                     const unsigned char *c, unsigned char *dst, int n) {
+  int x = 0;
+
+#ifdef __SSE2__
+  for (; x + 16 <= n; x += 16) {
+    __m128i m = _mm_and_si128(_mm_loadu_si128((const __m128i *)(a + x)),
+                              _mm_loadu_si128((const __m128i *)(b + x)));
+    m = _mm_and_si128(m, _mm_loadu_si128((const __m128i *)(c + x)));
+    _mm_storeu_si128((__m128i *)(dst + x), m);
+  }
+#endif
+
+  for (; x < n; x++) dst[x] = a[x] & b[x] & c[x];
+}
+
+void OrganizedMesher::setResolution(unsigned int _cols, unsigned int _rows) {
+  cols = _cols;
+  rows = _rows;
+
+  size_t nQuads = (size_t)(cols - 1) * (rows - 1);
+  quadIndices.resize(6 * nQuads);
+  unsigned int *q = &quadIndices[0];
+  for (unsigned int r = 0; r + 1 < rows; r++) {
+    for (unsigned int c = 0; c + 1 < cols; c++) {
+      unsigned int i = r * cols + c;
+      q[0] = i;
+      q[1] = i + cols;
+      q[2] = i + 1;
+      q[3] = i + 1;
+      q[4] = i + cols;
+      q[5] = i + cols + 1;
+      q += 6;
+    }
+  }
+
+  rightMask.assign((size_t)cols * rows, 0);
+  downMask.assign((size_t)cols * rows, 0);
+  diagMask.assign((size_t)cols * rows, 0);
+  upperMask.resize(nQuads);
+  lowerMask.resize(nQuads);
+  triangles.resize(6 * nQuads);
+}
+
+const unsigned int *OrganizedMesher::mesh(const float *z, unsigned int _cols,
+                                          unsigned int _rows,
+                                          size_t &nTriangles) {
+  nTriangles = 0;
+  if (_cols < 2 || _rows < 2) return NULL;
+
+  if (_cols != cols || _rows != rows) setResolution(_cols, _rows);
+
+  // Edge validity
+  for (unsigned int r = 0; r < rows; r++) {
+    const float *row = z + (size_t)r * cols;
+    size_t offset = (size_t)r * cols;
+    edgeMask(row, row + 1, &rightMask[offset], cols - 1, maxDepthJump);
+    if (r + 1 < rows) {
+      edgeMask(row, row + cols, &downMask[offset], cols, maxDepthJump);
+      edgeMask(row + 1, row + cols, &diagMask[offset], cols - 1,
+               maxDepthJump);
+    }
+  }
+
+  // Triangle validity
+  unsigned int nQuadCols = cols - 1;
+  for (unsigned int r = 0; r + 1 < rows; r++) {
+    size_t offset = (size_t)r * cols;
+    size_t quadOffset = (size_t)r * nQuadCols;
+    andMasks(&rightMask[offset], &downMask[offset], &diagMask[offset],
+             &upperMask[quadOffset], nQuadCols);
+    andMasks(&diagMask[offset], &rightMask[offset + cols],
+             &downMask[offset + 1], &lowerMask[quadOffset], nQuadCols);
+  }
+
+  // Compaction of the precomputed indices
+  size_t nQuads = (size_t)nQuadCols * (rows - 1);
+  const unsigned char *upper = &upperMask[0];
+  const unsigned char *lower = &lowerMask[0];
+  unsigned int *out = &triangles[0];
+  size_t n = 0;
+
+  for (size_t block = 0; block < nQuads; block += 16) {
+    size_t end = std::min(block + 16, nQuads);
+
+#ifdef __SSE2__
+    // Skip blocks without valid triangles, e.g. background
+    if (end - block == 16) {
+      __m128i any =
+          _mm_or_si128(_mm_loadu_si128((const __m128i *)(upper + block)),
+                       _mm_loadu_si128((const __m128i *)(lower + block)));
+      if (_mm_movemask_epi8(any) == 0) continue;
+    }
+#endif
+
+    for (size_t i = block; i < end; i++) {
+      // Branchless: triangles are always written, but only kept if valid
+      const unsigned int *q = &quadIndices[6 * i];
+      out[n + 0] = q[0];
+      out[n + 1] = q[1];
+      out[n + 2] = q[2];
+      n += upper[i] & 3;
+      out[n + 0] = q[3];
+      out[n + 1] = q[4];
+      out[n + 2] = q[5];
+      n += lower[i] & 3;
+    }
+  }
+
+  nTriangles = n / 3;
+  return &triangles[0];
+}
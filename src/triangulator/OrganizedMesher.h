@@ -0,0 +1,39 @@
+#ifndef ORGANIZEDMESHER_H
+#define ORGANIZEDMESHER_H
+
+#include <cstddef>
+#include <vector>
+
+// Triangle mesh of an organized point cloud, exploiting its fixed pixel
+// topology. Each grid quad (r,c) is split into the triangles
+// (i, i+cols, i+1) and (i+1, i+cols, i+cols+1), i = r*cols+c. The full index
+// list is computed once per resolution, and per frame only the triangles whose
+// edges are valid are copied out. An edge is valid if both depths are finite
+// and |za - zb| <= maxDepthJump * min(za, zb), which removes triangles across
+// depth discontinuities.
+class OrganizedMesher {
+ public:
+  OrganizedMesher(float maxDepthJump = 0.02f)
+      : maxDepthJump(maxDepthJump), cols(0), rows(0) {}
+  void setMaxDepthJump(float _maxDepthJump) { maxDepthJump = _maxDepthJump; }
+  // Triangles of the depth map z (cols x rows, row-major, NaN for invalid
+  // points), as 3*nTriangles vertex indices. The buffer is valid until the
+  // next call.
+  const unsigned int *mesh(const float *z, unsigned int cols,
+                           unsigned int rows, size_t &nTriangles);
+
+ private:
+  void setResolution(unsigned int cols, unsigned int rows);
+
+  float maxDepthJump;
+  unsigned int cols, rows;
+  // Two triangles per quad, (cols-1)*(rows-1) quads
+  std::vector<unsigned int> quadIndices;
+  // Per pixel edge masks (0 or 0xFF) to the right, down and down-left
+  std::vector<unsigned char> rightMask, downMask, diagMask;
+  // Per quad triangle masks
+  std::vector<unsigned char> upperMask, lowerMask;
+  std::vector<unsigned int> triangles;
+};
+
+#endif
@@ -10,18 +10,52 @@
     #endif
 #endif
 
-Triangulator::Triangulator(CalibrationData _calibration) : calibration(_calibration){
+Triangulator::Triangulator(CalibrationData _calibration) : Triangulator(CalibrationBundle::fromCalibration(_calibration)){}
 
-    // Precompute uc, vc maps
-    uc.create(calibration.frameHeight, calibration.frameWidth, CV_32F);
-    vc.create(calibration.frameHeight, calibration.frameWidth, CV_32F);
+Triangulator::Triangulator(CalibrationBundle::ConstPtr _bundle) : calibration(_bundle->getCalibration()), bundle(_bundle){
+
+    // Views of the shared tables, which are read-only
+    uc = bundle->getTable("uc");
+    vc = bundle->getTable("vc");
+
+    int sz[] = {4, 3, 3, 3};
+    determinantTensor = cv::Mat(4, sz, CV_32F, bundle->getTable("determinantTensor").data);
+
+    lensMap1 = bundle->getTable("lensMap1");
+    lensMap2 = bundle->getTable("lensMap2");
+
+    xyzwPrecomputeOffset.resize(4);
+    xyzwPrecomputeFactor.resize(4);
+    xyzwPrecomputeOffsetVp.resize(4);
+    xyzwPrecomputeFactorVp.resize(4);
+    for(unsigned int i=0; i<4; i++){
+        xyzwPrecomputeOffset[i] = bundle->getTable(cv::format("xyzwOffset%d", i));
+        xyzwPrecomputeFactor[i] = bundle->getTable(cv::format("xyzwFactor%d", i));
+        xyzwPrecomputeOffsetVp[i] = bundle->getTable(cv::format("xyzwOffsetVp%d", i));
+        xyzwPrecomputeFactorVp[i] = bundle->getTable(cv::format("xyzwFactorVp%d", i));
+    }
+
+    rays = bundle->getTable("rays");
+}
+
+CalibrationBundle::Tables Triangulator::computeTables(const CalibrationData &calibration){
+
+    CalibrationBundle::Tables tables;
 
-    for(unsigned int row=0; row<calibration.frameHeight; row++){
-        for(unsigned int col=0; col<calibration.frameWidth; col++){
-            uc.at<float>(row, col) = col;
-            vc.at<float>(row, col) = row;
+    // Precompute uc, vc maps
+    cv::Mat uc(calibration.frameHeight, calibration.frameWidth, CV_32F);
+    cv::Mat vc(calibration.frameHeight, calibration.frameWidth, CV_32F);
+
+    for(int row=0; row<uc.rows; row++){
+        float *ucRow = uc.ptr<float>(row);
+        float *vcRow = vc.ptr<float>(row);
+        for(int col=0; col<uc.cols; col++){
+            ucRow[col] = col;
+            vcRow[col] = row;
         }
     }
+    tables.push_back(std::make_pair("uc", uc));
+    tables.push_back(std::make_pair("vc", vc));
 
     // Precompute determinant tensor
     cv::Mat Pc(3,4,CV_32F,cv::Scalar(0.0));
@@ -50,11 +84,15 @@ Triangulator::Triangulator(CalibrationData _calibration) : calibration(_calibrat
             }
         }
     }
-    determinantTensor = C;
+    // Stored as 4 x 27
+    tables.push_back(std::make_pair("determinantTensor", cv::Mat(4, 27, CV_32F, C.data).clone()));
 
     // Precompute lens correction maps
     cv::Mat eye = cv::Mat::eye(3, 3, CV_32F);
+    cv::Mat lensMap1, lensMap2;
     cv::initUndistortRectifyMap(calibration.Kc, calibration.kc, eye, calibration.Kc, cv::Size(calibration.frameWidth, calibration.frameHeight),  CV_16SC2, lensMap1, lensMap2);
+    tables.push_back(std::make_pair("lensMap1", lensMap1));
+    tables.push_back(std::make_pair("lensMap2", lensMap2));
 
     //cv::Mat map1, map2;
     //cv::normalize(lensMap1, map1, 0, 255, cv::NORM_MINMAX, CV_8U);
@@ -63,15 +101,20 @@ Triangulator::Triangulator(CalibrationData _calibration) : calibration(_calibrat
     //cv::imwrite("map2.png", map2);
 
     // Precompute parts of xyzw
-    xyzwPrecomputeOffset.resize(4);
-    xyzwPrecomputeFactor.resize(4);
-    for(unsigned int i=0; i<4; i++){
-        xyzwPrecomputeOffset[i] = C.at<float>(cv::Vec4i(i,0,1,0)) - C.at<float>(cv::Vec4i(i,2,1,0))*uc - C.at<float>(cv::Vec4i(i,0,2,0))*vc;
-        xyzwPrecomputeFactor[i] = - C.at<float>(cv::Vec4i(i,0,1,2)) + C.at<float>(cv::Vec4i(i,2,1,2))*uc + C.at<float>(cv::Vec4i(i,0,2,2))*vc;
+    for(int i=0; i<4; i++){
+        tables.push_back(std::make_pair(cv::format("xyzwOffset%d", i), cv::Mat(C.at<float>(cv::Vec4i(i,0,1,0)) - C.at<float>(cv::Vec4i(i,2,1,0))*uc - C.at<float>(cv::Vec4i(i,0,2,0))*vc)));
+        tables.push_back(std::make_pair(cv::format("xyzwFactor%d", i), cv::Mat(- C.at<float>(cv::Vec4i(i,0,1,2)) + C.at<float>(cv::Vec4i(i,2,1,2))*uc + C.at<float>(cv::Vec4i(i,0,2,2))*vc)));
+        tables.push_back(std::make_pair(cv::format("xyzwOffsetVp%d", i), cv::Mat(C.at<float>(cv::Vec4i(i,0,1,1)) - C.at<float>(cv::Vec4i(i,2,1,1))*uc - C.at<float>(cv::Vec4i(i,0,2,1))*vc)));
+        tables.push_back(std::make_pair(cv::format("xyzwFactorVp%d", i), cv::Mat(- C.at<float>(cv::Vec4i(i,0,1,2)) + C.at<float>(cv::Vec4i(i,2,1,2))*uc + C.at<float>(cv::Vec4i(i,0,2,2))*vc)));
     }
+
+    // Camera rays of the undistorted image
+    tables.push_back(std::make_pair("rays", DepthImage::computeRays(calibration.Kc, cv::Size(calibration.frameWidth, calibration.frameHeight))));
+
+    return tables;
 }
 
-void Triangulator::triangulate(cv::Mat &up, cv::Mat &vp, cv::Mat &mask, cv::Mat &shading, cv::Mat &pointCloud){
+void Triangulator::undistort(cv::Mat &up, cv::Mat &vp, cv::Mat &mask, cv::Mat &shading){
 
     // Undistort up, mask and shading
     if(!up.empty()){
@@ -90,6 +133,11 @@ void Triangulator::triangulate(cv::Mat &up, cv::Mat &vp, cv::Mat &mask, cv::Mat
     cv::remap(shading, shadingUndistort, lensMap1, lensMap2, cv::INTER_LINEAR);
     mask = maskUndistort;
     shading = shadingUndistort;
+}
+
+void Triangulator::triangulate(cv::Mat &up, cv::Mat &vp, cv::Mat &mask, cv::Mat &shading, cv::Mat &pointCloud){
+
+    undistort(up, vp, mask, shading);
 
     // Triangulate
     cv::Mat xyz;
@@ -185,3 +233,42 @@ void Triangulator::triangulateFromUpVp(cv::Mat &up, cv::Mat &vp, cv::Mat &xyz){
 }
 
 
+
+// z = (offset2 + factor2*phase)/(offset3 + factor3*phase), NaN outside of mask
+static void depthFromPhase(const cv::Mat &phase, const cv::Mat &mask, const std::vector<cv::Mat> &offset, const std::vector<cv::Mat> &factor, cv::Mat &z){
+
+    z.create(phase.size(), CV_32F);
+    for(int row=0; row<phase.rows; row++){
+        const float *p = phase.ptr<float>(row);
+        const uchar *m = mask.ptr<uchar>(row);
+        const float *o2 = offset[2].ptr<float>(row), *f2 = factor[2].ptr<float>(row);
+        const float *o3 = offset[3].ptr<float>(row), *f3 = factor[3].ptr<float>(row);
+        float *zRow = z.ptr<float>(row);
+        for(int col=0; col<phase.cols; col++)
+            zRow[col] = m[col] ? (o2[col] + f2[col]*p[col])/(o3[col] + f3[col]*p[col]) : NAN;
+    }
+}
+
+void Triangulator::triangulate(cv::Mat &up, cv::Mat &vp, cv::Mat &mask, cv::Mat &shading, DepthImage &depthImage){
+
+    undistort(up, vp, mask, shading);
+
+    // Only z and w of xyzw are needed, x and y follow from the camera rays
+    if(!up.empty() && vp.empty()){
+        depthFromPhase(up, mask, xyzwPrecomputeOffset, xyzwPrecomputeFactor, depthImage.z);
+    } else if(!vp.empty() && up.empty()){
+        depthFromPhase(vp, mask, xyzwPrecomputeOffsetVp, xyzwPrecomputeFactorVp, depthImage.z);
+    } else if(!up.empty() && !vp.empty()){
+        cv::Mat xyz, z;
+        triangulateFromUpVp(up, vp, xyz);
+        cv::extractChannel(xyz, z, 2);
+        depthImage.z = cv::Mat(up.size(), CV_32F, cv::Scalar(NAN));
+        z.copyTo(depthImage.z, mask);
+    } else {
+        depthImage.z = cv::Mat(mask.size(), CV_32F, cv::Scalar(NAN));
+    }
+
+    depthImage.shading = shading;
+    depthImage.rays = rays;
+    depthImage.bundle = bundle;
+}
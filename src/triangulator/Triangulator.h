@@ -1,7 +1,9 @@
 #ifndef RECONSTRUCTOR_H
 #define RECONSTRUCTOR_H
 
+#include "CalibrationBundle.h"
 #include "CalibrationData.h"
+#include "DepthImage.h"
 
 #include <opencv2/opencv.hpp>
 #include <vector>
@@ -9,20 +11,34 @@
 class Triangulator {
     public:
         Triangulator(CalibrationData _calibration);
+        // Shares the tables of the bundle
+        Triangulator(CalibrationBundle::ConstPtr _bundle);
         CalibrationData getCalibration(){return calibration;}
+        CalibrationBundle::ConstPtr getBundle(){return bundle;}
         ~Triangulator(){}
         // Reconstruction
         void triangulate(cv::Mat &up, cv::Mat &vp, cv::Mat &mask, cv::Mat &shading, cv::Mat &pointCloud);
+        // Reconstruction as depth image, computing z only
+        void triangulate(cv::Mat &up, cv::Mat &vp, cv::Mat &mask, cv::Mat &shading, DepthImage &depthImage);
+        // Per pixel tables of a calibration, as stored in CalibrationBundle
+        static CalibrationBundle::Tables computeTables(const CalibrationData &calibration);
+        // Increase when the tables change, such that bundles are rebuilt
+        static const int tablesVersion = 1;
     private:
+        void undistort(cv::Mat &up, cv::Mat &vp, cv::Mat &mask, cv::Mat &shading);
         void triangulateFromUp(cv::Mat &up, cv::Mat &xyz);
         void triangulateFromVp(cv::Mat &vp, cv::Mat &xyz);
         void triangulateFromUpVp(cv::Mat &up, cv::Mat &vp, cv::Mat &xyz);
         CalibrationData calibration;
+        CalibrationBundle::ConstPtr bundle;
         cv::Mat determinantTensor;
         cv::Mat uc, vc;
         cv::Mat lensMap1, lensMap2;
         std::vector<cv::Mat> xyzwPrecomputeOffset;
         std::vector<cv::Mat> xyzwPrecomputeFactor;
+        std::vector<cv::Mat> xyzwPrecomputeOffsetVp;
+        std::vector<cv::Mat> xyzwPrecomputeFactorVp;
+        cv::Mat rays;
 };
 
 #endif